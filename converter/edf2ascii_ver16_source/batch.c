@@ -0,0 +1,377 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "batch.h"
+#include "decompress.h"
+
+
+struct batch_list{
+         char **path;
+         int count;
+         int size;
+       };
+
+
+struct batch_pool{
+         pthread_mutex_t lock;
+         const struct conv_opts *opts;
+         const struct batch_list *list;
+         int next;                  /* next file to be converted by a thread */
+         int done;
+         int failed;
+         char **errmsg;             /* NULL for the files that were converted */
+       };
+
+
+static int list_add(struct batch_list *list, const char *path)
+{
+  char **tmp;
+
+
+  if(list->count == list->size)
+  {
+    list->size = (list->size < 64) ? 64 : (list->size * 2);
+
+    tmp = (char **)realloc(list->path, list->size * sizeof(char *));
+    if(tmp == NULL)  return -1;
+
+    list->path = tmp;
+  }
+
+  list->path[list->count] = strdup(path);
+  if(list->path[list->count] == NULL)  return -1;
+
+  list->count++;
+
+  return 0;
+}
+
+
+static void list_free(struct batch_list *list)
+{
+  int i;
+
+  for(i=0; i<list->count; i++)
+  {
+    free(list->path[i]);
+  }
+  free(list->path);
+  memset(list, 0, sizeof(struct batch_list));
+}
+
+
+/* .edf and .bdf files, also gzip or xz compressed ones, but not tar archives, */
+/* which may hold other things and are only converted when named explicitly   */
+static int has_edf_extension(const char *name)
+{
+  int len, type;
+
+
+  type = dcmp_type(name, NULL);
+  if(type != DCMP_NONE)  return !(type & DCMP_TAR);
+
+  len = strlen(name);
+  if(len < 5)  return 0;
+
+  name += len - 4;
+
+  return (!strcmp(name, ".edf")) || (!strcmp(name, ".EDF")) ||
+         (!strcmp(name, ".bdf")) || (!strcmp(name, ".BDF"));
+}
+
+
+static int cmp_path(const void *a, const void *b)
+{
+  return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+
+/* adds the (compressed) .edf and .bdf files in a directory, sorted by name */
+static int add_directory(struct batch_list *list, const char *dir)
+{
+  int first, len;
+
+  char path[2048];
+
+  DIR *dp;
+
+  struct dirent *entry;
+
+
+  dp = opendir(dir);
+  if(dp == NULL)
+  {
+    printf("Error, can not open directory %s\n", dir);
+    return -1;
+  }
+
+  len = strlen(dir);
+  while((len > 1) && ((dir[len-1] == '/') || (dir[len-1] == '\\')))  len--;
+
+  first = list->count;
+
+  while((entry = readdir(dp)) != NULL)
+  {
+    if(!has_edf_extension(entry->d_name))  continue;
+
+    if((len + strlen(entry->d_name) + 2) > sizeof(path))  continue;
+
+    snprintf(path, sizeof(path), "%.*s/%s", len, dir, entry->d_name);
+
+    if(list_add(list, path))
+    {
+      closedir(dp);
+      printf("Malloc error! (list of files)\n");
+      return -1;
+    }
+  }
+
+  closedir(dp);
+
+  qsort(list->path + first, list->count - first, sizeof(char *), cmp_path);
+
+  return 0;
+}
+
+
+/* adds the files named in a text file, one per line */
+static int add_listfile(struct batch_list *list, const char *listfile)
+{
+  int len;
+
+  char line[2048];
+
+  FILE *fp;
+
+
+  fp = fopen(listfile, "rb");
+  if(fp == NULL)
+  {
+    printf("Error, can not open file %s for reading\n", listfile);
+    return -1;
+  }
+
+  while(fgets(line, sizeof(line), fp) != NULL)
+  {
+    len = strlen(line);
+    while(len && ((line[len-1] == '\n') || (line[len-1] == '\r') || (line[len-1] == ' ')))  len--;
+    line[len] = 0;
+
+    if((!len) || (line[0] == '#'))  continue;
+
+    if(list_add(list, line))
+    {
+      fclose(fp);
+      printf("Malloc error! (list of files)\n");
+      return -1;
+    }
+  }
+
+  fclose(fp);
+
+  return 0;
+}
+
+
+int batch_is_list(const char *input)
+{
+  struct stat st;
+
+  if(input[0] == '@')  return 1;
+
+  return (!stat(input, &st)) && S_ISDIR(st.st_mode);
+}
+
+
+static void * batch_thread(void *arg)
+{
+  int i, err;
+
+  struct batch_pool *pool;
+
+  struct conv_session session;
+
+
+  pool = (struct batch_pool *)arg;
+
+  conv_session_init(&session);
+
+  while(1)
+  {
+    pthread_mutex_lock(&pool->lock);
+    i = pool->next++;
+    pthread_mutex_unlock(&pool->lock);
+
+    if(i >= pool->list->count)  break;
+
+    err = convert_file(&session, pool->list->path[i], pool->opts);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->done++;
+    if(err)
+    {
+      pool->failed++;
+      pool->errmsg[i] = strdup(session.errmsg);
+      printf("[%i/%i] failed: %s: %s\n", pool->done, pool->list->count, pool->list->path[i], session.errmsg);
+    }
+    else
+    {
+      printf("[%i/%i] converted: %s\n", pool->done, pool->list->count, pool->list->path[i]);
+    }
+
+    if(pool->opts->stats)
+    {
+      conv_stats_print(stderr, pool->list->path[i], &session.stats, pool->opts->stats);
+    }
+    fflush(stdout);
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  conv_session_free(&session);
+
+  return NULL;
+}
+
+
+int convert_batch(char * const *inputs, int n_inputs, const struct conv_opts *opts, int jobs)
+{
+  int i, err=0,
+      started=0;
+
+  pthread_t *tids=NULL;
+
+  struct batch_list list;
+
+  struct batch_pool pool;
+
+
+  memset(&list, 0, sizeof(struct batch_list));
+  memset(&pool, 0, sizeof(struct batch_pool));
+
+  for(i=0; i<n_inputs; i++)
+  {
+    if(inputs[i][0] == '@')
+    {
+      err = add_listfile(&list, inputs[i] + 1);
+    }
+    else if(batch_is_list(inputs[i]))
+      {
+        err = add_directory(&list, inputs[i]);
+      }
+      else if(list_add(&list, inputs[i]))
+        {
+          printf("Malloc error! (list of files)\n");
+          err = -1;
+        }
+
+    if(err)
+    {
+      list_free(&list);
+      return -1;
+    }
+  }
+
+  if(!list.count)
+  {
+    printf("Error, no files to convert\n");
+    return -1;
+  }
+
+  if(jobs > list.count)  jobs = list.count;
+  if(jobs < 1)  jobs = 1;
+
+  pool.opts = opts;
+  pool.list = &list;
+  pool.errmsg = (char **)calloc(list.count, sizeof(char *));
+  tids = (pthread_t *)calloc(jobs, sizeof(pthread_t));
+  if((pool.errmsg==NULL)||(tids==NULL))
+  {
+    printf("Malloc error! (threads)\n");
+    free(pool.errmsg);
+    free(tids);
+    list_free(&list);
+    return -1;
+  }
+
+  pthread_mutex_init(&pool.lock, NULL);
+
+  for(started=0; started<jobs; started++)
+  {
+    if(pthread_create(tids + started, NULL, batch_thread, &pool))  break;
+  }
+
+  if(!started)
+  {
+    /* no threads, convert the files here */
+    batch_thread(&pool);
+  }
+
+  for(i=0; i<started; i++)
+  {
+    pthread_join(tids[i], NULL);
+  }
+
+  pthread_mutex_destroy(&pool.lock);
+
+  printf("\nConverted %i of %i files", list.count - pool.failed, list.count);
+  if(pool.failed)
+  {
+    printf(", %i failed:\n", pool.failed);
+
+    for(i=0; i<list.count; i++)
+    {
+      if(pool.errmsg[i] == NULL)  continue;
+
+      printf("  %s: %s\n", list.path[i], pool.errmsg[i]);
+    }
+  }
+  else
+  {
+    printf("\n");
+  }
+
+  for(i=0; i<list.count; i++)
+  {
+    free(pool.errmsg[i]);
+  }
+  free(pool.errmsg);
+  free(tids);
+
+  err = pool.failed;
+
+  list_free(&list);
+
+  return err;
+}
@@ -0,0 +1,46 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+#ifndef BATCH_INCLUDED
+#define BATCH_INCLUDED
+
+
+#include "convert.h"
+
+
+/* Converts many files in one process. Every input is a file, a directory (all    */
+/* .edf and .bdf files in it) or @listfile (one path per line, # starts a comment). */
+/* Up to jobs files are converted at the same time. A line is printed for every     */
+/* file when it is done, followed by a summary. Returns the number of failed files, */
+/* or -1 when the list of files could not be made.                                  */
+int convert_batch(char * const *inputs, int n_inputs, const struct conv_opts *opts, int jobs);
+
+/* non-zero when the input names a directory or a list of files instead of a single file */
+int batch_is_list(const char *input);
+
+
+#endif
@@ -0,0 +1,138 @@
+#!/bin/sh
+#
+# Checks for "make check": files made by edfgen are converted in different
+# ways that must give the same outputs, -j 1 and -j N, stdin and a file,
+# gzip/xz and plain, with and without --index, and -t/-s against the full
+# conversion filtered in awk. The files that _columns.txt lists must exist.
+# The files are kept in check/ when a check fails.
+#
+
+dir=check
+rc=0
+
+fail()
+{
+  echo "FAIL: $*"
+  rc=1
+}
+
+# conv <name> <options> ...: converts to $dir/<name>/rec_*
+conv()
+{
+  name=$1
+  shift
+  rm -rf "$dir/$name"
+  mkdir -p "$dir/$name"
+  ./edf2ascii -o "$dir/$name/rec" "$@" > /dev/null || fail "edf2ascii -o $dir/$name/rec $*"
+}
+
+# same <name> <name>: the two conversions wrote the same files
+same()
+{
+  for f in "$dir/$1"/*
+  do
+    b=`basename "$f"`
+    cmp -s "$f" "$dir/$2/$b" || fail "$f and $dir/$2/$b differ"
+  done
+  for f in "$dir/$2"/*
+  do
+    test -f "$dir/$1/`basename "$f"`" || fail "$f was not written by $dir/$1"
+  done
+}
+
+# columns <name>: every file that _columns.txt lists was written
+columns()
+{
+  for b in `tail -n +2 "$dir/$1/rec_columns.txt" | cut -d, -f1`
+  do
+    test -f "$dir/$1/$b" || fail "$dir/$1/rec_columns.txt lists $b, which was not written"
+  done
+}
+
+
+rm -rf "$dir"
+mkdir -p "$dir"
+
+./edfgen -t edf -s 4 -r 256,128,3,1000 -n 20 $dir/a.edf > /dev/null
+./edfgen -t edf+ -s 5 -r 200,50,7 -n 30 -a 3 $dir/b.edf > /dev/null
+./edfgen -t bdf -s 6 -r 512,100 -n 10 $dir/c.bdf > /dev/null
+./edfgen -t bdf+ -D -s 3 -r 64,17,9 -n 40 -a 2 -g 7 $dir/d.bdf > /dev/null
+./edfgen -t edf+ -D -s 3 -r 100,30 -d 250 -n 25 $dir/e.edf > /dev/null
+
+for edf in $dir/a.edf $dir/b.edf $dir/c.bdf $dir/d.bdf $dir/e.edf
+do
+  gzip -c $edf > $edf.gz
+  if command -v xz > /dev/null
+  then
+    xz -c $edf > $edf.xz
+  fi
+
+  for format in txt npy groups
+  do
+    conv ref -f $format $edf
+    conv threads -f $format -j 4 $edf
+    same ref threads
+    conv stdin -f $format - < $edf
+    same ref stdin
+    conv gz -f $format $edf.gz
+    same ref gz
+    if test -f $edf.xz
+    then
+      conv xz -f $format $edf.xz
+      same ref xz
+    fi
+    if test $format != txt
+    then
+      columns ref
+    fi
+  done
+
+  conv ref $edf
+
+  # -s 2,3 is columns 1, 3 and 4 of the full table, without the rows in
+  # which neither signal has a sample
+  conv signals -s 2,3 $edf
+  cut -d, -f1,3,4 $dir/ref/rec_data.txt | grep -v ',,$' > $dir/filtered
+  cmp -s $dir/filtered $dir/signals/rec_data.txt || fail "-s 2,3 of $edf"
+
+  # -t gives the rows and the annotations with a time in [1.55, 9.25)
+  conv time -t 1.55,9.25 $edf
+  awk -F, 'NR == 1 || ($1 >= 1.55 && $1 < 9.25)' $dir/ref/rec_data.txt > $dir/filtered
+  cmp -s $dir/filtered $dir/time/rec_data.txt || fail "-t 1.55,9.25 of $edf"
+  awk -F, 'NR == 1 || ($1 >= 1.55 && $1 < 9.25)' $dir/ref/rec_annotations.txt > $dir/filtered
+  cmp -s $dir/filtered $dir/time/rec_annotations.txt || fail "annotations of -t 1.55,9.25 of $edf"
+
+  # the index gives the same window, when it is made and when it is used
+  rm -f $edf.idx
+  conv index -t 1.55,9.25 --index $edf
+  same time index
+  conv index -t 1.55,9.25 --index $edf
+  same time index
+done
+
+# a file that is written twice within the same second, with the same size
+# and header but its gaps elsewhere, is indexed again (the first index would
+# put the window after the first gap elsewhere)
+./edfgen -t bdf+ -D -s 3 -r 64,17,9 -n 40 -a 2 -g 7 $dir/d.bdf > /dev/null
+rm -f $dir/d.bdf.idx
+conv index -t 8.5,20 --index $dir/d.bdf
+./edfgen -t bdf+ -D -s 3 -r 64,17,9 -n 40 -a 2 -g 5 $dir/d.bdf > /dev/null
+conv index -t 8.5,20 --index $dir/d.bdf
+conv time -t 8.5,20 $dir/d.bdf
+same time index
+
+# a TAL after the padding of an annotation signal is read, as edf2ascii 1.6
+# did: with -s 1 -r 10 -a 1 a datarecord is 10 samples and a 36-sample
+# annotation signal after a 768-byte header, the TAL goes in the last 11
+# bytes of the first datarecord
+./edfgen -t edf+ -s 1 -r 10 -n 3 -a 1 $dir/f.edf > /dev/null
+printf '+0.5\024late\024\000' | dd of=$dir/f.edf bs=1 seek=849 conv=notrunc 2> /dev/null
+conv ref $dir/f.edf
+grep -q '^+0.5,,late$' $dir/ref/rec_annotations.txt || fail "the TAL after the padding of $dir/f.edf"
+
+if test $rc = 0
+then
+  rm -rf "$dir"
+  echo "all checks passed"
+fi
+exit $rc
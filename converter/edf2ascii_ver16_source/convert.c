@@ -0,0 +1,3828 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(WIN64) && !defined(_WIN64)
+#include <sys/resource.h>
+#define CONV_HAVE_RUSAGE
+#endif
+
+#include "edfread.h"
+#include "decompress.h"
+#include "txtwriter.h"
+#include "npywriter.h"
+#include "resample.h"
+#include "edfindex.h"
+#include "pyramid.h"
+#include "convert.h"
+
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#include <windows.h>
+#define CONV_NULL_DEVICE     "NUL"
+#else
+#define CONV_NULL_DEVICE     "/dev/null"
+#endif
+
+/* how often a file that is being recorded is checked for new datarecords */
+#define CONV_FOLLOW_POLL_MSEC  (200)
+
+
+/* aim for about this many samples per chunk of datarecords handed to a thread */
+#define CONV_CHUNK_SAMPLES   (262144)
+
+
+/* one row of the interleave schedule, the row writes the samples */
+/* emit[first] up to emit[first + count - 1] */
+struct conv_row{
+         long long time;            /* offset from the start of the datarecord in nanoSeconds */
+         int first;
+         int count;
+       };
+
+
+/* a sample written in a row */
+struct conv_emit{
+         int column;                /* index in the list of data signals */
+         int smp;                   /* index in smp_buf */
+       };
+
+
+/* the order in which the samples of a datarecord are written, it is the same for every datarecord */
+struct conv_sched{
+         int data_signals;
+         int *data_sig;             /* indexes of the signals that are not annotation signals */
+         int rows;
+         struct conv_row *row;
+         struct conv_emit *emit;
+       };
+
+
+/* the signals of which the sample rate is lowered, see convert_resampled() */
+struct conv_rs{
+         int *up;                   /* per signal, 0 when the sample rate is kept */
+         int *down;
+         struct rsmp *filter;       /* per signal */
+         int lookahead;             /* datarecords the filters need before and after a datarecord */
+         double *ring;              /* the lookahead + 1 datarecords decoded last */
+         long long *starttime;      /* of the datarecords in ring */
+         double *out_buf;           /* the samples of the datarecord that is written */
+       };
+
+
+/* per-thread conversion state, every thread reads the file through its own handle */
+struct conv_worker{
+         struct edfrd_file *hdl;
+         const struct edfrd_hdr *hdr;
+         const struct conv_opts *opts;
+         struct conv_sched sched;
+         int *selected;             /* flags of the signals to convert */
+         int *out_spr;              /* per signal, samples per datarecord written */
+         int *out_offset;           /* per signal, index of the first sample in the buffer that is written */
+         struct conv_rs *rs;        /* NULL when all sample rates are kept */
+         const struct edfidx *idx;  /* NULL when there is no index */
+         struct pyr_bins *bins;     /* the pyramid bins of the datarecords decoded, NULL when there is no pyramid */
+         struct pyr *pyr;           /* where the bins go after every datarecord, NULL when a thread collects them */
+         int pyr_first;             /* the datarecord the pyramid starts with */
+         int windowed;              /* non-zero when only a part of the recording is converted */
+         struct txw *aw;            /* destination of the annotations of the current datarecord */
+         struct npyw *onsetw;       /* the onsets and durations of the annotations written to aw in */
+         struct npyw *durationw;    /* nanoSeconds, NULL when they are not written as .npy */
+         double *smp_buf;
+         int *dig_buf;              /* as smp_buf, the digital values when opts->digital is set */
+         long long rec_samples;     /* samples decoded per datarecord */
+         struct conv_stats *stats;  /* NULL when no stats are collected */
+         char errmsg[256];
+       };
+
+
+/* the text produced for one chunk of consecutive datarecords */
+struct conv_chunk{
+         struct txw data;
+         struct txw annot;
+         struct pyr_bins bins;      /* when a pyramid is made */
+         int ready;
+         int error;
+         char errmsg[256];
+       };
+
+
+/* how far a conversion with a checkpoint file got */
+struct conv_ckpt{
+         int records;               /* datarecords converted */
+         int signals;               /* of the file, to recognize it */
+         int recordbytes;
+         long long data_bytes;      /* size of the _data file after the last datarecord converted */
+         long long annot_bytes;     /* size of the _annotations file */
+       };
+
+
+struct conv_pool{
+         pthread_mutex_t lock;
+         pthread_cond_t cond;
+         const char *path;
+         const struct conv_opts *opts;
+         int first_record;
+         int last_record;           /* one past the last datarecord to convert */
+         int chunk_records;
+         int nr_chunks;
+         int next_chunk;            /* next chunk to be converted by a thread */
+         int written_chunk;         /* next chunk to be written by the main thread */
+         int window;                /* number of chunk slots */
+         int abort;
+         struct conv_chunk *slots;
+         struct conv_stats *stats;  /* the threads add theirs, NULL when no stats are collected */
+         struct pyr *pyr;           /* NULL when no pyramid is made */
+       };
+
+
+static int write_annotation(void *, const struct edfrd_annot *);
+
+static const char * output_name(const char *, int, int *);
+
+/* gets the samples of one datarecord, laid out as out_spr and out_offset say */
+typedef int (*conv_emit_fn)(struct conv_worker *w, const double *smp, long long starttime, void *ctx);
+
+
+static double conv_now(void)
+{
+  struct timespec ts;
+
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/* sleeps for msec milliSeconds */
+static void conv_sleep(int msec)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+  Sleep(msec);
+#else
+  struct timespec ts;
+
+  ts.tv_sec = msec / 1000;
+  ts.tv_nsec = (msec % 1000) * 1000000L;
+
+  nanosleep(&ts, NULL);
+#endif
+}
+
+
+/* CPU time of the calling thread */
+static double conv_cpu_time(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  struct timespec ts;
+
+
+  if(!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+  {
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+  }
+#endif
+  return 0.0;
+}
+
+
+static void stats_add(struct conv_stats *dest, const struct conv_stats *src)
+{
+  int i;
+
+
+  for(i=0; i<CONV_STAGES; i++)
+  {
+    dest->stage[i] += src->stage[i];
+  }
+  dest->cpu += src->cpu;
+  dest->bytes_read += src->bytes_read;
+  dest->bytes_written += src->bytes_written;
+  dest->records += src->records;
+  dest->samples += src->samples;
+}
+
+
+void conv_opts_init(struct conv_opts *opts)
+{
+  int i;
+
+  memset(opts, 0, sizeof(struct conv_opts));
+
+  opts->precision = 6;
+  opts->threads = 1;
+  opts->signal_list = NULL;
+  opts->start_time = 0LL;
+  opts->end_time = -1LL;
+  opts->format = CONV_FORMAT_TXT;
+  opts->float32 = 0;
+  opts->digital = 0;
+  opts->output_base = NULL;
+  opts->rate_list = NULL;
+  opts->follow = 0;
+  opts->follow_idle = 0.0;
+  opts->checkpoint = NULL;
+  opts->annotations_only = 0;
+  opts->pyramid = 0;
+  opts->index = 0;
+  opts->index_path = NULL;
+  for(i=0; i<CONV_OUTPUTS; i++)
+  {
+    opts->dest[i] = NULL;
+  }
+}
+
+
+static void resample_free(struct conv_worker *w)
+{
+  int i;
+
+  if(w->rs == NULL)  return;
+
+  for(i=0; (w->rs->filter!=NULL)&&(i<w->hdr->signals); i++)
+  {
+    rsmp_free(w->rs->filter + i);
+  }
+  free(w->rs->up);
+  free(w->rs->down);
+  free(w->rs->filter);
+  free(w->rs->ring);
+  free(w->rs->starttime);
+  free(w->rs->out_buf);
+  free(w->rs);
+  w->rs = NULL;
+}
+
+
+static void worker_free(struct conv_worker *w)
+{
+  resample_free(w);
+  edfrd_close(w->hdl);
+  free(w->sched.data_sig);
+  free(w->sched.row);
+  free(w->sched.emit);
+  free(w->selected);
+  free(w->out_spr);
+  free(w->out_offset);
+  free(w->smp_buf);
+  free(w->dig_buf);
+  memset(&w->sched, 0, sizeof(struct conv_sched));
+  w->hdl = NULL;
+  w->selected = NULL;
+  w->out_spr = NULL;
+  w->out_offset = NULL;
+  w->smp_buf = NULL;
+  w->dig_buf = NULL;
+}
+
+
+/* copies the next item of a comma-separated list to item, without the spaces around it, */
+/* and moves *list past it, returns the length of the item                                */
+static int next_item(const char **list, char *item)
+{
+  int i, n=0,
+      len;
+
+  const char *str;
+
+
+  str = *list;
+
+  for(len=0; (str[len]!=',') && (str[len]!=0); len++);
+
+  for(i=0; i<len; i++)
+  {
+    if((n == 0) && (str[i] == ' '))  continue;
+
+    if(n < 255)  item[n++] = str[i];
+  }
+  while(n && (item[n-1] == ' '))  n--;
+  item[n] = 0;
+
+  str += len;
+  if(*str == ',')  str++;
+
+  *list = str;
+
+  return n;
+}
+
+
+/* sets the flag of the data signal with number item (as in the _signals.txt */
+/* file), or the flags of all data signals with label item                   */
+static int match_signal(const struct edfrd_hdr *hdr, const char *item, int *flags, char *errmsg)
+{
+  int i, j, n,
+      len,
+      found=0;
+
+  const char *label;
+
+
+  n = strlen(item);
+
+  for(i=0; isdigit((unsigned char)item[i]); i++);
+  if(item[i] == 0)
+  {
+    j = atoi(item) - 1;
+    if((j < 0) || (j >= hdr->signals))
+    {
+      snprintf(errmsg, 256, "Error, there is no signal %.100s in this file", item);
+      return -1;
+    }
+    if(hdr->param[j].annotation)
+    {
+      snprintf(errmsg, 256, "Error, signal %.100s is an annotation signal", item);
+      return -1;
+    }
+    flags[j] = 1;
+    return 0;
+  }
+
+  /* labels are 16 characters, padded with spaces */
+  for(j=0; j<hdr->signals; j++)
+  {
+    if(hdr->param[j].annotation)  continue;
+
+    label = hdr->raw + 256 + (j * 16);
+
+    for(len=16; (len > 0) && (label[len-1] == ' '); len--);
+
+    if(len != n)  continue;
+
+    for(i=0; i<n; i++)
+    {
+      if(toupper((unsigned char)label[i]) != toupper((unsigned char)item[i]))  break;
+    }
+    if(i == n)
+    {
+      flags[j] = 1;
+      found = 1;
+    }
+  }
+
+  if(!found)
+  {
+    snprintf(errmsg, 256, "Error, there is no signal with label \"%.100s\" in this file", item);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* sets the flags of the signals in a comma-separated list of signal numbers (as in the */
+/* _signals.txt file) and labels, without a list all data signals are selected          */
+static int parse_signal_list(const struct edfrd_hdr *hdr, const char *list, int *selected, char *errmsg)
+{
+  int i;
+
+  char item[256];
+
+
+  for(i=0; i<hdr->signals; i++)
+  {
+    selected[i] = (list == NULL) && (!hdr->param[i].annotation);
+  }
+
+  if(list == NULL)  return 0;
+
+  while(*list)
+  {
+    if(!next_item(&list, item))  continue;
+
+    if(match_signal(hdr, item, selected, errmsg))  return -1;
+  }
+
+  return 0;
+}
+
+
+/* the number of samples per datarecord at a rate in Hz, or -1 if that is not a whole number */
+static int rate_samples(const struct edfrd_hdr *hdr, double rate)
+{
+  double n;
+
+
+  n = rate * ((double)hdr->data_record_duration / EDFRD_FP_SCALING);
+
+  if((n < 0.5) || (n > 1e9))  return -1;
+
+  if(fabs(n - (long long)(n + 0.5)) > 1e-6)  return -1;
+
+  return (long long)(n + 0.5);
+}
+
+
+static int gcd(int a, int b)
+{
+  int t;
+
+  while(b)
+  {
+    t = a % b;
+    a = b;
+    b = t;
+  }
+
+  return a;
+}
+
+
+/* Sets the sample rates of the selected signals from a comma-separated list of rates in */
+/* Hz. A bare rate applies to every signal with a higher rate, SIGNAL=RATE sets the rate */
+/* of a signal, where SIGNAL is a number or a label as in the list of signals. Rates are */
+/* only lowered, and the new rate must give a whole number of samples per datarecord.    */
+/* The new number of samples per datarecord is written to out_spr.                        */
+static int parse_rate_list(const struct edfrd_hdr *hdr, const char *list, const int *selected, int *out_spr,
+                           char *errmsg)
+{
+  int i, j, n,
+      *named=NULL,
+      err=-1;
+
+  double rate,
+         all=0.0,
+         duration,
+         *sig_rate=NULL;
+
+  char item[256],
+       *eq,
+       *end;
+
+
+  named = (int *)calloc(hdr->signals, sizeof(int));
+  sig_rate = (double *)calloc(hdr->signals, sizeof(double));
+  if((named==NULL)||(sig_rate==NULL))
+  {
+    snprintf(errmsg, 256, "Malloc error! (rates)");
+    goto OUT;
+  }
+
+  duration = (double)hdr->data_record_duration / EDFRD_FP_SCALING;
+
+  while(*list)
+  {
+    if(!next_item(&list, item))  continue;
+
+    /* a label may contain a '=', the rate follows the last one */
+    eq = strrchr(item, '=');
+
+    rate = strtod((eq == NULL) ? item : (eq + 1), &end);
+    if((*end != 0) || (end == ((eq == NULL) ? item : (eq + 1))) || (!(rate > 0.0)))
+    {
+      snprintf(errmsg, 256, "Error, invalid sample rate \"%.100s\"", item);
+      goto OUT;
+    }
+
+    if(eq == NULL)
+    {
+      all = rate;
+      continue;
+    }
+
+    while((eq > item) && (eq[-1] == ' '))  eq--;
+    *eq = 0;
+
+    memset(named, 0, hdr->signals * sizeof(int));
+    if(match_signal(hdr, item, named, errmsg))  goto OUT;
+
+    for(j=0; j<hdr->signals; j++)
+    {
+      if(named[j])  sig_rate[j] = rate;
+    }
+  }
+
+  for(j=0; j<hdr->signals; j++)
+  {
+    out_spr[j] = hdr->param[j].smp_per_record;
+
+    if(!selected[j])  continue;
+
+    rate = (sig_rate[j] > 0.0) ? sig_rate[j] : all;
+    if(!(rate > 0.0))  continue;
+
+    n = rate_samples(hdr, rate);
+
+    /* the signal already has this rate or a lower one */
+    if((n < 0) ? ((rate * duration) >= out_spr[j]) : (n >= out_spr[j]))
+    {
+      if((sig_rate[j] > 0.0) && (n != out_spr[j]))
+      {
+        snprintf(errmsg, 256, "Error, the sample rate of signal %i can only be lowered", j + 1);
+        goto OUT;
+      }
+      continue;
+    }
+
+    if(n < 0)
+    {
+      snprintf(errmsg, 256, "Error, %g Hz does not give a whole number of samples per datarecord of signal %i",
+               rate, j + 1);
+      goto OUT;
+    }
+
+    i = gcd(n, out_spr[j]);
+    if(((n / i) > RSMP_MAX_FACTOR) || ((out_spr[j] / i) > RSMP_MAX_FACTOR))
+    {
+      snprintf(errmsg, 256, "Error, the sample rate of signal %i can not be converted to %g Hz", j + 1, rate);
+      goto OUT;
+    }
+
+    out_spr[j] = n;
+  }
+
+  err = 0;
+
+OUT:
+
+  free(named);
+  free(sig_rate);
+
+  return err;
+}
+
+
+/* Simulates the writing of one datarecord: every row gets the timestamp of the     */
+/* earliest sample that is not written yet, and every signal that has a sample at   */
+/* that time writes it. Signals that are already complete are left out of the       */
+/* search for the earliest sample, otherwise a rounded timestep could keep the      */
+/* loop going forever. spr and offset give the number of samples per datarecord    */
+/* of every signal and where the first one is in the buffer of a datarecord.        */
+static int make_schedule(struct conv_sched *sched, const struct edfrd_hdr *hdr, const int *selected,
+                         const int *spr, const int *offset)
+{
+  int i, j,
+      signals,
+      max_rows=0,
+      emits=0,
+      rows=0,
+      n=0,
+      recordfull,
+      *smp_written=NULL;
+
+  long long time_tmp,
+            d_tmp,
+            *time_step=NULL;
+
+
+  signals = hdr->signals;
+
+  sched->data_sig = (int *)malloc((signals + 1) * sizeof(int));
+  smp_written = (int *)calloc(signals + 1, sizeof(int));
+  time_step = (long long *)calloc(signals + 1, sizeof(long long));
+  if((sched->data_sig==NULL)||(smp_written==NULL)||(time_step==NULL))  goto OUT_ERROR;
+
+  sched->data_signals = 0;
+  for(j=0; j<signals; j++)
+  {
+    if(!selected[j]) continue;
+
+    sched->data_sig[sched->data_signals++] = j;
+
+    emits += spr[j];
+
+    /* as edfparam[j].time_step */
+    time_step[j] = hdr->data_record_duration / spr[j];
+  }
+
+  /* every row writes at least one sample */
+  max_rows = emits + 1;
+
+  sched->row = (struct conv_row *)malloc(max_rows * sizeof(struct conv_row));
+  sched->emit = (struct conv_emit *)malloc((emits + 1) * sizeof(struct conv_emit));
+  if((sched->row==NULL)||(sched->emit==NULL))  goto OUT_ERROR;
+
+  do
+  {
+    time_tmp = 100000000000000LL;
+    for(i=0; i<sched->data_signals; i++)
+    {
+      j = sched->data_sig[i];
+
+      if(smp_written[i]>=spr[j]) continue;
+
+      d_tmp = smp_written[i] * time_step[j];
+      if(d_tmp<time_tmp) time_tmp = d_tmp;
+    }
+
+    sched->row[rows].time = time_tmp;
+    sched->row[rows].first = n;
+
+    recordfull = 1;
+    for(i=0; i<sched->data_signals; i++)
+    {
+      j = sched->data_sig[i];
+
+      if(smp_written[i]>=spr[j]) continue;
+
+      d_tmp = smp_written[i] * time_step[j];
+
+      if(d_tmp == time_tmp)
+      {
+        sched->emit[n].column = i;
+        sched->emit[n].smp = offset[j] + smp_written[i];
+        n++;
+        smp_written[i]++;
+      }
+
+      if(smp_written[i]<spr[j])  recordfull = 0;
+    }
+
+    sched->row[rows].count = n - sched->row[rows].first;
+    rows++;
+  }
+  while((!recordfull) && (rows < max_rows));
+
+  sched->rows = rows;
+
+  free(smp_written);
+  free(time_step);
+
+  return 0;
+
+OUT_ERROR:
+
+  free(smp_written);
+  free(time_step);
+
+  return -1;
+}
+
+
+/* prepares the filters of the signals of which out_spr is lower than in the file, */
+/* the resampled datarecords only hold the signals that are converted             */
+static int resample_init(struct conv_worker *w)
+{
+  int j, k,
+      g,
+      out_size=0;
+
+  const struct edfrd_hdr *hdr;
+
+  struct conv_rs *rs;
+
+
+  hdr = w->hdr;
+
+  for(j=0; j<hdr->signals; j++)
+  {
+    if(w->selected[j] && (w->out_spr[j] != hdr->param[j].smp_per_record))  break;
+  }
+  if(j == hdr->signals)  return 0;
+
+  rs = (struct conv_rs *)calloc(1, sizeof(struct conv_rs));
+  if(rs == NULL)  return -1;
+  w->rs = rs;
+
+  rs->up = (int *)calloc(hdr->signals, sizeof(int));
+  rs->down = (int *)calloc(hdr->signals, sizeof(int));
+  rs->filter = (struct rsmp *)calloc(hdr->signals, sizeof(struct rsmp));
+  if((rs->up==NULL)||(rs->down==NULL)||(rs->filter==NULL))  return -1;
+
+  for(j=0; j<hdr->signals; j++)
+  {
+    if(!w->selected[j])  continue;
+
+    w->out_offset[j] = out_size;
+    out_size += w->out_spr[j];
+
+    if(w->out_spr[j] == hdr->param[j].smp_per_record)  continue;
+
+    g = gcd(w->out_spr[j], hdr->param[j].smp_per_record);
+    rs->up[j] = w->out_spr[j] / g;
+    rs->down[j] = hdr->param[j].smp_per_record / g;
+
+    k = (rsmp_reach(rs->up[j], rs->down[j]) + hdr->param[j].smp_per_record - 1) / hdr->param[j].smp_per_record;
+    if(k > rs->lookahead)  rs->lookahead = k;
+  }
+
+  rs->ring = (double *)malloc((long long)(rs->lookahead + 1) * hdr->recordsize * sizeof(double));
+  rs->starttime = (long long *)calloc(rs->lookahead + 1, sizeof(long long));
+  rs->out_buf = (double *)malloc((out_size + 1) * sizeof(double));
+  if((rs->ring==NULL)||(rs->starttime==NULL)||(rs->out_buf==NULL))  return -1;
+
+  return 0;
+}
+
+
+/* hdl is the handle to use, or NULL to open the file again */
+static int worker_init(struct conv_worker *w, const char *path, struct edfrd_file *hdl, const struct conv_opts *opts)
+{
+  int i;
+
+
+  memset(w, 0, sizeof(struct conv_worker));
+
+  w->opts = opts;
+
+  if(hdl == NULL)
+  {
+    hdl = edfrd_open(path, w->errmsg, 256);
+    if(hdl == NULL)  return -1;
+  }
+
+  w->hdl = hdl;
+  w->hdr = edfrd_header(hdl);
+
+  w->smp_buf = (double *)malloc(w->hdr->recordsize * sizeof(double));
+  w->selected = (int *)calloc(w->hdr->signals, sizeof(int));
+  w->out_spr = (int *)calloc(w->hdr->signals, sizeof(int));
+  w->out_offset = (int *)calloc(w->hdr->signals, sizeof(int));
+  if(opts->digital)
+  {
+    w->dig_buf = (int *)malloc((w->hdr->recordsize + 1) * sizeof(int));
+  }
+  if((w->smp_buf==NULL)||(w->selected==NULL)||(w->out_spr==NULL)||(w->out_offset==NULL)||
+     (opts->digital && (w->dig_buf==NULL)))
+  {
+    snprintf(w->errmsg, 256, "Malloc error! (smp_buf)");
+    return -1;
+  }
+
+  if(parse_signal_list(w->hdr, opts->signal_list, w->selected, w->errmsg))
+  {
+    return -1;
+  }
+
+  for(i=0; i<w->hdr->signals; i++)
+  {
+    w->out_spr[i] = w->hdr->param[i].smp_per_record;
+    w->out_offset[i] = w->hdr->param[i].buf_offset;
+  }
+
+  if(opts->rate_list != NULL)
+  {
+    if(parse_rate_list(w->hdr, opts->rate_list, w->selected, w->out_spr, w->errmsg))
+    {
+      return -1;
+    }
+
+    if(resample_init(w))
+    {
+      snprintf(w->errmsg, 256, "Malloc error! (resampling)");
+      return -1;
+    }
+  }
+
+  if(make_schedule(&w->sched, w->hdr, w->selected, w->out_spr, w->out_offset))
+  {
+    snprintf(w->errmsg, 256, "Malloc error! (schedule)");
+    return -1;
+  }
+
+  for(i=0; i<w->sched.data_signals; i++)
+  {
+    w->rec_samples += w->hdr->param[w->sched.data_sig[i]].smp_per_record;
+  }
+
+  if(opts->signal_list != NULL)
+  {
+    if(edfrd_select_signals(hdl, w->selected))
+    {
+      snprintf(w->errmsg, 256, "%s", edfrd_errmsg(hdl));
+      return -1;
+    }
+  }
+
+  w->windowed = (opts->start_time > 0LL) || (opts->end_time >= 0LL);
+
+  return 0;
+}
+
+
+/* gets the start time of a datarecord and writes its annotations to aw */
+static int record_header(struct conv_worker *w, const char *cnv_buf, int recnr, struct txw *aw, long long *elapsedtime)
+{
+  if(edfrd_record_starttime(w->hdl, cnv_buf, recnr, elapsedtime))
+  {
+    snprintf(w->errmsg, 256, "%s", edfrd_errmsg(w->hdl));
+    return -1;
+  }
+
+  if(w->hdr->plus)
+  {
+    w->aw = aw;
+
+    if(edfrd_record_annotation_views(w->hdl, cnv_buf, write_annotation, w))
+    {
+      snprintf(w->errmsg, 256, "%s", edfrd_errmsg(w->hdl));
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+/* writes the rows of sched for one datarecord that starts at elapsedtime, smp_buf is laid out as out_offset */
+/* says, with opts->digital the integers in w->dig_buf are written instead                                    */
+static void write_rows(struct conv_worker *w, const struct conv_sched *sched, const double *smp_buf, long long elapsedtime,
+                       struct txw *dw)
+{
+  int i, r,
+      column,
+      precision;
+
+  const int *dig_buf;
+
+  long long t;
+
+  const struct conv_row *row;
+
+  const struct conv_emit *emit;
+
+  static const char commas[64]=",,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,";
+
+
+  precision = w->opts->precision;
+  dig_buf = w->opts->digital ? w->dig_buf : NULL;
+
+  for(r=0; r<sched->rows; r++)
+  {
+    row = sched->row + r;
+
+    t = elapsedtime + row->time;
+
+    if(w->windowed)
+    {
+      if((t < w->opts->start_time) || ((w->opts->end_time >= 0LL) && (t >= w->opts->end_time)))  continue;
+    }
+
+    txw_time(dw, t);
+
+    /* every data signal adds a comma, followed by its sample if it has one at this time */
+    column = 0;
+    emit = sched->emit + row->first;
+    for(i=0; i<row->count; i++)
+    {
+      for(; column<emit[i].column; column+=64)
+      {
+        txw_write(dw, commas, (emit[i].column - column) < 64 ? (emit[i].column - column) : 64);
+      }
+      column = emit[i].column + 1;
+
+      txw_putc(dw, ',');
+      if(dig_buf != NULL)
+      {
+        txw_int(dw, dig_buf[emit[i].smp]);
+      }
+      else
+      {
+        txw_double(dw, smp_buf[emit[i].smp], precision);
+      }
+    }
+
+    for(; column<sched->data_signals; column+=64)
+    {
+      txw_write(dw, commas, (sched->data_signals - column) < 64 ? (sched->data_signals - column) : 64);
+    }
+
+    txw_putc(dw, '\n');
+  }
+}
+
+
+/* adds the data signals of a decoded datarecord to the pyramid, smp is laid out as buf_offset says */
+static int pyramid_add(struct conv_worker *w, int recnr, const double *smp)
+{
+  int i, j;
+
+  const struct edfrd_param *param;
+
+
+  param = w->hdr->param;
+
+  for(i=0; i<w->sched.data_signals; i++)
+  {
+    j = w->sched.data_sig[i];
+
+    if(pyr_bins_add(w->bins, i, smp + param[j].buf_offset, param[j].smp_per_record,
+                    (long long)(recnr - w->pyr_first) * param[j].smp_per_record))
+    {
+      snprintf(w->errmsg, 256, "Malloc error! (pyramid)");
+      return -1;
+    }
+  }
+
+  if((w->pyr != NULL) && pyr_write_bins(w->pyr, w->bins))
+  {
+    snprintf(w->errmsg, 256, "Error when writing to outputfile during conversion");
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* converts one datarecord, the samples go to emit and the annotations to aw */
+static int convert_record(struct conv_worker *w, const char *cnv_buf, int recnr, struct txw *aw,
+                          conv_emit_fn emit, void *ctx)
+{
+  int i;
+
+  long long elapsedtime;
+
+  double *smp_buf,
+         t0=0.0,
+         t1;
+
+  const struct edfrd_hdr *hdr;
+
+  const struct conv_sched *sched;
+
+
+  hdr = w->hdr;
+  sched = &w->sched;
+  smp_buf = w->smp_buf;
+
+  if(w->stats != NULL)  t0 = conv_now();
+
+  if(record_header(w, cnv_buf, recnr, aw, &elapsedtime))  return -1;
+
+/* done with timekeeping and annotations, continue with the data */
+
+  if(w->stats != NULL)
+  {
+    t1 = conv_now();
+    w->stats->stage[CONV_STAGE_ANNOTATIONS] += t1 - t0;
+    t0 = t1;
+  }
+
+  if(w->opts->digital)
+  {
+    for(i=0; i<sched->data_signals; i++)
+    {
+      edfrd_decode_digital(hdr, cnv_buf, sched->data_sig[i], w->dig_buf + hdr->param[sched->data_sig[i]].buf_offset);
+    }
+  }
+  else
+  {
+    for(i=0; i<sched->data_signals; i++)
+    {
+      edfrd_decode_physical(hdr, cnv_buf, sched->data_sig[i], smp_buf + hdr->param[sched->data_sig[i]].buf_offset);
+    }
+  }
+
+  if((w->bins != NULL) && pyramid_add(w, recnr, smp_buf))  return -1;
+
+  if(w->stats != NULL)
+  {
+    w->stats->stage[CONV_STAGE_DECODE] += conv_now() - t0;
+    w->stats->records++;
+    w->stats->samples += w->rec_samples;
+    w->stats->bytes_read += hdr->recordbytes;
+  }
+
+  if(emit(w, smp_buf, elapsedtime, ctx))  return -1;
+
+  if(aw->error)
+  {
+    snprintf(w->errmsg, 256, "Error when writing to outputfile during conversion");
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* conv_emit_fn of the _data.txt file, ctx is its writer */
+static int emit_rows(struct conv_worker *w, const double *smp, long long starttime, void *ctx)
+{
+  double t0=0.0,
+         wsec=0.0;
+
+  struct txw *dw;
+
+
+  dw = (struct txw *)ctx;
+
+  if(w->stats != NULL)
+  {
+    t0 = conv_now();
+    wsec = dw->write_sec;
+  }
+
+  write_rows(w, &w->sched, smp, starttime, dw);
+
+  if(w->stats != NULL)
+  {
+    /* a full buffer is written out while formatting, that counts as writing */
+    w->stats->stage[CONV_STAGE_FORMAT] += (conv_now() - t0) - (dw->write_sec - wsec);
+  }
+
+  if(dw->error)
+  {
+    snprintf(w->errmsg, 256, "Error when writing to outputfile during conversion");
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* passes datarecord recnr, which is in the ring, with the resampled signals to emit */
+static int emit_resampled(struct conv_worker *w, int recnr, conv_emit_fn emit, void *ctx)
+{
+  int i, j, n,
+      slot;
+
+  double t=0.0,
+         *rec_smp;
+
+  const struct edfrd_hdr *hdr;
+
+  struct conv_rs *rs;
+
+
+  hdr = w->hdr;
+  rs = w->rs;
+
+  if(w->stats != NULL)  t = conv_now();
+
+  slot = recnr % (rs->lookahead + 1);
+  rec_smp = rs->ring + (long long)slot * hdr->recordsize;
+
+  for(i=0; i<w->sched.data_signals; i++)
+  {
+    j = w->sched.data_sig[i];
+
+    if(rs->up[j])
+    {
+      n = rsmp_pull(rs->filter + j, rs->out_buf + w->out_offset[j], w->out_spr[j]);
+      if(n != w->out_spr[j])
+      {
+        snprintf(w->errmsg, 256, "Error when resampling signal %i of datarecord %i", j + 1, recnr + 1);
+        return -1;
+      }
+    }
+    else
+    {
+      memcpy(rs->out_buf + w->out_offset[j], rec_smp + hdr->param[j].buf_offset, w->out_spr[j] * sizeof(double));
+    }
+  }
+
+  if(w->stats != NULL)  w->stats->stage[CONV_STAGE_DECODE] += conv_now() - t;
+
+  return emit(w, rs->out_buf, rs->starttime[slot], ctx);
+}
+
+
+/* Converts datarecords first_record up to last_record when the sample rate of signals   */
+/* is lowered. The filters look lookahead datarecords back and ahead, so those before    */
+/* first_record are decoded as well, and a datarecord is passed to emit after the ones   */
+/* it looks ahead at are decoded. A part of a file gives the same samples as in the      */
+/* conversion of the whole file then, so threads can convert chunks. Before the start   */
+/* and after the end of the file the filters repeat the first and last sample. The gaps */
+/* between the datarecords of an EDF+D/BDF+D file are not known to the filters, they    */
+/* see one continuous signal.                                                            */
+static int convert_resampled(struct conv_worker *w, int first_record, int last_record, struct txw *aw,
+                             conv_emit_fn emit, void *ctx)
+{
+  int i, j, r, e,
+      start,
+      slots,
+      err=0;
+
+  double t=0.0,
+         t1,
+         *rec_smp;
+
+  const char *cnv_buf;
+
+  const struct edfrd_hdr *hdr;
+
+  struct conv_rs *rs;
+
+
+  hdr = w->hdr;
+  rs = w->rs;
+  slots = rs->lookahead + 1;
+
+  start = first_record - rs->lookahead;
+  if(start < 0)  start = 0;
+
+  for(j=0; j<hdr->signals; j++)
+  {
+    if(!rs->up[j])  continue;
+
+    rsmp_free(rs->filter + j);
+
+    if(rsmp_init(rs->filter + j, rs->up[j], rs->down[j], (long long)start * hdr->param[j].smp_per_record,
+                 (long long)first_record * w->out_spr[j]))
+    {
+      snprintf(w->errmsg, 256, "Malloc error! (resampling)");
+      return -1;
+    }
+  }
+
+  edfrd_seek_record(w->hdl, start);
+
+  for(r=start; (r<(last_record + rs->lookahead)) && (r<hdr->datarecords); r++)
+  {
+    if(w->stats != NULL)  t = conv_now();
+
+    err = edfrd_read_record(w->hdl, &cnv_buf);
+
+    if(w->stats != NULL)
+    {
+      t1 = conv_now();
+      w->stats->stage[CONV_STAGE_READ] += t1 - t;
+      t = t1;
+    }
+
+    if(err < 0)
+    {
+      snprintf(w->errmsg, 256, "Error when reading inputfile during conversion");
+      return -1;
+    }
+    if(err)  break;
+
+    if((r >= first_record) && (r < last_record))
+    {
+      if(record_header(w, cnv_buf, r, aw, rs->starttime + (r % slots)))  return -1;
+
+      if(w->stats != NULL)
+      {
+        t1 = conv_now();
+        w->stats->stage[CONV_STAGE_ANNOTATIONS] += t1 - t;
+        t = t1;
+        w->stats->records++;
+        w->stats->samples += w->rec_samples;
+      }
+    }
+
+    rec_smp = rs->ring + (long long)(r % slots) * hdr->recordsize;
+
+    for(i=0; i<w->sched.data_signals; i++)
+    {
+      j = w->sched.data_sig[i];
+
+      edfrd_decode_physical(hdr, cnv_buf, j, rec_smp + hdr->param[j].buf_offset);
+
+      if(rs->up[j])
+      {
+        if(rsmp_push(rs->filter + j, rec_smp + hdr->param[j].buf_offset, hdr->param[j].smp_per_record))
+        {
+          snprintf(w->errmsg, 256, "Malloc error! (resampling)");
+          return -1;
+        }
+      }
+    }
+
+    if((w->bins != NULL) && (r >= first_record) && (r < last_record))
+    {
+      if(pyramid_add(w, r, rec_smp))  return -1;
+    }
+
+    if(w->stats != NULL)
+    {
+      w->stats->stage[CONV_STAGE_DECODE] += conv_now() - t;
+      w->stats->bytes_read += hdr->recordbytes;
+    }
+
+    if((r - rs->lookahead) >= first_record)
+    {
+      if(emit_resampled(w, r - rs->lookahead, emit, ctx))  return -1;
+    }
+  }
+
+  /* the end of the file or of the datarecords that can be read */
+  for(j=0; j<hdr->signals; j++)
+  {
+    if(rs->up[j])  rsmp_finish(rs->filter + j);
+  }
+
+  e = r - rs->lookahead;
+  if(e < first_record)  e = first_record;
+
+  for(; (e<last_record) && (e<r); e++)
+  {
+    if(emit_resampled(w, e, emit, ctx))  return -1;
+  }
+
+  if(aw->error)
+  {
+    snprintf(w->errmsg, 256, "Error when writing to outputfile during conversion");
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* start time of a datarecord, from the index or read from its timekeeping TAL when the file is EDF+/BDF+ */
+static int record_start(struct conv_worker *w, int recnr, long long *t)
+{
+  const char *rec;
+
+
+  if(w->idx != NULL)
+  {
+    *t = edfidx_record_start(w->idx, recnr);
+    return 0;
+  }
+
+  if(edfrd_seek_record(w->hdl, recnr) || edfrd_read_record(w->hdl, &rec) ||
+     edfrd_record_starttime(w->hdl, rec, recnr, t))
+  {
+    snprintf(w->errmsg, 256, "Error when reading datarecord %i", recnr + 1);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* finds the range of datarecords that covers the time window, the start times of */
+/* the datarecords of an EDF+D/BDF+D file only increase, so they can be bisected     */
+/* streams can not be bisected, there the rows outside the window are just skipped  */
+static int find_records(struct conv_worker *w, int seekable, int *first, int *last)
+{
+  int lo, hi, mid;
+
+  long long t,
+            duration;
+
+  const struct edfrd_hdr *hdr;
+
+
+  hdr = w->hdr;
+
+  *first = 0;
+  *last = hdr->datarecords;
+
+  if((!w->windowed) || (hdr->datarecords < 1))  return 0;
+
+  duration = hdr->data_record_duration;
+
+  if(!hdr->plus)
+  {
+    if(duration < 1)  return 0;
+
+    if((w->opts->start_time / duration) < hdr->datarecords)
+    {
+      *first = w->opts->start_time / duration;
+    }
+    else
+    {
+      *first = hdr->datarecords;
+    }
+
+    if((w->opts->end_time >= 0LL) && (((w->opts->end_time + duration - 1) / duration) < hdr->datarecords))
+    {
+      *last = (w->opts->end_time + duration - 1) / duration;
+    }
+
+    return 0;
+  }
+
+  if(!seekable)  return 0;
+
+  /* the last datarecord that starts at or before the start of the window */
+  lo = 0;
+  hi = hdr->datarecords - 1;
+  while(lo < hi)
+  {
+    mid = lo + ((hi - lo + 1) / 2);
+    if(record_start(w, mid, &t))  return -1;
+    if(t <= w->opts->start_time)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid - 1;
+    }
+  }
+  *first = lo;
+
+  /* in an EDF+D/BDF+D file the window can start in a gap after that datarecord */
+  if(record_start(w, lo, &t))  return -1;
+  if(((t + duration) <= w->opts->start_time) && (lo < (hdr->datarecords - 1)))
+  {
+    *first = lo + 1;
+  }
+
+  /* the first datarecord that starts at or after the end of the window */
+  if(w->opts->end_time >= 0LL)
+  {
+    lo = *first;
+    hi = hdr->datarecords;
+    while(lo < hi)
+    {
+      mid = lo + ((hi - lo) / 2);
+      if(record_start(w, mid, &t))  return -1;
+      if(t >= w->opts->end_time)
+      {
+        hi = mid;
+      }
+      else
+      {
+        lo = mid + 1;
+      }
+    }
+    *last = lo;
+  }
+
+  return 0;
+}
+
+
+/* Writes the annotations of the datarecords first_record up to last_record to aw. They */
+/* come from the index when there is one, otherwise only the annotation signals of the  */
+/* datarecords are read, with positioned reads or from the memory map, and no samples  */
+/* are decoded.                                                                          */
+static int convert_annotations(struct conv_worker *w, int first_record, int last_record, struct txw *aw,
+                               char *errmsg, int errmsg_len)
+{
+  int i, r,
+      annot_bytes=0,
+      err=0,
+      *selected=NULL;
+
+  long long starttime;
+
+  double t=0.0,
+         t1;
+
+  const char *line,
+             *duration,
+             *text;
+
+  struct edfrd_annot annot;
+
+  const char *cnv_buf;
+
+  const struct edfrd_hdr *hdr;
+
+  const struct edfidx *idx;
+
+
+  hdr = w->hdr;
+  idx = w->idx;
+
+  if(!hdr->plus)  return 0;
+
+  w->aw = aw;
+
+  if(idx != NULL)
+  {
+    for(i=0; i<idx->nr_annots; i++)
+    {
+      if((idx->annot[i].record < first_record) || (idx->annot[i].record >= last_record))  continue;
+
+      /* onset,duration,text */
+      line = idx->text + idx->annot[i].line;
+      duration = strchr(line, ',');
+      if(duration == NULL)  continue;
+      text = strchr(duration + 1, ',');
+      if(text == NULL)  continue;
+
+      annot.onset = idx->annot[i].onset;
+      annot.onset_txt = line;
+      annot.onset_len = duration - line;
+      annot.duration_txt = duration + 1;
+      annot.duration_len = text - (duration + 1);
+      annot.duration = annot.duration_len ? edfrd_parse_time(annot.duration_txt, annot.duration_len) : -1LL;
+      annot.text = text + 1;
+      annot.text_len = strlen(text + 1);
+
+      write_annotation(w, &annot);
+    }
+
+    if(aw->error)
+    {
+      snprintf(errmsg, errmsg_len, "Error when writing to outputfile during conversion");
+      return -1;
+    }
+
+    return 0;
+  }
+
+  /* no data signals, the annotation signals are always read */
+  selected = (int *)calloc(hdr->signals, sizeof(int));
+  if(selected == NULL)
+  {
+    snprintf(errmsg, errmsg_len, "Malloc error! (annotations)");
+    return -1;
+  }
+
+  if(edfrd_select_signals(w->hdl, selected))
+  {
+    snprintf(errmsg, errmsg_len, "%s", edfrd_errmsg(w->hdl));
+    free(selected);
+    return -1;
+  }
+
+  free(selected);
+
+  for(i=0; i<hdr->nr_annot_chns; i++)
+  {
+    annot_bytes += hdr->param[hdr->annot_ch[i]].smp_per_record * hdr->samplesize;
+  }
+
+  edfrd_seek_record(w->hdl, first_record);
+
+  for(r=first_record; r<last_record; r++)
+  {
+    if(w->stats != NULL)  t = conv_now();
+
+    err = edfrd_read_record(w->hdl, &cnv_buf);
+
+    if(w->stats != NULL)
+    {
+      t1 = conv_now();
+      w->stats->stage[CONV_STAGE_READ] += t1 - t;
+      t = t1;
+    }
+
+    if(err)  break;
+
+    if(record_header(w, cnv_buf, r, aw, &starttime))
+    {
+      snprintf(errmsg, errmsg_len, "%s", w->errmsg);
+      return -1;
+    }
+
+    if(w->stats != NULL)
+    {
+      w->stats->stage[CONV_STAGE_ANNOTATIONS] += conv_now() - t;
+      w->stats->records++;
+      w->stats->bytes_read += annot_bytes;
+    }
+
+    if(aw->error)
+    {
+      snprintf(errmsg, errmsg_len, "Error when writing to outputfile during conversion");
+      return -1;
+    }
+  }
+
+  if(err<0)
+  {
+    snprintf(errmsg, errmsg_len, "Error when reading inputfile during conversion");
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* creates _pyramid.bin for the datarecords first_record up to last_record, the worker */
+/* then adds every datarecord it decodes                                                */
+static int open_pyramid(struct conv_worker *w, struct pyr *pyr, struct pyr_bins *bins, char *ascii_path, int base_len,
+                        int first_record, int last_record, char *errmsg, int errmsg_len)
+{
+  int i,
+      *spr;
+
+
+  if(!base_len)
+  {
+    snprintf(errmsg, errmsg_len, "Error, the pyramid needs an output name when reading from stdin");
+    return -1;
+  }
+
+  spr = (int *)malloc((w->sched.data_signals + 1) * sizeof(int));
+  if(spr == NULL)
+  {
+    snprintf(errmsg, errmsg_len, "Malloc error! (pyramid)");
+    return -1;
+  }
+
+  for(i=0; i<w->sched.data_signals; i++)
+  {
+    spr[i] = w->hdr->param[w->sched.data_sig[i]].smp_per_record;
+  }
+
+  ascii_path[base_len] = 0;
+  strcat(ascii_path, "_pyramid.bin");
+
+  if(pyr_open(pyr, ascii_path, w->sched.data_signals, w->sched.data_sig, spr, last_record - first_record,
+              w->hdr->data_record_duration, first_record))
+  {
+    snprintf(errmsg, errmsg_len, "Error, can not open file %s for writing", ascii_path);
+    free(spr);
+    return -1;
+  }
+
+  free(spr);
+
+  ascii_path[base_len] = 0;
+
+  if(pyr_bins_init(bins, w->sched.data_signals))
+  {
+    snprintf(errmsg, errmsg_len, "Malloc error! (pyramid)");
+    return -1;
+  }
+
+  w->pyr = pyr;
+  w->bins = bins;
+  w->pyr_first = first_record;
+
+  return 0;
+}
+
+
+/* reads the sidecar index of a file, or makes it when there is none yet */
+/* or the index belongs to the file as it was before it changed          */
+static int load_index(struct edfidx *idx, const char *path, const struct conv_opts *opts, const struct edfrd_hdr *hdr,
+                      char *errmsg, int errmsg_len)
+{
+  int err;
+
+  char idx_path[1100];
+
+
+  if(opts->index_path != NULL)
+  {
+    snprintf(idx_path, sizeof(idx_path), "%s", opts->index_path);
+  }
+  else
+  {
+    snprintf(idx_path, sizeof(idx_path), "%s.idx", path);
+  }
+
+  err = edfidx_read(idx, idx_path, path, errmsg, errmsg_len);
+  if(err < 0)  return -1;
+
+  if(!err)
+  {
+    if((idx->signals == hdr->signals) && (idx->recordbytes == hdr->recordbytes) &&
+       (idx->datarecords == hdr->datarecords) && (idx->record_duration == hdr->data_record_duration))
+    {
+      return 0;
+    }
+
+    edfidx_free(idx);
+  }
+
+  if(edfidx_build(idx, path, errmsg, errmsg_len))  return -1;
+
+  if(edfidx_write(idx, idx_path, errmsg, errmsg_len))
+  {
+    edfidx_free(idx);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+static void * conv_thread(void *arg)
+{
+  int c, r,
+      first,
+      last,
+      err,
+      init_err;
+
+  double t=0.0,
+         cpu;
+
+  const char *cnv_buf;
+
+  struct conv_pool *pool;
+
+  struct conv_chunk *slot;
+
+  struct conv_worker w;
+
+  struct conv_stats stats;
+
+
+  pool = (struct conv_pool *)arg;
+
+  cpu = conv_cpu_time();
+
+  memset(&stats, 0, sizeof(struct conv_stats));
+
+  init_err = worker_init(&w, pool->path, NULL, pool->opts);
+
+  if(pool->stats != NULL)  w.stats = &stats;
+
+  while(1)
+  {
+    pthread_mutex_lock(&pool->lock);
+    while((!pool->abort) && (pool->next_chunk < pool->nr_chunks) &&
+          (pool->next_chunk >= (pool->written_chunk + pool->window)))
+    {
+      pthread_cond_wait(&pool->cond, &pool->lock);
+    }
+    if(pool->abort || (pool->next_chunk >= pool->nr_chunks))
+    {
+      pthread_mutex_unlock(&pool->lock);
+      break;
+    }
+    c = pool->next_chunk++;
+    pthread_mutex_unlock(&pool->lock);
+
+    slot = pool->slots + (c % pool->window);
+    slot->data.len = 0;
+    slot->annot.len = 0;
+    slot->error = 0;
+
+    if(pool->pyr != NULL)
+    {
+      pyr_bins_clear(&slot->bins);
+      w.bins = &slot->bins;
+      w.pyr_first = pool->first_record;
+    }
+
+    if(init_err)
+    {
+      snprintf(slot->errmsg, 256, "%s", w.errmsg);
+      slot->error = 1;
+    }
+    else
+    {
+      first = pool->first_record + (c * pool->chunk_records);
+      last = first + pool->chunk_records;
+      if(last > pool->last_record)  last = pool->last_record;
+
+      if(w.rs != NULL)
+      {
+        if(convert_resampled(&w, first, last, &slot->annot, emit_rows, &slot->data))
+        {
+          snprintf(slot->errmsg, 256, "%s", w.errmsg);
+          slot->error = 1;
+        }
+      }
+      else
+      {
+        edfrd_seek_record(w.hdl, first);
+
+        for(r=first; r<last; r++)
+        {
+          if(w.stats != NULL)  t = conv_now();
+
+          err = edfrd_read_record(w.hdl, &cnv_buf);
+
+          if(w.stats != NULL)  stats.stage[CONV_STAGE_READ] += conv_now() - t;
+
+          if(err)
+          {
+            snprintf(slot->errmsg, 256, "Error when reading inputfile during conversion");
+            slot->error = 1;
+            break;
+          }
+
+          if(convert_record(&w, cnv_buf, r, &slot->annot, emit_rows, &slot->data))
+          {
+            snprintf(slot->errmsg, 256, "%s", w.errmsg);
+            slot->error = 1;
+            break;
+          }
+        }
+      }
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    slot->ready = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  worker_free(&w);
+
+  if(pool->stats != NULL)
+  {
+    stats.cpu = conv_cpu_time() - cpu;
+
+    pthread_mutex_lock(&pool->lock);
+    stats_add(pool->stats, &stats);
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  return NULL;
+}
+
+
+/* converts all datarecords with several threads, the chunks are written in order */
+static int convert_parallel(const char *path, const struct conv_opts *opts, const struct edfrd_hdr *hdr,
+                            int first_record, int last_record, struct txw *datawriter, struct txw *annotwriter,
+                            struct pyr *pyr, struct conv_stats *stats, char *errmsg, int errmsg_len)
+{
+  int i, c,
+      records,
+      threads,
+      started=0,
+      err=0;
+
+  pthread_t *tids=NULL;
+
+  struct conv_pool pool;
+
+  struct conv_chunk *slot;
+
+
+  threads = opts->threads;
+
+  memset(&pool, 0, sizeof(struct conv_pool));
+  pool.path = path;
+  pool.opts = opts;
+  pool.stats = stats;
+  pool.pyr = pyr;
+  pool.first_record = first_record;
+  pool.last_record = last_record;
+  records = last_record - first_record;
+  pool.chunk_records = CONV_CHUNK_SAMPLES / hdr->recordsize;
+  if(pool.chunk_records > ((records + (threads * 4) - 1) / (threads * 4)))
+  {
+    pool.chunk_records = (records + (threads * 4) - 1) / (threads * 4);
+  }
+  if(pool.chunk_records < 1)  pool.chunk_records = 1;
+  pool.nr_chunks = (records + pool.chunk_records - 1) / pool.chunk_records;
+  pool.window = threads * 2;
+
+  pool.slots = (struct conv_chunk *)calloc(pool.window, sizeof(struct conv_chunk));
+  tids = (pthread_t *)calloc(threads, sizeof(pthread_t));
+  if((pool.slots==NULL)||(tids==NULL))
+  {
+    snprintf(errmsg, errmsg_len, "Malloc error! (threads)");
+    free(pool.slots);
+    free(tids);
+    return -1;
+  }
+
+  for(i=0; i<pool.window; i++)
+  {
+    if(txw_init(&pool.slots[i].data, NULL, TXW_BUFSIZE) || txw_init(&pool.slots[i].annot, NULL, TXW_BUFSIZE / 16) ||
+       ((pyr != NULL) && pyr_bins_init(&pool.slots[i].bins, pyr->signals)))
+    {
+      snprintf(errmsg, errmsg_len, "Malloc error! (chunk buffers)");
+      err = -1;
+      goto OUT;
+    }
+  }
+
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.cond, NULL);
+
+  for(started=0; started<threads; started++)
+  {
+    if(pthread_create(tids + started, NULL, conv_thread, &pool))
+    {
+      snprintf(errmsg, errmsg_len, "Error, can not create thread");
+      err = -1;
+      break;
+    }
+  }
+
+  for(c=0; (c<pool.nr_chunks) && started && !err; c++)
+  {
+    slot = pool.slots + (c % pool.window);
+
+    pthread_mutex_lock(&pool.lock);
+    while(!slot->ready)
+    {
+      pthread_cond_wait(&pool.cond, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    /* whatever was converted before an error is written, just like in a sequential run */
+    txw_append(datawriter, &slot->data);
+    txw_append(annotwriter, &slot->annot);
+    if(pyr != NULL)  pyr_write_bins(pyr, &slot->bins);
+
+    if(slot->error)
+    {
+      snprintf(errmsg, errmsg_len, "%s", slot->errmsg);
+      err = -1;
+    }
+    else if(datawriter->error || annotwriter->error || ((pyr != NULL) && pyr->error))
+      {
+        snprintf(errmsg, errmsg_len, "Error when writing to outputfile during conversion");
+        err = -1;
+      }
+
+    pthread_mutex_lock(&pool.lock);
+    slot->ready = 0;
+    pool.written_chunk++;
+    if(err)  pool.abort = 1;
+    pthread_cond_broadcast(&pool.cond);
+    pthread_mutex_unlock(&pool.lock);
+  }
+
+  if(!started)  err = -1;
+
+  pthread_mutex_lock(&pool.lock);
+  pool.abort = 1;
+  pthread_cond_broadcast(&pool.cond);
+  pthread_mutex_unlock(&pool.lock);
+
+  for(i=0; i<started; i++)
+  {
+    pthread_join(tids[i], NULL);
+  }
+
+  pthread_cond_destroy(&pool.cond);
+  pthread_mutex_destroy(&pool.lock);
+
+OUT:
+
+  for(i=0; i<pool.window; i++)
+  {
+    txw_free(&pool.slots[i].data);
+    txw_free(&pool.slots[i].annot);
+    pyr_bins_free(&pool.slots[i].bins);
+  }
+  free(pool.slots);
+  free(tids);
+
+  return err;
+}
+
+
+/* the .npy files of convert_npy() */
+struct conv_npy{
+         struct npyw *recw;
+         struct npyw *sigw;         /* per data signal */
+         float *fbuf;
+       };
+
+
+/* conv_emit_fn of the .npy files, ctx is a struct conv_npy */
+static int emit_npy(struct conv_worker *w, const double *smp, long long starttime, void *ctx)
+{
+  int i, j, k;
+
+  double t=0.0;
+
+  struct conv_npy *npy;
+
+
+  npy = (struct conv_npy *)ctx;
+
+  if(w->stats != NULL)  t = conv_now();
+
+  npyw_write(npy->recw, &starttime, 1);
+
+  for(i=0; i<w->sched.data_signals; i++)
+  {
+    j = w->sched.data_sig[i];
+
+    if(w->opts->float32)
+    {
+      for(k=0; k<w->out_spr[j]; k++)
+      {
+        npy->fbuf[k] = smp[w->out_offset[j] + k];
+      }
+      npyw_write(npy->sigw + i, npy->fbuf, w->out_spr[j]);
+    }
+    else
+    {
+      npyw_write(npy->sigw + i, smp + w->out_offset[j], w->out_spr[j]);
+    }
+  }
+
+  if(w->stats != NULL)  w->stats->stage[CONV_STAGE_WRITE] += conv_now() - t;
+
+  if(npy->recw->error)
+  {
+    snprintf(w->errmsg, 256, "Error when writing to outputfile during conversion");
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* reads a checkpoint file, when it does not exist yet the conversion starts at the beginning */
+static int ckpt_read(const char *path, struct conv_ckpt *ckpt, char *errmsg, int errmsg_len)
+{
+  int n=0;
+
+  char line[256];
+
+  FILE *f;
+
+
+  memset(ckpt, 0, sizeof(struct conv_ckpt));
+
+  f = fopen(path, "rb");
+  if(f == NULL)  return 0;
+
+  if((fgets(line, sizeof(line), f) == NULL) || strcmp(line, "edf2ascii checkpoint\n"))
+  {
+    snprintf(errmsg, errmsg_len, "Error, %s is not a checkpoint file", path);
+    fclose(f);
+    return -1;
+  }
+
+  while(fgets(line, sizeof(line), f) != NULL)
+  {
+    n += sscanf(line, "records %i", &ckpt->records);
+    n += sscanf(line, "signals %i", &ckpt->signals);
+    n += sscanf(line, "recordbytes %i", &ckpt->recordbytes);
+    n += sscanf(line, "data_bytes %lli", &ckpt->data_bytes);
+    n += sscanf(line, "annotation_bytes %lli", &ckpt->annot_bytes);
+  }
+
+  fclose(f);
+
+  if((n != 5) || (ckpt->records < 0) || (ckpt->data_bytes < 0) || (ckpt->annot_bytes < 0))
+  {
+    snprintf(errmsg, errmsg_len, "Error, checkpoint file %s is damaged", path);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* writes the checkpoint to a temporary file first, so it is never found half written */
+static int ckpt_write(const char *path, const struct conv_ckpt *ckpt, char *errmsg, int errmsg_len)
+{
+  int err;
+
+  char tmp_path[1100];
+
+  FILE *f;
+
+
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+  f = fopen(tmp_path, "wb");
+  if(f == NULL)
+  {
+    snprintf(errmsg, errmsg_len, "Error, can not open file %s for writing", tmp_path);
+    return -1;
+  }
+
+  fprintf(f, "edf2ascii checkpoint\n");
+  fprintf(f, "records %i\n", ckpt->records);
+  fprintf(f, "signals %i\n", ckpt->signals);
+  fprintf(f, "recordbytes %i\n", ckpt->recordbytes);
+  fprintf(f, "data_bytes %lli\n", ckpt->data_bytes);
+  fprintf(f, "annotation_bytes %lli\n", ckpt->annot_bytes);
+
+  err = ferror(f);
+  if(fclose(f))  err = 1;
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+  /* rename() does not replace a file here */
+  if(!err)  remove(path);
+#endif
+
+  if(err || rename(tmp_path, path))
+  {
+    snprintf(errmsg, errmsg_len, "Error, can not write checkpoint file %s", path);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* Converts a file that may still be recorded, from the datarecord in the checkpoint on.  */
+/* The datarecords that are in the file are converted, with opts->follow it then waits    */
+/* for new ones until the recording is closed or none came for opts->follow_idle seconds. */
+/* After every batch the outputs are flushed and the checkpoint is written, so a next run */
+/* continues there, also when this one was killed halfway.                                 */
+static int convert_follow(struct conv_worker *w, struct conv_ckpt *ckpt, struct txw *dw, struct txw *aw,
+                          FILE *datafile, FILE *annotfile, char *errmsg, int errmsg_len)
+{
+  int r,
+      err,
+      closed;
+
+  double t=0.0,
+         t_new;
+
+  const char *cnv_buf;
+
+  const struct conv_opts *opts;
+
+
+  opts = w->opts;
+
+  t_new = conv_now();
+
+  while(1)
+  {
+    closed = edfrd_refresh(w->hdl);
+    if(closed < 0)
+    {
+      snprintf(errmsg, errmsg_len, "%s", edfrd_errmsg(w->hdl));
+      return -1;
+    }
+
+    if(ckpt->records > w->hdr->datarecords)
+    {
+      snprintf(errmsg, errmsg_len, "Error, the file has fewer datarecords than the checkpoint says");
+      return -1;
+    }
+
+    if(ckpt->records < w->hdr->datarecords)
+    {
+      edfrd_seek_record(w->hdl, ckpt->records);
+
+      for(r=ckpt->records; r<w->hdr->datarecords; r++)
+      {
+        if(w->stats != NULL)  t = conv_now();
+
+        err = edfrd_read_record(w->hdl, &cnv_buf);
+
+        if(w->stats != NULL)  w->stats->stage[CONV_STAGE_READ] += conv_now() - t;
+
+        if(err)
+        {
+          snprintf(errmsg, errmsg_len, "Error when reading inputfile during conversion");
+          return -1;
+        }
+
+        if(convert_record(w, cnv_buf, r, aw, emit_rows, dw))
+        {
+          snprintf(errmsg, errmsg_len, "%s", w->errmsg);
+          return -1;
+        }
+      }
+
+      if(txw_flush(dw) || txw_flush(aw) || fflush(datafile) || fflush(annotfile))
+      {
+        snprintf(errmsg, errmsg_len, "Error when writing to outputfile during conversion");
+        return -1;
+      }
+
+      ckpt->records = r;
+
+      if(opts->checkpoint != NULL)
+      {
+        ckpt->data_bytes = ftello(datafile);
+        ckpt->annot_bytes = ftello(annotfile);
+
+        if(ckpt_write(opts->checkpoint, ckpt, errmsg, errmsg_len))  return -1;
+      }
+
+      t_new = conv_now();
+    }
+
+    if((!opts->follow) || (closed == EDFRD_EOF))  break;
+
+    if((opts->follow_idle > 0.0) && ((conv_now() - t_new) >= opts->follow_idle))  break;
+
+    conv_sleep(CONV_FOLLOW_POLL_MSEC);
+  }
+
+  return 0;
+}
+
+
+/* Writes the selected signals as .npy files, one array of physical values per */
+/* signal, plus the start time of every datarecord in nanoSeconds. Sample k of   */
+/* datarecord r of a signal lies at records[r] + k * duration / smp_per_record,  */
+/* where smp_per_record is the one in _columns.txt after resampling.             */
+/* The time window selects whole datarecords, so that relation always holds.     */
+/* For EDF+ and BDF+ the onset and duration (-1 for none) of every line in the   */
+/* _annotations file go to _annotation_onsets.npy and _annotation_durations.npy, */
+/* in nanoSeconds.                                                                */
+static int convert_npy(struct conv_worker *w, char *ascii_path, int base_len, int first_record, int last_record,
+                       struct txw *annotwriter, char *errmsg, int errmsg_len)
+{
+  int i, j, r,
+      itemsize,
+      name_len,
+      err=0;
+
+  long long starttime;
+
+  double t=0.0,
+         t1;
+
+  float *fbuf=NULL;
+
+  const char *cnv_buf;
+
+  const char *type,
+             *name;
+
+  const struct edfrd_hdr *hdr;
+
+  const struct conv_sched *sched;
+
+  struct npyw recw,
+              onsetw,
+              durationw,
+              *sigw=NULL;
+
+  struct conv_npy npy;
+
+  FILE *columnsfile=NULL;
+
+
+  hdr = w->hdr;
+  sched = &w->sched;
+
+  memset(&recw, 0, sizeof(struct npyw));
+  memset(&onsetw, 0, sizeof(struct npyw));
+  memset(&durationw, 0, sizeof(struct npyw));
+
+  sigw = (struct npyw *)calloc(sched->data_signals + 1, sizeof(struct npyw));
+  fbuf = (float *)malloc(hdr->recordsize * sizeof(float));
+  if((sigw==NULL)||(fbuf==NULL))
+  {
+    snprintf(errmsg, errmsg_len, "Malloc error! (npy)");
+    err = -1;
+    goto OUT;
+  }
+
+  if(w->opts->digital)
+  {
+    type = (hdr->samplesize == 2) ? "i2" : "i4";
+    itemsize = (hdr->samplesize == 2) ? sizeof(short) : sizeof(int);
+  }
+  else
+  {
+    type = w->opts->float32 ? "f4" : "f8";
+    itemsize = w->opts->float32 ? sizeof(float) : sizeof(double);
+  }
+
+  ascii_path[base_len] = 0;
+  strcat(ascii_path, "_records.npy");
+  if(npyw_open(&recw, ascii_path, "i8", sizeof(long long)))
+  {
+    snprintf(errmsg, errmsg_len, "Error, can not open file %s for writing", ascii_path);
+    err = -1;
+    goto OUT;
+  }
+
+  if(hdr->plus)
+  {
+    ascii_path[base_len] = 0;
+    strcat(ascii_path, "_annotation_onsets.npy");
+    if(npyw_open(&onsetw, ascii_path, "i8", sizeof(long long)))
+    {
+      snprintf(errmsg, errmsg_len, "Error, can not open file %s for writing", ascii_path);
+      err = -1;
+      goto OUT;
+    }
+
+    ascii_path[base_len] = 0;
+    strcat(ascii_path, "_annotation_durations.npy");
+    if(npyw_open(&durationw, ascii_path, "i8", sizeof(long long)))
+    {
+      snprintf(errmsg, errmsg_len, "Error, can not open file %s for writing", ascii_path);
+      err = -1;
+      goto OUT;
+    }
+
+    w->onsetw = &onsetw;
+    w->durationw = &durationw;
+  }
+
+  for(i=0; i<sched->data_signals; i++)
+  {
+    ascii_path[base_len] = 0;
+    sprintf(ascii_path + base_len, "_signal%i.npy", sched->data_sig[i] + 1);
+    if(npyw_open(sigw + i, ascii_path, type, itemsize))
+    {
+      snprintf(errmsg, errmsg_len, "Error, can not open file %s for writing", ascii_path);
+      err = -1;
+      goto OUT;
+    }
+  }
+
+  if(w->rs != NULL)
+  {
+    npy.recw = &recw;
+    npy.sigw = sigw;
+    npy.fbuf = fbuf;
+
+    if(convert_resampled(w, first_record, last_record, annotwriter, emit_npy, &npy))
+    {
+      snprintf(errmsg, errmsg_len, "%s", w->errmsg);
+      err = -1;
+      goto OUT;
+    }
+  }
+  else
+  {
+    edfrd_seek_record(w->hdl, first_record);
+
+    for(r=first_record; r<last_record; r++)
+    {
+      if(w->stats != NULL)  t = conv_now();
+
+      if(edfrd_read_record(w->hdl, &cnv_buf))
+      {
+        snprintf(errmsg, errmsg_len, "Error when reading inputfile during conversion");
+        err = -1;
+        goto OUT;
+      }
+
+      if(w->stats != NULL)
+      {
+        t1 = conv_now();
+        w->stats->stage[CONV_STAGE_READ] += t1 - t;
+        t = t1;
+      }
+
+      if(record_header(w, cnv_buf, r, annotwriter, &starttime))
+      {
+        snprintf(errmsg, errmsg_len, "%s", w->errmsg);
+        err = -1;
+        goto OUT;
+      }
+
+      if(w->stats != NULL)
+      {
+        t1 = conv_now();
+        w->stats->stage[CONV_STAGE_ANNOTATIONS] += t1 - t;
+        t = t1;
+      }
+
+      npyw_write(&recw, &starttime, 1);
+
+      for(i=0; i<sched->data_signals; i++)
+      {
+        j = sched->data_sig[i];
+
+        if(w->opts->digital)
+        {
+          /* EDF values are stored as int16, dig_buf has room for them */
+          if(hdr->samplesize == 2)
+          {
+            edfrd_decode_digital16(hdr, cnv_buf, j, (short *)w->dig_buf);
+          }
+          else
+          {
+            edfrd_decode_digital(hdr, cnv_buf, j, w->dig_buf);
+          }
+        }
+        else if(w->opts->float32)
+          {
+            edfrd_decode_physical_f(hdr, cnv_buf, j, fbuf);
+          }
+          else
+          {
+            edfrd_decode_physical(hdr, cnv_buf, j, w->smp_buf);
+          }
+
+        if(w->bins != NULL)
+        {
+          if(w->opts->float32)
+          {
+            err = pyr_bins_add_f(w->bins, i, fbuf, hdr->param[j].smp_per_record,
+                                 (long long)(r - w->pyr_first) * hdr->param[j].smp_per_record);
+          }
+          else
+          {
+            err = pyr_bins_add(w->bins, i, w->smp_buf, hdr->param[j].smp_per_record,
+                               (long long)(r - w->pyr_first) * hdr->param[j].smp_per_record);
+          }
+          if(err)
+          {
+            snprintf(errmsg, errmsg_len, "Malloc error! (pyramid)");
+            goto OUT;
+          }
+        }
+
+        if(w->stats != NULL)
+        {
+          t1 = conv_now();
+          w->stats->stage[CONV_STAGE_DECODE] += t1 - t;
+          t = t1;
+        }
+
+        if(w->opts->digital)
+        {
+          npyw_write(sigw + i, w->dig_buf, hdr->param[j].smp_per_record);
+        }
+        else if(w->opts->float32)
+          {
+            npyw_write(sigw + i, fbuf, hdr->param[j].smp_per_record);
+          }
+          else
+          {
+            npyw_write(sigw + i, w->smp_buf, hdr->param[j].smp_per_record);
+          }
+
+        if(w->stats != NULL)
+        {
+          t1 = conv_now();
+          w->stats->stage[CONV_STAGE_WRITE] += t1 - t;
+          t = t1;
+        }
+      }
+
+      if(w->stats != NULL)
+      {
+        w->stats->records++;
+        w->stats->samples += w->rec_samples;
+        w->stats->bytes_read += hdr->recordbytes;
+      }
+
+      if(w->bins != NULL)  pyr_write_bins(w->pyr, w->bins);
+
+      if(recw.error || annotwriter->error || ((w->bins != NULL) && w->pyr->error))
+      {
+        snprintf(errmsg, errmsg_len, "Error when writing to outputfile during conversion");
+        err = -1;
+        goto OUT;
+      }
+    }
+  }
+
+/***************** write the list of columns ******************************/
+
+  ascii_path[base_len] = 0;
+  strcat(ascii_path, "_columns.txt");
+  columnsfile = fopen(ascii_path, "wb");
+  if(columnsfile==NULL)
+  {
+    snprintf(errmsg, errmsg_len, "Error, can not open file %s for writing", ascii_path);
+    err = -1;
+    goto OUT;
+  }
+
+  fprintf(columnsfile, "File,Signal,Type,Samples,Smp/Rec,Timebase\n");
+
+  /* the files are named after the output, not after the input file */
+  name = output_name(ascii_path, base_len, &name_len);
+
+  for(i=0; i<sched->data_signals; i++)
+  {
+    j = sched->data_sig[i];
+
+    fprintf(columnsfile, "%.*s_signal%i.npy,%i,%s,%lli,%i,%.*s_records.npy\n",
+            name_len, name, j + 1, j + 1, type, sigw[i].count,
+            w->out_spr[j], name_len, name);
+  }
+
+OUT:
+
+  if(w->stats != NULL)
+  {
+    w->stats->bytes_written += NPYW_HDR_LEN + recw.count * (long long)sizeof(long long);
+
+    if(hdr->plus)
+    {
+      w->stats->bytes_written += 2 * (NPYW_HDR_LEN + onsetw.count * (long long)sizeof(long long));
+    }
+
+    for(i=0; (sigw!=NULL)&&(i<sched->data_signals); i++)
+    {
+      w->stats->bytes_written += NPYW_HDR_LEN + sigw[i].count * sigw[i].itemsize;
+    }
+
+    if(columnsfile != NULL)  w->stats->bytes_written += ftello(columnsfile);
+  }
+
+  for(i=0; (sigw!=NULL)&&(i<sched->data_signals); i++)
+  {
+    if(npyw_close(sigw + i) && !err)
+    {
+      snprintf(errmsg, errmsg_len, "Error when writing to outputfile during conversion");
+      err = -1;
+    }
+  }
+
+  if(npyw_close(&recw) && !err)
+  {
+    snprintf(errmsg, errmsg_len, "Error when writing to outputfile during conversion");
+    err = -1;
+  }
+
+  w->onsetw = NULL;
+  w->durationw = NULL;
+
+  if(npyw_close(&onsetw) && !err)
+  {
+    snprintf(errmsg, errmsg_len, "Error when writing to outputfile during conversion");
+    err = -1;
+  }
+
+  if(npyw_close(&durationw) && !err)
+  {
+    snprintf(errmsg, errmsg_len, "Error when writing to outputfile during conversion");
+    err = -1;
+  }
+
+  if(columnsfile != NULL)
+  {
+    if(fclose(columnsfile) && !err)
+    {
+      snprintf(errmsg, errmsg_len, "Error when writing to outputfile during conversion");
+      err = -1;
+    }
+  }
+
+  free(sigw);
+  free(fbuf);
+
+  return err;
+}
+
+
+/* dest as in open_output(), stdout and file descriptors are not files that can be continued */
+static int output_is_file(const char *dest)
+{
+  return (dest == NULL) || (strcmp(dest, "-") && strncmp(dest, "fd:", 3));
+}
+
+
+/* the filename of an output, dest as in open_output(), NULL for stdout and file descriptors */
+static const char * output_path(const char *dest, const char *base, const char *suffix, char *path, int path_len)
+{
+  if(!output_is_file(dest))  return NULL;
+
+  if(dest != NULL)  return dest;
+
+  if(base[0] == 0)  return CONV_NULL_DEVICE;
+
+  snprintf(path, path_len, "%s%s", base, suffix);
+
+  return path;
+}
+
+
+/* Opens one of the output files. dest is "-" for stdout, "fd:N" for a file descriptor */
+/* that is already open, or a filename. Without dest the name is base + suffix, when   */
+/* there is no base either (input from stdin) the output is discarded.                  */
+static FILE * open_output(const char *dest, const char *base, const char *suffix, char *errmsg, int errmsg_len)
+{
+  char path[1100];
+
+  const char *name;
+
+  FILE *f;
+
+
+  name = output_path(dest, base, suffix, path, sizeof(path));
+
+  if(name == NULL)
+  {
+    if(!strcmp(dest, "-"))  return stdout;
+
+    f = fdopen(atoi(dest + 3), "wb");
+    if(f == NULL)
+    {
+      snprintf(errmsg, errmsg_len, "Error, can not write to file descriptor %s", dest + 3);
+    }
+    return f;
+  }
+
+  f = fopen(name, "wb");
+  if(f == NULL)
+  {
+    snprintf(errmsg, errmsg_len, "Error, can not open file %s for writing", name);
+  }
+
+  return f;
+}
+
+
+/* opens an output file of an earlier run again to continue it after size bytes, */
+/* what comes after that was written after the last checkpoint and is cut off    */
+static FILE * resume_output(const char *dest, const char *base, const char *suffix, long long size,
+                            char *errmsg, int errmsg_len)
+{
+  char path[1100];
+
+  const char *name;
+
+  FILE *f;
+
+
+  name = output_path(dest, base, suffix, path, sizeof(path));
+  if(name == NULL)
+  {
+    snprintf(errmsg, errmsg_len, "Error, with a checkpoint the outputs must be files");
+    return NULL;
+  }
+
+  f = fopen(name, "r+b");
+  if(f == NULL)
+  {
+    snprintf(errmsg, errmsg_len, "Error, can not open file %s to continue it", name);
+    return NULL;
+  }
+
+  if(fseeko(f, 0, SEEK_END) || (ftello(f) < size))
+  {
+    snprintf(errmsg, errmsg_len, "Error, file %s is shorter than the checkpoint says", name);
+    fclose(f);
+    return NULL;
+  }
+
+  if(ftruncate(fileno(f), (off_t)size) || fseeko(f, (off_t)size, SEEK_SET))
+  {
+    snprintf(errmsg, errmsg_len, "Error, can not cut file %s back to the checkpoint", name);
+    fclose(f);
+    return NULL;
+  }
+
+  return f;
+}
+
+
+/* stdout stays open, it is only flushed */
+static int close_output(FILE *f)
+{
+  if(f == NULL)  return 0;
+
+  if(f == stdout)  return fflush(f);
+
+  return fclose(f);
+}
+
+
+/* the length of a header field of len characters without the spaces that pad it */
+static int field_len(const char *field, int len)
+{
+  while((len > 0) && (field[len - 1] == ' '))  len--;
+
+  return len;
+}
+
+
+/* the filename part of an output name, for the _columns.txt file */
+static const char * output_name(const char *base, int base_len, int *name_len)
+{
+  int n;
+
+
+  for(n=0; n<base_len; n++)
+  {
+    if((base[base_len-n-1]=='/')||(base[base_len-n-1]=='\\'))  break;
+  }
+
+  *name_len = n;
+
+  return base + base_len - n;
+}
+
+
+/* bytes written to an output file, 0 when that is not known (pipes) */
+static long long output_size(FILE *f)
+{
+  long long n;
+
+
+  n = ftello(f);
+
+  return (n > 0) ? n : 0;
+}
+
+
+/* a table of convert_groups(), the data signals with the same number of samples per datarecord */
+struct conv_group{
+         int spr;                   /* samples per datarecord written */
+         struct conv_sched sched;   /* the rows of this table, every row has a sample of every signal */
+         struct txw dw;
+         FILE *file;
+       };
+
+
+/* the tables of convert_groups() */
+struct conv_groups{
+         int count;
+         struct conv_group *group;
+       };
+
+
+/* conv_emit_fn of the tables of convert_groups(), ctx is a struct conv_groups */
+static int emit_groups(struct conv_worker *w, const double *smp, long long starttime, void *ctx)
+{
+  int g;
+
+  double t0=0.0,
+         wsec=0.0;
+
+  struct conv_groups *groups;
+
+  struct conv_group *grp;
+
+
+  groups = (struct conv_groups *)ctx;
+
+  for(g=0; g<groups->count; g++)
+  {
+    grp = groups->group + g;
+
+    if(w->stats != NULL)
+    {
+      t0 = conv_now();
+      wsec = grp->dw.write_sec;
+    }
+
+    write_rows(w, &grp->sched, smp, starttime, &grp->dw);
+
+    if(w->stats != NULL)
+    {
+      w->stats->stage[CONV_STAGE_FORMAT] += (conv_now() - t0) - (grp->dw.write_sec - wsec);
+    }
+
+    if(grp->dw.error)
+    {
+      snprintf(w->errmsg, 256, "Error when writing to outputfile during conversion");
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+/* Writes a table per sample rate instead of _data.txt: the data signals with the same */
+/* number of samples per datarecord go to one _data_<RATE>Hz.txt file, so every row has */
+/* a sample in every column and a slow signal adds no empty cells to the rows of a fast */
+/* one. _columns.txt tells which table has which signal.                                 */
+static int convert_groups(struct conv_worker *w, char *ascii_path, int base_len, int first_record, int last_record,
+                          struct txw *annotwriter, char *errmsg, int errmsg_len)
+{
+  int i, j, g, r,
+      column,
+      name_len,
+      err=0,
+      *sel=NULL,
+      *group_of=NULL;
+
+  char suffix[64];
+
+  const char *name;
+
+  double duration,
+         t=0.0;
+
+  const char *cnv_buf;
+
+  const struct edfrd_hdr *hdr;
+
+  struct conv_group *grp;
+
+  struct conv_groups groups;
+
+  FILE *columnsfile=NULL;
+
+
+  hdr = w->hdr;
+  duration = (double)hdr->data_record_duration / EDFRD_FP_SCALING;
+
+  memset(&groups, 0, sizeof(struct conv_groups));
+
+  sel = (int *)calloc(hdr->signals, sizeof(int));
+  group_of = (int *)calloc(hdr->signals, sizeof(int));
+  groups.group = (struct conv_group *)calloc(w->sched.data_signals + 1, sizeof(struct conv_group));
+  if((sel==NULL)||(group_of==NULL)||(groups.group==NULL))
+  {
+    snprintf(errmsg, errmsg_len, "Malloc error! (groups)");
+    err = -1;
+    goto OUT;
+  }
+
+  for(i=0; i<w->sched.data_signals; i++)
+  {
+    j = w->sched.data_sig[i];
+
+    for(g=0; g<groups.count; g++)
+    {
+      if(groups.group[g].spr == w->out_spr[j])  break;
+    }
+
+    if(g == groups.count)  groups.group[groups.count++].spr = w->out_spr[j];
+
+    group_of[j] = g;
+  }
+
+  for(g=0; g<groups.count; g++)
+  {
+    grp = groups.group + g;
+
+    for(i=0; i<w->sched.data_signals; i++)
+    {
+      j = w->sched.data_sig[i];
+
+      sel[j] = (group_of[j] == g);
+    }
+
+    if(make_schedule(&grp->sched, hdr, sel, w->out_spr, w->out_offset) ||
+       txw_init(&grp->dw, NULL, TXW_BUFSIZE / 4))
+    {
+      snprintf(errmsg, errmsg_len, "Malloc error! (groups)");
+      err = -1;
+      goto OUT;
+    }
+
+    grp->dw.timed = (w->stats != NULL);
+
+    /* a datarecord duration of 0 has no sample rate */
+    if(duration > 0.0)
+    {
+      snprintf(suffix, sizeof(suffix), "_data_%.10gHz.txt", grp->spr / duration);
+    }
+    else
+    {
+      snprintf(suffix, sizeof(suffix), "_data_%ispr.txt", grp->spr);
+    }
+
+    ascii_path[base_len] = 0;
+    grp->file = open_output(NULL, ascii_path, suffix, errmsg, errmsg_len);
+    if(grp->file == NULL)
+    {
+      err = -1;
+      goto OUT;
+    }
+
+    txw_reset(&grp->dw, grp->file);
+
+    /* the columns have the numbers they have in _data.txt */
+    txw_puts(&grp->dw, "Time");
+
+    for(i=0, column=0; i<hdr->signals; i++)
+    {
+      if(hdr->param[i].annotation) continue;
+
+      column++;
+
+      if((!w->selected[i]) || (group_of[i] != g)) continue;
+
+      txw_putc(&grp->dw, ',');
+      txw_int(&grp->dw, column);
+    }
+
+    txw_putc(&grp->dw, '\n');
+  }
+
+  if(w->rs != NULL)
+  {
+    if(convert_resampled(w, first_record, last_record, annotwriter, emit_groups, &groups))
+    {
+      snprintf(errmsg, errmsg_len, "%s", w->errmsg);
+      err = -1;
+      goto OUT;
+    }
+  }
+  else
+  {
+    edfrd_seek_record(w->hdl, first_record);
+
+    for(r=first_record; r<last_record; r++)
+    {
+      if(w->stats != NULL)  t = conv_now();
+
+      err = edfrd_read_record(w->hdl, &cnv_buf);
+
+      if(w->stats != NULL)  w->stats->stage[CONV_STAGE_READ] += conv_now() - t;
+
+      if(err)  break;
+
+      if(convert_record(w, cnv_buf, r, annotwriter, emit_groups, &groups))
+      {
+        snprintf(errmsg, errmsg_len, "%s", w->errmsg);
+        err = -1;
+        goto OUT;
+      }
+    }
+
+    if(err<0)
+    {
+      snprintf(errmsg, errmsg_len, "Error when reading inputfile during conversion");
+      goto OUT;
+    }
+
+    err = 0;
+  }
+
+/***************** write the list of columns ******************************/
+
+  ascii_path[base_len] = 0;
+  columnsfile = open_output(NULL, ascii_path, "_columns.txt", errmsg, errmsg_len);
+  if(columnsfile==NULL)
+  {
+    err = -1;
+    goto OUT;
+  }
+
+  /* Column is the number in the header of the table, Signal the one in _signals.txt, */
+  /* which also counts the annotation signals                                          */
+  fprintf(columnsfile, "File,Column,Signal,Smp/Rec\n");
+
+  name = output_name(ascii_path, base_len, &name_len);
+
+  for(j=0, column=0; j<hdr->signals; j++)
+  {
+    if(hdr->param[j].annotation) continue;
+
+    column++;
+
+    if(!w->selected[j]) continue;
+
+    if(duration > 0.0)
+    {
+      fprintf(columnsfile, "%.*s_data_%.10gHz.txt,%i,%i,%i\n", name_len, name, w->out_spr[j] / duration, column, j + 1,
+              w->out_spr[j]);
+    }
+    else
+    {
+      fprintf(columnsfile, "%.*s_data_%ispr.txt,%i,%i,%i\n", name_len, name, w->out_spr[j], column, j + 1, w->out_spr[j]);
+    }
+  }
+
+  if(w->stats != NULL)  w->stats->bytes_written += output_size(columnsfile);
+
+  if(fclose(columnsfile) && !err)
+  {
+    snprintf(errmsg, errmsg_len, "Error when writing to outputfile during conversion");
+    err = -1;
+  }
+
+OUT:
+
+  for(g=0; (groups.group!=NULL)&&(g<groups.count); g++)
+  {
+    grp = groups.group + g;
+
+    if(grp->file != NULL)
+    {
+      if(txw_flush(&grp->dw) && !err)
+      {
+        snprintf(errmsg, errmsg_len, "Error when writing to outputfile during conversion");
+        err = -1;
+      }
+
+      if(w->stats != NULL)
+      {
+        w->stats->stage[CONV_STAGE_WRITE] += grp->dw.write_sec;
+        w->stats->bytes_written += grp->dw.written;
+      }
+
+      txw_reset(&grp->dw, NULL);
+
+      if(fclose(grp->file) && !err)
+      {
+        snprintf(errmsg, errmsg_len, "Error when writing to outputfile during conversion");
+        err = -1;
+      }
+    }
+
+    txw_free(&grp->dw);
+    free(grp->sched.data_sig);
+    free(grp->sched.row);
+    free(grp->sched.emit);
+  }
+
+  free(groups.group);
+  free(group_of);
+  free(sel);
+
+  return err;
+}
+
+
+/* adds what the text writers measured, the wall time and the CPU time of this thread */
+static void stats_finish(struct conv_session *s, double t_start, double cpu_start)
+{
+#ifdef CONV_HAVE_RUSAGE
+  struct rusage ru;
+#endif
+
+
+  s->stats.stage[CONV_STAGE_WRITE] += s->datawriter.write_sec + s->annotwriter.write_sec;
+  s->stats.bytes_written += s->datawriter.written + s->annotwriter.written;
+  s->stats.cpu += conv_cpu_time() - cpu_start;
+  s->stats.wall = conv_now() - t_start;
+
+#ifdef CONV_HAVE_RUSAGE
+  if(!getrusage(RUSAGE_SELF, &ru))
+  {
+    s->stats.peak_rss = ru.ru_maxrss;
+  }
+#endif
+}
+
+
+/* writes str as a JSON string */
+static void json_string(FILE *f, const char *str)
+{
+  fputc('"', f);
+
+  for(; *str; str++)
+  {
+    if((*str == '"') || (*str == '\\'))
+    {
+      fprintf(f, "\\%c", *str);
+    }
+    else if((unsigned char)*str < 32)
+      {
+        fprintf(f, "\\u%04x", (unsigned char)*str);
+      }
+      else
+      {
+        fputc(*str, f);
+      }
+  }
+
+  fputc('"', f);
+}
+
+
+void conv_stats_print(FILE *f, const char *path, const struct conv_stats *st, int format)
+{
+  int i;
+
+  double wall;
+
+  static const char *stage_names[CONV_STAGES]={"header", "read", "annotations", "decode", "format", "write"};
+
+
+  wall = (st->wall > 1e-9) ? st->wall : 1e-9;
+
+  if(format == CONV_STATS_JSON)
+  {
+    fprintf(f, "{\"file\":");
+    json_string(f, path);
+    fprintf(f, ",\"wall_sec\":%.6f,\"cpu_sec\":%.6f,\"stages_sec\":{", st->wall, st->cpu);
+    for(i=0; i<CONV_STAGES; i++)
+    {
+      fprintf(f, "%s\"%s\":%.6f", i ? "," : "", stage_names[i], st->stage[i]);
+    }
+    fprintf(f, "},\"bytes_read\":%lli,\"bytes_written\":%lli,\"records\":%lli,\"samples\":%lli,"
+               "\"read_mb_per_sec\":%.3f,\"records_per_sec\":%.1f,\"samples_per_sec\":%.1f,\"peak_rss_kb\":%lli}\n",
+            st->bytes_read, st->bytes_written, st->records, st->samples,
+            st->bytes_read / wall / 1e6, st->records / wall, st->samples / wall, st->peak_rss);
+
+    return;
+  }
+
+  fprintf(f, "Stats of %s\n", path);
+  for(i=0; i<CONV_STAGES; i++)
+  {
+    fprintf(f, "  %-13s %10.6f s  %5.1f %%\n", stage_names[i], st->stage[i], st->stage[i] * 100.0 / wall);
+  }
+  fprintf(f, "  %-13s %10.6f s\n", "wall", st->wall);
+  fprintf(f, "  %-13s %10.6f s\n", "cpu", st->cpu);
+  fprintf(f, "  %-13s %lli, %.1f MB/s\n", "bytes read", st->bytes_read, st->bytes_read / wall / 1e6);
+  fprintf(f, "  %-13s %lli\n", "bytes written", st->bytes_written);
+  fprintf(f, "  %-13s %lli, %.1f/s\n", "datarecords", st->records, st->records / wall);
+  fprintf(f, "  %-13s %lli, %.0f/s\n", "samples", st->samples, st->samples / wall);
+  if(st->peak_rss)
+  {
+    fprintf(f, "  %-13s %lli kB\n", "peak RSS", st->peak_rss);
+  }
+}
+
+
+void conv_session_init(struct conv_session *s)
+{
+  memset(s, 0, sizeof(struct conv_session));
+}
+
+
+void conv_session_free(struct conv_session *s)
+{
+  txw_free(&s->datawriter);
+  txw_free(&s->annotwriter);
+}
+
+
+int convert_file(struct conv_session *s, const char *path_in, const struct conv_opts *opts)
+{
+  FILE *outputfile=NULL,
+       *annotationfile=NULL;
+
+  struct txw *datawriter,
+             *annotwriter;
+
+  const char *fileName="";
+
+  int i,
+      pathlen,
+      fname_len,
+      base_len,
+      stream,
+      compression,
+      suffix_len,
+      j,
+      signals,
+      datarecords,
+      datarecordswritten,
+      first_record,
+      last_record,
+      regular,
+      following,
+      edf=0,
+      err=0,
+      bdf=0;
+
+  char path[1024]="",
+       ascii_path[1100]="",
+       numrec[9],
+       *edf_hdr=NULL;
+
+  struct edfrd_file *hdl=NULL;
+
+  struct dcmp *dc=NULL;
+
+  const char *member;
+
+  double t_start=0.0,
+         cpu_start=0.0,
+         t=0.0;
+
+  const char *cnv_buf=NULL;
+
+  struct stat st;
+
+  struct conv_worker w;
+
+  struct conv_ckpt ckpt;
+
+  struct edfidx idx;
+
+  struct pyr pyr;
+
+  struct pyr_bins bins;
+
+  const struct edfrd_hdr *hdr=NULL;
+
+  const struct edfrd_param *edfparam=NULL;
+
+
+
+  s->errmsg[0] = 0;
+
+  datawriter = &s->datawriter;
+  annotwriter = &s->annotwriter;
+
+  /* the buffers are kept for the next file */
+  if(datawriter->buf == NULL)
+  {
+    if(txw_init(datawriter, NULL, TXW_BUFSIZE) || txw_init(annotwriter, NULL, TXW_BUFSIZE / 16))
+    {
+      snprintf(s->errmsg, CONV_ERRMSG_LEN, "Malloc error! (writers)");
+      return -1;
+    }
+  }
+  txw_reset(datawriter, NULL);
+  txw_reset(annotwriter, NULL);
+
+  memset(&w, 0, sizeof(struct conv_worker));
+
+  memset(&ckpt, 0, sizeof(struct conv_ckpt));
+
+  memset(&idx, 0, sizeof(struct edfidx));
+
+  memset(&pyr, 0, sizeof(struct pyr));
+
+  memset(&bins, 0, sizeof(struct pyr_bins));
+
+  memset(&s->stats, 0, sizeof(struct conv_stats));
+  if(opts->stats)
+  {
+    t_start = conv_now();
+    cpu_start = conv_cpu_time();
+  }
+  datawriter->timed = (opts->stats != CONV_STATS_OFF);
+  annotwriter->timed = datawriter->timed;
+
+  /* "-" reads the file from stdin */
+  stream = !strcmp(path_in, "-");
+
+  /* a file that is being recorded is converted in parts, as it grows */
+  following = opts->follow || (opts->checkpoint != NULL);
+  if(following)
+  {
+    if(stream || (dcmp_type(path_in, NULL) != DCMP_NONE))
+    {
+      snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, a file that is read from stdin or compressed can not be followed or continued");
+      goto OUT_ERROR;
+    }
+
+    if((opts->format != CONV_FORMAT_TXT) || (opts->rate_list != NULL) || opts->index || opts->pyramid ||
+       (opts->start_time > 0LL) || (opts->end_time >= 0LL))
+    {
+      snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, a file that is followed or continued is converted whole, to txt and "
+                                           "at its own sample rates");
+      goto OUT_ERROR;
+    }
+
+    if((opts->checkpoint != NULL) &&
+       ((!output_is_file(opts->dest[CONV_OUT_DATA])) || (!output_is_file(opts->dest[CONV_OUT_ANNOTATIONS]))))
+    {
+      snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, with a checkpoint the outputs must be files");
+      goto OUT_ERROR;
+    }
+  }
+
+  if(opts->digital && ((opts->rate_list != NULL) || opts->pyramid || opts->float32))
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, --digital writes the values as they are in the file, it can not be used with "
+                                         "--rate, --pyramid or --float32");
+    goto OUT_ERROR;
+  }
+
+  if(opts->annotations_only && (following || (opts->format != CONV_FORMAT_TXT) || (opts->rate_list != NULL) || opts->pyramid))
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, --annotations-only writes no data, it can not be used with --format, --rate, "
+                                         "--pyramid, --follow or --checkpoint");
+    goto OUT_ERROR;
+  }
+
+  if((opts->output_base != NULL) && (strlen(opts->output_base)>1000))
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, filename is too long.");
+    goto OUT_ERROR;
+  }
+
+  if(stream)
+  {
+    strcpy(path, "stdin");
+
+    if(opts->output_base != NULL)
+    {
+      strcpy(ascii_path, opts->output_base);
+    }
+
+    base_len = strlen(ascii_path);
+
+    if((!base_len) && (opts->format != CONV_FORMAT_TXT))
+    {
+      snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, the %s format needs an output name when reading from stdin",
+               (opts->format == CONV_FORMAT_NPY) ? "npy" : "groups");
+      goto OUT_ERROR;
+    }
+
+    /* a thread reads stdin ahead of the conversion */
+    dc = dcmp_open_fd(dup(0), s->errmsg, CONV_ERRMSG_LEN);
+    if(dc == NULL)  goto OUT_ERROR;
+
+    hdl = edfrd_open_reader(dcmp_read, dc, 0, s->errmsg, CONV_ERRMSG_LEN);
+    if(hdl == NULL)  goto OUT_ERROR;
+
+    goto OPEN_WORKER;
+  }
+
+  if(strlen(path_in)>1000)
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, filename is too long.");
+    goto OUT_ERROR;
+  }
+
+  /* compressed files are decompressed while they are read, they are read like a stream */
+  compression = dcmp_type(path_in, &suffix_len);
+  if(compression != DCMP_NONE)
+  {
+    strcpy(path, path_in);
+
+    dc = dcmp_open(path, compression, s->errmsg, CONV_ERRMSG_LEN);
+    if(dc == NULL)  goto OUT_ERROR;
+
+    /* the output is named after the compressed file, or after the member of a tar archive */
+    strcpy(ascii_path, path);
+    base_len = strlen(ascii_path) - suffix_len;
+    member = dcmp_member(dc);
+    if(member != NULL)
+    {
+      output_name(path, strlen(path), &fname_len);
+      base_len = strlen(path) - fname_len;
+      member = output_name(member, strlen(member), &fname_len);
+      snprintf(ascii_path + base_len, 1100 - base_len, "%.*s", fname_len - 4, member);
+      base_len = strlen(ascii_path);
+    }
+    ascii_path[base_len] = 0;
+
+    if(opts->output_base != NULL)
+    {
+      strcpy(ascii_path, opts->output_base);
+      base_len = strlen(ascii_path);
+    }
+
+    stream = 1;
+
+    hdl = edfrd_open_reader(dcmp_read, dc, 0, s->errmsg, CONV_ERRMSG_LEN);
+    if(hdl == NULL)  goto OUT_ERROR;
+
+    goto OPEN_WORKER;
+  }
+
+  strcpy(path, path_in);
+  strcpy(ascii_path, path_in);
+
+  pathlen = strlen(path);
+
+  if(pathlen<5)
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, filename must contain at least five characters.");
+    goto OUT_ERROR;
+  }
+
+  fname_len = 0;
+  for(i=pathlen; i>0; i--)
+  {
+       if((path[i-1]=='/')||(path[i-1]=='\\'))  break;
+       fname_len++;
+  }
+  fileName = path + pathlen - fname_len;
+
+  for(i=0; fileName[i]!=0; i++);
+  if(i==0)
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, filename must contain at least five characters.");
+    goto OUT_ERROR;
+  }
+
+  i -= 4;
+  if((strcmp((const char *)fileName + i, ".edf")) &&
+     (strcmp((const char *)fileName + i, ".EDF")) &&
+     (strcmp((const char *)fileName + i, ".bdf")) &&
+     (strcmp((const char *)fileName + i, ".BDF")))
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, filename extension must have the form \".edf\" or \".EDF\" or \".bdf\" or \".BDF\"");
+    goto OUT_ERROR;
+  }
+
+  if((!strcmp((const char *)fileName + i, ".edf")) ||
+     (!strcmp((const char *)fileName + i, ".EDF")))
+  {
+    edf = 1;
+  }
+  else
+  {
+    bdf = 1;
+  }
+
+  base_len = pathlen - 4;
+
+  if(opts->output_base != NULL)
+  {
+    strcpy(ascii_path, opts->output_base);
+    base_len = strlen(ascii_path);
+  }
+
+  if(following)
+  {
+    hdl = edfrd_open_ex(path, EDFRD_OPEN_GROWING, s->errmsg, CONV_ERRMSG_LEN);
+    if(hdl == NULL)  goto OUT_ERROR;
+  }
+
+/***************** check header ******************************/
+
+OPEN_WORKER:
+
+  if(worker_init(&w, path, hdl, opts))
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "%s", w.errmsg);
+    goto OUT_ERROR;
+  }
+
+  hdr = w.hdr;
+
+  if(edf && (hdr->filetype != EDFRD_FILETYPE_EDF))
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, EDF-header has unknown version");
+    goto OUT_ERROR;
+  }
+
+  if(bdf && (hdr->filetype != EDFRD_FILETYPE_BDF))
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, BDF-header has unknown version");
+    goto OUT_ERROR;
+  }
+
+  signals = hdr->signals;
+  datarecords = hdr->datarecords;
+  edfparam = hdr->param;
+
+  if(opts->checkpoint != NULL)
+  {
+    if(ckpt_read(opts->checkpoint, &ckpt, s->errmsg, CONV_ERRMSG_LEN))  goto OUT_ERROR;
+
+    if(ckpt.records && ((ckpt.signals != signals) || (ckpt.recordbytes != hdr->recordbytes)))
+    {
+      snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, checkpoint %s belongs to another file", opts->checkpoint);
+      goto OUT_ERROR;
+    }
+
+    ckpt.signals = signals;
+    ckpt.recordbytes = hdr->recordbytes;
+  }
+
+  edf_hdr = (char *)malloc((signals + 1) * 256);
+  if(edf_hdr==NULL)
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "Malloc error! (edf_hdr)");
+    goto OUT_ERROR;
+  }
+
+  memcpy(edf_hdr, hdr->raw, (signals + 1) * 256);
+
+  for(i=0; i<((signals+1)*256); i++)
+  {
+    if(edf_hdr[i]==',') edf_hdr[i] = '\'';  /* replace all comma's in header by single quotes because they */
+  }                                         /* interfere with the comma-separated txt-files                */
+
+/***************** write header ******************************/
+
+  ascii_path[base_len] = 0;
+  outputfile = open_output(opts->dest[CONV_OUT_HEADER], ascii_path, "_header.txt", s->errmsg, CONV_ERRMSG_LEN);
+  if(outputfile==NULL)
+  {
+    goto OUT_ERROR;
+  }
+
+  fprintf(outputfile, "Version,Patient,Recording,Startdate,Startime,Bytes,Reserved,NumRec,Duration,NumSig\n");
+
+  if(hdr->filetype == EDFRD_FILETYPE_EDF)
+  {
+    fprintf(outputfile, "%.8s,", edf_hdr);
+  }
+  else
+  {
+    fprintf(outputfile, ".%.7s,", edf_hdr + 1);
+  }
+  fprintf(outputfile, "%.80s,", edf_hdr + 8);
+  fprintf(outputfile, "%.80s,", edf_hdr + 88);
+  fprintf(outputfile, "%.8s,", edf_hdr + 168);
+  fprintf(outputfile, "%.8s,", edf_hdr + 176);
+  fprintf(outputfile, "%.8s,", edf_hdr + 184);
+  fprintf(outputfile, "%.44s,", edf_hdr + 192);
+  if(following)
+  {
+    /* the number in the file, -1 while it is being recorded, the datarecords */
+    /* found so far are out of date as soon as the recording goes on           */
+    memcpy(numrec, edf_hdr + 236, 8);
+    numrec[8] = 0;
+    fprintf(outputfile, "%i,", atoi(numrec));
+  }
+  else
+  {
+    fprintf(outputfile, "%i,", datarecords);
+  }
+  fprintf(outputfile, "%.8s,", edf_hdr + 244);
+  fprintf(outputfile, "%i\n", signals - hdr->nr_annot_chns);
+
+  if(opts->stats)  s->stats.bytes_written += output_size(outputfile);
+
+  close_output(outputfile);
+  outputfile = NULL;
+
+/***************** write signals ******************************/
+
+  ascii_path[base_len] = 0;
+  outputfile = open_output(opts->dest[CONV_OUT_SIGNALS], ascii_path, "_signals.txt", s->errmsg, CONV_ERRMSG_LEN);
+  if(outputfile==NULL)
+  {
+    goto OUT_ERROR;
+  }
+
+  fprintf(outputfile, "Signal,Label,Transducer,Units,Min,Max,Dmin,Dmax,PreFilter,Smp/Rec,Reserved\n");
+
+  for(j=0; j<w.sched.data_signals; j++)
+  {
+    i = w.sched.data_sig[j];
+
+    fprintf(outputfile, "%i,", i + 1);
+    fprintf(outputfile, "%.16s,", edf_hdr + 256 + i * 16);
+    fprintf(outputfile, "%.80s,", edf_hdr + 256 + signals * 16 + i * 80);
+    fprintf(outputfile, "%.8s,", edf_hdr + 256 + signals * 96 + i * 8);
+    if(opts->digital)
+    {
+      /* as in the header, %f could round away what is needed to scale the values */
+      fprintf(outputfile, "%.*s,", field_len(edf_hdr + 256 + signals * 104 + i * 8, 8), edf_hdr + 256 + signals * 104 + i * 8);
+      fprintf(outputfile, "%.*s,", field_len(edf_hdr + 256 + signals * 112 + i * 8, 8), edf_hdr + 256 + signals * 112 + i * 8);
+    }
+    else
+    {
+      fprintf(outputfile, "%f,", edfparam[i].phys_min);
+      fprintf(outputfile, "%f,", edfparam[i].phys_max);
+    }
+    fprintf(outputfile, "%i,", edfparam[i].dig_min);
+    fprintf(outputfile, "%i,", edfparam[i].dig_max);
+    fprintf(outputfile, "%.80s,", edf_hdr + 256 + signals * 136 + i * 80);
+    fprintf(outputfile, "%i,", w.out_spr[i]);
+    fprintf(outputfile, "%.32s\n", edf_hdr + 256 + signals * 224 + i * 32);
+  }
+
+  if(opts->stats)  s->stats.bytes_written += output_size(outputfile);
+
+  close_output(outputfile);
+  outputfile = NULL;
+
+/***************** open annotation file ******************************/
+
+  ascii_path[base_len] = 0;
+  /* reading from stdin without an output name, only annotations go to stdout */
+  if(opts->annotations_only && (!strcmp(path_in, "-")) && (!base_len) && (opts->dest[CONV_OUT_ANNOTATIONS] == NULL))
+  {
+    annotationfile = stdout;
+  }
+  else if(ckpt.records)
+    {
+        annotationfile = resume_output(opts->dest[CONV_OUT_ANNOTATIONS], ascii_path, "_annotations.txt", ckpt.annot_bytes,
+                                     s->errmsg, CONV_ERRMSG_LEN);
+    }
+    else
+    {
+      annotationfile = open_output(opts->dest[CONV_OUT_ANNOTATIONS], ascii_path, "_annotations.txt", s->errmsg, CONV_ERRMSG_LEN);
+    }
+  if(annotationfile==NULL)
+  {
+    goto OUT_ERROR;
+  }
+
+  txw_reset(annotwriter, annotationfile);
+
+  if(!ckpt.records)
+  {
+    txw_puts(annotwriter, "Onset,Duration,Annotation\n");
+  }
+
+/***************** write data ******************************/
+
+  regular = (!stream) && (!stat(path, &st)) && S_ISREG(st.st_mode);
+
+  if(opts->index)
+  {
+    if(!regular)
+    {
+      snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, an index can only be made of a file that is not compressed or read from stdin");
+      goto OUT_ERROR;
+    }
+
+    if(load_index(&idx, path, opts, hdr, s->errmsg, CONV_ERRMSG_LEN))  goto OUT_ERROR;
+
+    w.idx = &idx;
+  }
+
+  if(find_records(&w, regular, &first_record, &last_record))
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "%s", w.errmsg);
+    goto OUT_ERROR;
+  }
+
+  if(opts->pyramid)
+  {
+    if(open_pyramid(&w, &pyr, &bins, ascii_path, base_len, first_record, last_record, s->errmsg, CONV_ERRMSG_LEN))
+    {
+      goto OUT_ERROR;
+    }
+  }
+
+  if(opts->stats)
+  {
+    s->stats.stage[CONV_STAGE_HEADER] = conv_now() - t_start;
+    s->stats.bytes_read = (signals + 1) * 256;
+    w.stats = &s->stats;
+  }
+
+  if(opts->annotations_only)
+  {
+    if(convert_annotations(&w, first_record, last_record, annotwriter, s->errmsg, CONV_ERRMSG_LEN))
+    {
+      goto OUT_ERROR;
+    }
+
+    goto OUT_FLUSH;
+  }
+
+  if(opts->format == CONV_FORMAT_NPY)
+  {
+    ascii_path[base_len] = 0;
+    if(convert_npy(&w, ascii_path, base_len, first_record, last_record, annotwriter, s->errmsg, CONV_ERRMSG_LEN))
+    {
+      goto OUT_ERROR;
+    }
+
+    goto OUT_FLUSH;
+  }
+
+  if(opts->format == CONV_FORMAT_GROUPS)
+  {
+    ascii_path[base_len] = 0;
+    if(convert_groups(&w, ascii_path, base_len, first_record, last_record, annotwriter, s->errmsg, CONV_ERRMSG_LEN))
+    {
+      goto OUT_ERROR;
+    }
+
+    goto OUT_FLUSH;
+  }
+
+  ascii_path[base_len] = 0;
+  /* reading from stdin without an output name, the data goes to stdout */
+  if((!strcmp(path_in, "-")) && (!base_len) && (opts->dest[CONV_OUT_DATA] == NULL))
+  {
+    outputfile = stdout;
+  }
+  else if(ckpt.records)
+    {
+      outputfile = resume_output(opts->dest[CONV_OUT_DATA], ascii_path, "_data.txt", ckpt.data_bytes,
+                                 s->errmsg, CONV_ERRMSG_LEN);
+    }
+    else
+    {
+      outputfile = open_output(opts->dest[CONV_OUT_DATA], ascii_path, "_data.txt", s->errmsg, CONV_ERRMSG_LEN);
+    }
+  if(outputfile==NULL)
+  {
+    goto OUT_ERROR;
+  }
+
+  txw_reset(datawriter, outputfile);
+
+  /* a thread writes the data while the next datarecords are read and formatted */
+  if(txw_async_start(datawriter))
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error, can not start the write thread");
+    goto OUT_ERROR;
+  }
+
+  if(!ckpt.records)
+  {
+    txw_puts(datawriter, "Time");
+
+    /* the columns keep the numbers they have when all signals are converted */
+    for(i=0, j=0; i<signals; i++)
+    {
+      if(edfparam[i].annotation) continue;
+
+      j++;
+
+      if(!w.selected[i]) continue;
+
+      txw_putc(datawriter, ',');
+      txw_int(datawriter, j);
+    }
+
+    txw_putc(datawriter, '\n');
+  }
+
+  if(datawriter->error)
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error when writing to outputfile");
+    goto OUT_ERROR;
+  }
+
+/***************** start data conversion ******************************/
+
+  if(following)
+  {
+    if(convert_follow(&w, &ckpt, datawriter, annotwriter, outputfile, annotationfile, s->errmsg, CONV_ERRMSG_LEN))
+    {
+      goto OUT_ERROR;
+    }
+  }
+  /* the threads open the file again, so that only works for regular files */
+  else if((opts->threads > 1) && ((last_record - first_record) > 1) && regular)
+    {
+      if(convert_parallel(path, opts, hdr, first_record, last_record, datawriter, annotwriter,
+                          w.pyr, w.stats, s->errmsg, CONV_ERRMSG_LEN))
+      {
+        goto OUT_ERROR;
+      }
+    }
+    else if(w.rs != NULL)
+      {
+        if(convert_resampled(&w, first_record, last_record, annotwriter, emit_rows, datawriter))
+        {
+          snprintf(s->errmsg, CONV_ERRMSG_LEN, "%s", w.errmsg);
+          goto OUT_ERROR;
+        }
+      }
+      else
+      {
+        datarecordswritten = first_record;
+
+        edfrd_seek_record(w.hdl, first_record);
+
+        while(datarecordswritten < last_record)
+        {
+          if(w.stats != NULL)  t = conv_now();
+
+          err = edfrd_read_record(w.hdl, &cnv_buf);
+
+          if(w.stats != NULL)  w.stats->stage[CONV_STAGE_READ] += conv_now() - t;
+
+          if(err)  break;
+
+          if(convert_record(&w, cnv_buf, datarecordswritten, annotwriter, emit_rows, datawriter))
+          {
+            snprintf(s->errmsg, CONV_ERRMSG_LEN, "%s", w.errmsg);
+            goto OUT_ERROR;
+          }
+
+          datarecordswritten++;
+        }
+
+        if(err<0)
+        {
+          snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error when reading inputfile during conversion");
+          goto OUT_ERROR;
+        }
+      }
+
+OUT_FLUSH:
+
+  if(txw_flush(datawriter) || txw_flush(annotwriter))
+  {
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error when writing to outputfile during conversion");
+    goto OUT_ERROR;
+  }
+
+  if(opts->pyramid)
+  {
+    pyr_bins_free(&bins);
+    if(pyr_close(&pyr))
+    {
+      snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error when writing to outputfile during conversion");
+      goto OUT_ERROR;
+    }
+  }
+
+  if(opts->stats)  stats_finish(s, t_start, cpu_start);
+
+  txw_reset(datawriter, NULL);
+  txw_reset(annotwriter, NULL);
+
+  if(close_output(annotationfile) || close_output(outputfile))
+  {
+    annotationfile = NULL;
+    outputfile = NULL;
+    snprintf(s->errmsg, CONV_ERRMSG_LEN, "Error when writing to outputfile during conversion");
+    goto OUT_ERROR;
+  }
+  worker_free(&w);
+  edfidx_free(&idx);
+  dcmp_close(dc);
+  free(edf_hdr);
+
+  return 0;
+
+OUT_ERROR:
+
+  /* keep the output that was produced up to the error */
+  txw_flush(datawriter);
+  txw_flush(annotwriter);
+
+  /* unless that was already done before closing the files */
+  if(opts->stats && (s->stats.wall == 0.0))  stats_finish(s, t_start, cpu_start);
+
+  txw_reset(datawriter, NULL);
+  txw_reset(annotwriter, NULL);
+
+  close_output(annotationfile);
+  close_output(outputfile);
+  if(w.hdl == NULL)
+  {
+    edfrd_close(hdl);
+  }
+  worker_free(&w);
+  edfidx_free(&idx);
+  pyr_bins_free(&bins);
+  pyr_close(&pyr);
+  if(dc != NULL)
+  {
+    /* a read error is reported as the reason why decompression failed */
+    if(dcmp_error(dc) != NULL)
+    {
+      snprintf(s->errmsg, CONV_ERRMSG_LEN, "%s: %s", path, dcmp_error(dc));
+    }
+    dcmp_close(dc);
+  }
+  free(edf_hdr);
+
+  return -1;
+}
+
+
+/* converts len bytes of UTF-8 text at src to Latin-1 at dst, which may be src, and returns */
+/* the length of the result, bytes that are not Latin-1 become dots and the text ends at the */
+/* first character that is not in the first two UTF-8 blocks, with csv set commas become   */
+/* dots as well                                                                              */
+static int latin1_text(unsigned char *dst, const unsigned char *src, int len, int csv)
+{
+  int i, j;
+
+  unsigned char c;
+
+
+  for(i=0, j=0; i<len; i++)
+  {
+    c = src[i];
+
+    if((c < 32) || ((c > 127) && (c < 192)))
+    {
+      dst[j++] = '.';
+
+      continue;
+    }
+
+    if(c > 223)  return j;  /* can only decode Latin-1 ! */
+
+    if((c & 224) == 192)  /* found a two-byte sequence containing Latin-1, Greek, Cyrillic, Coptic, Armenian, Hebrew, etc. characters */
+    {
+      if((i + 1) == len)  return j;
+
+      if((c & 252) != 192) /* it's not a Latin-1 character */
+      {
+        dst[j++] = '.';
+
+        i++;
+
+        continue;
+      }
+
+      if((src[i + 1] & 192) != 128)  return j;  /* UTF-8 violation error */
+
+      dst[j++] = (c << 6) + (src[i + 1] & 63);
+
+      i++;
+
+      continue;
+    }
+
+    dst[j++] = (csv && (c == ',')) ? '.' : c;
+  }
+
+  return j;
+}
+
+
+static int write_annotation(void *ctx, const struct edfrd_annot *annot)
+{
+  struct conv_worker *w;
+
+  struct txw *annotwriter;
+
+
+  w = (struct conv_worker *)ctx;
+  annotwriter = w->aw;
+
+  if(w->windowed)
+  {
+    if((annot->onset < w->opts->start_time) || ((w->opts->end_time >= 0LL) && (annot->onset >= w->opts->end_time)))  return 0;
+  }
+
+  txw_write(annotwriter, annot->onset_txt, annot->onset_len);
+  txw_putc(annotwriter, ',');
+  txw_write(annotwriter, annot->duration_txt, annot->duration_len);
+  txw_putc(annotwriter, ',');
+
+  /* the Latin-1 text is never longer than the UTF-8 text, it is converted into the buffer */
+  if(((annotwriter->len + annot->text_len) > annotwriter->size) && txw_reserve(annotwriter, annot->text_len))  return 0;
+  annotwriter->len += latin1_text((unsigned char *)annotwriter->buf + annotwriter->len,
+                                  (const unsigned char *)annot->text, annot->text_len, 1);
+
+  txw_putc(annotwriter, '\n');
+
+  if(w->onsetw != NULL)
+  {
+    npyw_write(w->onsetw, &annot->onset, 1);
+    npyw_write(w->durationw, &annot->duration, 1);
+  }
+
+  return 0;
+}
+
+
+void utf8_to_latin1(char *utf8_str)
+{
+  int j, len;
+
+
+  len = strlen(utf8_str);
+
+  j = latin1_text((unsigned char *)utf8_str, (const unsigned char *)utf8_str, len, 0);
+
+  if(j<len)
+  {
+    utf8_str[j] = 0;
+  }
+}
@@ -0,0 +1,132 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+#ifndef CONVERT_INCLUDED
+#define CONVERT_INCLUDED
+
+
+#include "txtwriter.h"
+
+
+#define CONV_ERRMSG_LEN    (2048)
+
+#define CONV_FORMAT_TXT    (0)  /* _data.txt */
+#define CONV_FORMAT_NPY    (1)  /* a .npy file per signal and _records.npy */
+#define CONV_FORMAT_GROUPS (2)  /* a _data_<RATE>Hz.txt table per sample rate */
+
+#define CONV_OUT_HEADER       (0)
+#define CONV_OUT_SIGNALS      (1)
+#define CONV_OUT_ANNOTATIONS  (2)
+#define CONV_OUT_DATA         (3)
+#define CONV_OUTPUTS          (4)
+
+#define CONV_STATS_OFF        (0)
+#define CONV_STATS_TEXT       (1)
+#define CONV_STATS_JSON       (2)
+
+#define CONV_STAGE_HEADER       (0)  /* opening the file, header and signal list, finding the time window */
+#define CONV_STAGE_READ         (1)  /* getting the datarecords from the file */
+#define CONV_STAGE_ANNOTATIONS  (2)  /* start times and TAL annotations */
+#define CONV_STAGE_DECODE       (3)  /* digital to physical values */
+#define CONV_STAGE_FORMAT       (4)  /* number formatting */
+#define CONV_STAGE_WRITE        (5)  /* writing the output files */
+#define CONV_STAGES             (6)
+
+
+struct conv_opts{
+         int precision;             /* number of decimals of the sample values */
+         int threads;               /* number of threads converting datarecords */
+         const char *signal_list;   /* comma-separated signal numbers and labels, NULL converts all signals */
+         const char *rate_list;     /* comma-separated sample rates in Hz, "RATE" or "SIGNAL=RATE", NULL keeps them */
+         long long start_time;      /* start of the time window in nanoSeconds from the start of the file */
+         long long end_time;        /* end of the time window (exclusive), -1 for the end of the file */
+         int format;                /* CONV_FORMAT_TXT, CONV_FORMAT_NPY or CONV_FORMAT_GROUPS */
+         int float32;               /* .npy files hold single instead of double precision values */
+         int digital;               /* write the digital values, as integers, instead of the physical values */
+         const char *output_base;   /* output filenames start with this instead of the input filename */
+         const char *dest[CONV_OUTPUTS];  /* "-" (stdout), "fd:N" or a filename, NULL for the default name */
+         int stats;                 /* CONV_STATS_OFF, or collect struct conv_stats in the session */
+         int follow;                /* keep converting the datarecords appended to a file that is being recorded */
+         double follow_idle;        /* stop following after this many seconds without a new datarecord, 0 waits */
+                                    /* until the recording is closed */
+         const char *checkpoint;    /* file that tells how far the conversion got, the next run continues there */
+         int annotations_only;      /* write no data, read only the annotation signals of the datarecords */
+         int pyramid;               /* also write a min/max/mean pyramid of the data signals to _pyramid.bin */
+         int index;                 /* find the time window with a sidecar index, made when there is none yet */
+         const char *index_path;    /* the index file, NULL for the input filename followed by ".idx" */
+       };
+
+
+/* where the time of one conversion went, the stages are timed on every thread that */
+/* converts datarecords, so with more than one thread they add up to more than wall */
+struct conv_stats{
+         double wall;                    /* seconds */
+         double cpu;                     /* CPU seconds of the threads that converted the file */
+         double stage[CONV_STAGES];      /* seconds */
+         long long bytes_read;           /* header and datarecords */
+         long long bytes_written;
+         long long records;
+         long long samples;              /* decoded samples */
+         long long peak_rss;             /* kilobytes, of the whole process, 0 if unknown */
+       };
+
+
+/* the output buffers are kept between files, so converting many files does not */
+/* allocate them again for every file, one session must not be used by two threads */
+struct conv_session{
+         struct txw datawriter;
+         struct txw annotwriter;
+         char errmsg[CONV_ERRMSG_LEN];  /* why the last conversion failed */
+         struct conv_stats stats;       /* of the last conversion when opts->stats is set */
+       };
+
+
+void conv_opts_init(struct conv_opts *opts);
+
+void conv_session_init(struct conv_session *s);
+
+void conv_session_free(struct conv_session *s);
+
+/* converts one EDF(+)/BDF(+) file, or stdin when path is "-", into the _header, _signals, _annotations and _data txt-files, */
+/* or with CONV_FORMAT_NPY the _data.txt file is replaced by _records.npy, _signal<N>.npy files  */
+/* and a _columns.txt file that lists them, for EDF+ and BDF+ the onsets and durations of the    */
+/* annotations also go to _annotation_onsets.npy and _annotation_durations.npy,                 */
+/* with CONV_FORMAT_GROUPS it is replaced by a _data_<RATE>Hz.txt file for every sample rate    */
+/* and a _columns.txt file that lists which signals are in which file                           */
+/* with opts->annotations_only only the _header, _signals and _annotations files are written */
+/* with opts->follow or opts->checkpoint only the datarecords that were not converted yet are, */
+/* and the _annotations and _data files of the earlier run are continued                    */
+/* returns 0 on success, otherwise -1 with a message in s->errmsg */
+int convert_file(struct conv_session *s, const char *path, const struct conv_opts *opts);
+
+/* prints the stats of the conversion of path as text or as one line of JSON */
+void conv_stats_print(FILE *f, const char *path, const struct conv_stats *st, int format);
+
+void utf8_to_latin1(char *);
+
+
+#endif
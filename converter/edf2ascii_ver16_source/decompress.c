@@ -0,0 +1,879 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+
+#ifdef DCMP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef DCMP_HAVE_LZMA
+#include <lzma.h>
+#endif
+
+#include "decompress.h"
+
+
+/* size of the blocks of compressed data read from the file */
+#define DCMP_INBUF      (256 * 1024)
+
+/* milliseconds that a read from a pipe waits before it checks whether the reader stopped */
+#define DCMP_POLL_MS    (100)
+
+#define DCMP_TAR_HEADER (0)
+#define DCMP_TAR_NAME   (1)  /* GNU long name of the next member */
+#define DCMP_TAR_SKIP   (2)
+#define DCMP_TAR_DATA   (3)
+
+
+struct dcmp{
+         FILE *file;
+         int fd;                    /* read as it is with dcmp_open_fd(), -1 otherwise */
+         int type;
+         pthread_t thread;
+         int started;
+         pthread_mutex_t lock;
+         pthread_cond_t filled;     /* a slot has been filled, a member has been found, or the thread is done */
+         pthread_cond_t emptied;    /* a slot has been read, or the reader stops */
+         char *ring;                /* DCMP_SLOTS slots of DCMP_SLOT_SIZE bytes */
+         int slot_len[DCMP_SLOTS];
+         int head;                  /* oldest filled slot */
+         int count;                 /* number of filled slots */
+         int done;                  /* the thread will not fill more slots */
+         int stop;                  /* the reader does not want more data */
+         int member_found;
+         char errmsg[256];          /* set by the thread before done */
+         /* used by the thread only */
+         char *inbuf;
+         char *outbuf;
+         char *fill;                /* the slot being filled, NULL if none */
+         int fill_slot;
+         int fill_len;
+         int tar_state;
+         long long tar_remain;
+         long long tar_pad;
+         char tar_hdr[512];
+         int tar_hdr_len;
+         char long_name[1024];
+         int long_name_len;
+         char member[1024];
+         /* used by the reader only */
+         const char *cur;           /* the slot being read, NULL if none */
+         int cur_len;
+         int cur_pos;
+       };
+
+
+static int ends_with(const char *str, const char *suffix)
+{
+  int i, len, slen;
+
+
+  len = strlen(str);
+  slen = strlen(suffix);
+  if(len < slen)  return 0;
+
+  str += len - slen;
+
+  for(i=0; i<slen; i++)
+  {
+    if(((str[i] >= 'A') && (str[i] <= 'Z') ? (str[i] + 32) : str[i]) != suffix[i])  return 0;
+  }
+
+  return 1;
+}
+
+
+int dcmp_type(const char *path, int *suffix_len)
+{
+  int i;
+
+  static const char *suffixes[8]={".tar.gz", ".tgz", ".tar.xz", ".txz",
+                                  ".edf.gz", ".bdf.gz", ".edf.xz", ".bdf.xz"};
+
+  static const int types[8]={DCMP_GZIP + DCMP_TAR, DCMP_GZIP + DCMP_TAR, DCMP_XZ + DCMP_TAR, DCMP_XZ + DCMP_TAR,
+                             DCMP_GZIP, DCMP_GZIP, DCMP_XZ, DCMP_XZ};
+
+
+  for(i=0; i<8; i++)
+  {
+    if(ends_with(path, suffixes[i]))
+    {
+      if(suffix_len != NULL)  *suffix_len = strlen(suffixes[i]);
+
+      return types[i];
+    }
+  }
+
+  return DCMP_NONE;
+}
+
+
+/* hands the filled slot to the reader */
+static void dcmp_push(struct dcmp *d)
+{
+  pthread_mutex_lock(&d->lock);
+  d->slot_len[d->fill_slot] = d->fill_len;
+  d->count++;
+  pthread_cond_signal(&d->filled);
+  pthread_mutex_unlock(&d->lock);
+
+  d->fill = NULL;
+}
+
+
+/* copies decompressed data into the ring, waits for a free slot when the ring is full, */
+/* returns non-zero when the reader stopped                                             */
+static int dcmp_put(struct dcmp *d, const char *buf, long long n)
+{
+  int k, stop;
+
+
+  while(n > 0)
+  {
+    if(d->fill == NULL)
+    {
+      pthread_mutex_lock(&d->lock);
+      while((d->count == DCMP_SLOTS) && (!d->stop))
+      {
+        pthread_cond_wait(&d->emptied, &d->lock);
+      }
+      /* head + count does not change when the reader moves on */
+      d->fill_slot = (d->head + d->count) % DCMP_SLOTS;
+      stop = d->stop;
+      pthread_mutex_unlock(&d->lock);
+
+      if(stop)  return -1;
+
+      d->fill = d->ring + (long long)d->fill_slot * DCMP_SLOT_SIZE;
+      d->fill_len = 0;
+    }
+
+    k = DCMP_SLOT_SIZE - d->fill_len;
+    if(k > n)  k = n;
+
+    memcpy(d->fill + d->fill_len, buf, k);
+    d->fill_len += k;
+    buf += k;
+    n -= k;
+
+    if(d->fill_len == DCMP_SLOT_SIZE)
+    {
+      dcmp_push(d);
+    }
+  }
+
+  return 0;
+}
+
+
+/* the size field of a tar header, octal or base-256, returns -1 if it is not valid */
+static long long tar_size(const char *field)
+{
+  int i;
+
+  long long size=0;
+
+
+  if(field[0] & 0x80)
+  {
+    size = field[0] & 0x3f;
+    for(i=1; i<12; i++)
+    {
+      if(size > (0x7fffffffffffffLL))  return -1;
+
+      size = (size << 8) | (unsigned char)field[i];
+    }
+
+    return size;
+  }
+
+  for(i=0; (i<12)&&(field[i]==' '); i++);
+
+  for(; (i<12)&&(field[i]>='0')&&(field[i]<='7'); i++)
+  {
+    size = (size << 3) + (field[i] - '0');
+  }
+
+  if((i<12) && (field[i]!=0) && (field[i]!=' '))  return -1;
+
+  return size;
+}
+
+
+/* regular files named *.edf or *.bdf, but not the "._" metadata files written by macOS */
+static int is_edf_member(const char *name, int type)
+{
+  const char *p;
+
+
+  if((type != '0') && (type != 0) && (type != '7'))  return 0;
+
+  p = strrchr(name, '/');
+  p = (p == NULL) ? name : (p + 1);
+
+  if(!strncmp(p, "._", 2))  return 0;
+
+  return ends_with(p, ".edf") || ends_with(p, ".bdf");
+}
+
+
+/* walks through the tar stream, only the data of the member is put in the ring, */
+/* returns non-zero when the member has been read or on an error                 */
+static int dcmp_tar(struct dcmp *d, const char *buf, long long n)
+{
+  int i, k;
+
+  long long size;
+
+
+  while(n > 0)
+  {
+    switch(d->tar_state)
+    {
+      case DCMP_TAR_HEADER :
+
+        k = 512 - d->tar_hdr_len;
+        if(k > n)  k = n;
+        memcpy(d->tar_hdr + d->tar_hdr_len, buf, k);
+        d->tar_hdr_len += k;
+        buf += k;
+        n -= k;
+        if(d->tar_hdr_len < 512)  break;
+        d->tar_hdr_len = 0;
+
+        for(i=0; (i<512)&&(d->tar_hdr[i]==0); i++);
+        if(i == 512)
+        {
+          /* end of the archive */
+          return 1;
+        }
+
+        size = tar_size(d->tar_hdr + 124);
+        if(size < 0)
+        {
+          snprintf(d->errmsg, 256, "Error, the file is not a valid tar archive");
+          return -1;
+        }
+        d->tar_pad = ((size + 511) / 512) * 512 - size;
+
+        if(d->tar_hdr[156] == 'L')
+        {
+          d->tar_state = DCMP_TAR_NAME;
+          d->tar_remain = size;
+          d->long_name_len = 0;
+          break;
+        }
+
+        if(!d->long_name_len)
+        {
+          if((!memcmp(d->tar_hdr + 257, "ustar", 5)) && (d->tar_hdr[345] != 0))
+          {
+            snprintf(d->long_name, 1024, "%.155s/%.100s", d->tar_hdr + 345, d->tar_hdr);
+          }
+          else
+          {
+            snprintf(d->long_name, 1024, "%.100s", d->tar_hdr);
+          }
+        }
+        d->long_name_len = 0;
+
+        if(is_edf_member(d->long_name, d->tar_hdr[156]))
+        {
+          strcpy(d->member, d->long_name);
+          d->tar_state = DCMP_TAR_DATA;
+          d->tar_remain = size;
+
+          pthread_mutex_lock(&d->lock);
+          d->member_found = 1;
+          pthread_cond_broadcast(&d->filled);
+          pthread_mutex_unlock(&d->lock);
+
+          if(!size)  return 1;
+        }
+        else
+        {
+          d->tar_state = DCMP_TAR_SKIP;
+          d->tar_remain = size + d->tar_pad;
+        }
+        break;
+
+      case DCMP_TAR_NAME :
+
+        k = (d->tar_remain < n) ? d->tar_remain : n;
+        for(i=0; (i<k)&&(d->long_name_len<1023); i++)
+        {
+          d->long_name[d->long_name_len++] = buf[i];
+        }
+        d->long_name[d->long_name_len] = 0;
+        buf += k;
+        n -= k;
+        d->tar_remain -= k;
+        if(!d->tar_remain)
+        {
+          d->tar_state = DCMP_TAR_SKIP;
+          d->tar_remain = d->tar_pad;
+        }
+        break;
+
+      case DCMP_TAR_SKIP :
+
+        k = (d->tar_remain < n) ? d->tar_remain : n;
+        buf += k;
+        n -= k;
+        d->tar_remain -= k;
+        break;
+
+      case DCMP_TAR_DATA :
+
+        k = (d->tar_remain < n) ? d->tar_remain : n;
+        if(dcmp_put(d, buf, k))  return -1;
+        buf += k;
+        n -= k;
+        d->tar_remain -= k;
+        if(!d->tar_remain)  return 1;
+        break;
+    }
+
+    if((d->tar_state == DCMP_TAR_SKIP) && (!d->tar_remain))
+    {
+      d->tar_state = DCMP_TAR_HEADER;
+    }
+  }
+
+  return 0;
+}
+
+
+/* passes a block of decompressed data on, returns non-zero when decompression can stop */
+static int dcmp_emit(struct dcmp *d, const char *buf, long long n)
+{
+  int stop;
+
+
+  pthread_mutex_lock(&d->lock);
+  stop = d->stop;
+  pthread_mutex_unlock(&d->lock);
+
+  if(stop)  return -1;
+
+  if(d->type & DCMP_TAR)
+  {
+    return dcmp_tar(d, buf, n);
+  }
+
+  return dcmp_put(d, buf, n);
+}
+
+
+static void dcmp_gunzip(struct dcmp *d)
+{
+#ifdef DCMP_HAVE_ZLIB
+  int r=Z_OK,
+      n,
+      eof=0,
+      full=0;
+
+  z_stream zs;
+
+
+  memset(&zs, 0, sizeof(z_stream));
+
+  /* 32 accepts both gzip and zlib headers */
+  if(inflateInit2(&zs, 15 + 32) != Z_OK)
+  {
+    snprintf(d->errmsg, 256, "Malloc error! (zlib)");
+    return;
+  }
+
+  while(1)
+  {
+    /* zlib may still hold output when the last call filled the buffer */
+    if((!zs.avail_in) && (!full))
+    {
+      if(eof)
+      {
+        if(r != Z_STREAM_END)
+        {
+          snprintf(d->errmsg, 256, "Error, unexpected end of the gzip data");
+        }
+        break;
+      }
+
+      n = fread(d->inbuf, 1, DCMP_INBUF, d->file);
+      if(n < 1)
+      {
+        if(ferror(d->file))
+        {
+          snprintf(d->errmsg, 256, "Error when reading the compressed file");
+          break;
+        }
+        eof = 1;
+        continue;
+      }
+      zs.next_in = (Bytef *)d->inbuf;
+      zs.avail_in = n;
+    }
+
+    if(r == Z_STREAM_END)
+    {
+      /* concatenated gzip members form one file */
+      inflateReset(&zs);
+    }
+
+    zs.next_out = (Bytef *)d->outbuf;
+    zs.avail_out = DCMP_SLOT_SIZE;
+
+    r = inflate(&zs, Z_NO_FLUSH);
+    if((r != Z_OK) && (r != Z_STREAM_END) && (r != Z_BUF_ERROR))
+    {
+      snprintf(d->errmsg, 256, "Error, corrupt gzip data (%s)", (zs.msg != NULL) ? zs.msg : "zlib error");
+      break;
+    }
+
+    full = (!zs.avail_out) && (r != Z_STREAM_END);
+
+    if(dcmp_emit(d, d->outbuf, DCMP_SLOT_SIZE - zs.avail_out))  break;
+  }
+
+  inflateEnd(&zs);
+#else
+  snprintf(d->errmsg, 256, "Error, gzip is not supported by this build");
+#endif
+}
+
+
+static void dcmp_unxz(struct dcmp *d)
+{
+#ifdef DCMP_HAVE_LZMA
+  size_t n;
+
+  lzma_stream ls = LZMA_STREAM_INIT;
+
+  lzma_action action = LZMA_RUN;
+
+  lzma_ret r;
+
+
+  if(lzma_stream_decoder(&ls, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+  {
+    snprintf(d->errmsg, 256, "Malloc error! (lzma)");
+    return;
+  }
+
+  while(1)
+  {
+    if((!ls.avail_in) && (action == LZMA_RUN))
+    {
+      n = fread(d->inbuf, 1, DCMP_INBUF, d->file);
+      if(ferror(d->file))
+      {
+        snprintf(d->errmsg, 256, "Error when reading the compressed file");
+        break;
+      }
+      if(!n)  action = LZMA_FINISH;
+      ls.next_in = (const uint8_t *)d->inbuf;
+      ls.avail_in = n;
+    }
+
+    ls.next_out = (uint8_t *)d->outbuf;
+    ls.avail_out = DCMP_SLOT_SIZE;
+
+    r = lzma_code(&ls, action);
+
+    if(dcmp_emit(d, d->outbuf, DCMP_SLOT_SIZE - ls.avail_out))  break;
+
+    if(r == LZMA_STREAM_END)  break;
+
+    if(r != LZMA_OK)
+    {
+      if(r == LZMA_MEM_ERROR)
+      {
+        snprintf(d->errmsg, 256, "Malloc error! (lzma)");
+      }
+      else if(r == LZMA_BUF_ERROR)
+        {
+          snprintf(d->errmsg, 256, "Error, unexpected end of the xz data");
+        }
+        else if(r == LZMA_FORMAT_ERROR)
+          {
+            snprintf(d->errmsg, 256, "Error, the file is not in the xz format");
+          }
+          else
+          {
+            snprintf(d->errmsg, 256, "Error, corrupt xz data (%i)", (int)r);
+          }
+      break;
+    }
+  }
+
+  lzma_end(&ls);
+#else
+  snprintf(d->errmsg, 256, "Error, xz is not supported by this build");
+#endif
+}
+
+
+/* copies the data of a pipe or a file as it is, so that it is read ahead of the converter, */
+/* the pipe is polled so that the thread stops when the reader does, also without new data */
+static void dcmp_copy(struct dcmp *d)
+{
+  int stop;
+
+  long long n;
+
+  struct pollfd pfd;
+
+
+  pfd.fd = d->fd;
+  pfd.events = POLLIN;
+
+  while(1)
+  {
+    n = poll(&pfd, 1, DCMP_POLL_MS);
+    if(n < 1)
+    {
+      if((n < 0) && (errno != EINTR))
+      {
+        snprintf(d->errmsg, 256, "Error when reading the file");
+        break;
+      }
+
+      pthread_mutex_lock(&d->lock);
+      stop = d->stop;
+      pthread_mutex_unlock(&d->lock);
+
+      if(stop)  break;
+
+      continue;
+    }
+
+    n = read(d->fd, d->outbuf, DCMP_SLOT_SIZE);
+    if(n < 0)
+    {
+      if((errno == EINTR) || (errno == EAGAIN))  continue;
+
+      snprintf(d->errmsg, 256, "Error when reading the file");
+      break;
+    }
+
+    if(!n)  break;
+
+    if(dcmp_emit(d, d->outbuf, n))  break;
+  }
+}
+
+
+static void * dcmp_thread(void *arg)
+{
+  struct dcmp *d;
+
+
+  d = (struct dcmp *)arg;
+
+  if(d->fd >= 0)
+  {
+    dcmp_copy(d);
+  }
+  else if(d->type & DCMP_GZIP)
+    {
+      dcmp_gunzip(d);
+    }
+    else
+    {
+      dcmp_unxz(d);
+    }
+
+  if((d->fill != NULL) && d->fill_len)
+  {
+    dcmp_push(d);
+  }
+
+  if((d->type & DCMP_TAR) && (d->tar_state == DCMP_TAR_DATA) && d->tar_remain && (!d->errmsg[0]))
+  {
+    snprintf(d->errmsg, 256, "Error, the tar archive is truncated");
+  }
+
+  pthread_mutex_lock(&d->lock);
+  d->done = 1;
+  pthread_cond_broadcast(&d->filled);
+  pthread_mutex_unlock(&d->lock);
+
+  return NULL;
+}
+
+
+struct dcmp * dcmp_open(const char *path, int type, char *errmsg, int errmsg_len)
+{
+  struct dcmp *d;
+
+
+#ifndef DCMP_HAVE_ZLIB
+  if(type & DCMP_GZIP)
+  {
+    snprintf(errmsg, errmsg_len, "Error, this build can not read gzip compressed files");
+    return NULL;
+  }
+#endif
+#ifndef DCMP_HAVE_LZMA
+  if(type & DCMP_XZ)
+  {
+    snprintf(errmsg, errmsg_len, "Error, this build can not read xz compressed files");
+    return NULL;
+  }
+#endif
+
+  d = (struct dcmp *)calloc(1, sizeof(struct dcmp));
+  if(d == NULL)
+  {
+    snprintf(errmsg, errmsg_len, "Malloc error! (dcmp)");
+    return NULL;
+  }
+
+  d->type = type;
+  d->fd = -1;
+  pthread_mutex_init(&d->lock, NULL);
+  pthread_cond_init(&d->filled, NULL);
+  pthread_cond_init(&d->emptied, NULL);
+
+  d->ring = (char *)malloc((long long)DCMP_SLOTS * DCMP_SLOT_SIZE);
+  d->inbuf = (char *)malloc(DCMP_INBUF);
+  d->outbuf = (char *)malloc(DCMP_SLOT_SIZE);
+  if((d->ring == NULL) || (d->inbuf == NULL) || (d->outbuf == NULL))
+  {
+    snprintf(errmsg, errmsg_len, "Malloc error! (dcmp)");
+    goto OUT_ERROR;
+  }
+
+  d->file = fopen(path, "rb");
+  if(d->file == NULL)
+  {
+    snprintf(errmsg, errmsg_len, "Error, can not open file %s for reading", path);
+    goto OUT_ERROR;
+  }
+
+  if(pthread_create(&d->thread, NULL, dcmp_thread, d))
+  {
+    snprintf(errmsg, errmsg_len, "Error, can not start the decompression thread");
+    goto OUT_ERROR;
+  }
+  d->started = 1;
+
+  if(type & DCMP_TAR)
+  {
+    /* the output is named after the member, so wait until it is known */
+    pthread_mutex_lock(&d->lock);
+    while((!d->member_found) && (!d->done))
+    {
+      pthread_cond_wait(&d->filled, &d->lock);
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    if(!d->member_found)
+    {
+      if(d->errmsg[0])
+      {
+        snprintf(errmsg, errmsg_len, "%s: %s", path, d->errmsg);
+      }
+      else
+      {
+        snprintf(errmsg, errmsg_len, "Error, there is no .edf or .bdf file in %s", path);
+      }
+      goto OUT_ERROR;
+    }
+  }
+
+  return d;
+
+OUT_ERROR:
+
+  dcmp_close(d);
+
+  return NULL;
+}
+
+
+struct dcmp * dcmp_open_fd(int fd, char *errmsg, int errmsg_len)
+{
+  struct dcmp *d;
+
+
+  d = (struct dcmp *)calloc(1, sizeof(struct dcmp));
+  if(d == NULL)
+  {
+    snprintf(errmsg, errmsg_len, "Malloc error! (dcmp)");
+    close(fd);
+    return NULL;
+  }
+
+  d->type = DCMP_NONE;
+  d->fd = fd;
+  pthread_mutex_init(&d->lock, NULL);
+  pthread_cond_init(&d->filled, NULL);
+  pthread_cond_init(&d->emptied, NULL);
+
+  d->ring = (char *)malloc((long long)DCMP_SLOTS * DCMP_SLOT_SIZE);
+  d->outbuf = (char *)malloc(DCMP_SLOT_SIZE);
+  if((d->ring == NULL) || (d->outbuf == NULL))
+  {
+    snprintf(errmsg, errmsg_len, "Malloc error! (dcmp)");
+    dcmp_close(d);
+    return NULL;
+  }
+
+  if(pthread_create(&d->thread, NULL, dcmp_thread, d))
+  {
+    snprintf(errmsg, errmsg_len, "Error, can not start the read thread");
+    dcmp_close(d);
+    return NULL;
+  }
+  d->started = 1;
+
+  return d;
+}
+
+
+const char * dcmp_member(const struct dcmp *d)
+{
+  if(!(d->type & DCMP_TAR))  return NULL;
+
+  return d->member;
+}
+
+
+long long dcmp_read(void *ctx, char *buf, long long len)
+{
+  struct dcmp *d;
+
+  long long n=0,
+            k;
+
+
+  d = (struct dcmp *)ctx;
+
+  while(n < len)
+  {
+    if(d->cur == NULL)
+    {
+      pthread_mutex_lock(&d->lock);
+      while((!d->count) && (!d->done))
+      {
+        pthread_cond_wait(&d->filled, &d->lock);
+      }
+      if(!d->count)
+      {
+        pthread_mutex_unlock(&d->lock);
+
+        if(n)  return n;
+
+        return d->errmsg[0] ? -1 : 0;
+      }
+      d->cur = d->ring + (long long)d->head * DCMP_SLOT_SIZE;
+      d->cur_len = d->slot_len[d->head];
+      d->cur_pos = 0;
+      pthread_mutex_unlock(&d->lock);
+    }
+
+    k = d->cur_len - d->cur_pos;
+    if(k > (len - n))  k = len - n;
+
+    memcpy(buf + n, d->cur + d->cur_pos, k);
+    d->cur_pos += k;
+    n += k;
+
+    if(d->cur_pos == d->cur_len)
+    {
+      pthread_mutex_lock(&d->lock);
+      d->head = (d->head + 1) % DCMP_SLOTS;
+      d->count--;
+      pthread_cond_signal(&d->emptied);
+      pthread_mutex_unlock(&d->lock);
+
+      d->cur = NULL;
+    }
+  }
+
+  return n;
+}
+
+
+const char * dcmp_error(struct dcmp *d)
+{
+  const char *msg=NULL;
+
+
+  pthread_mutex_lock(&d->lock);
+  if(d->done && d->errmsg[0])
+  {
+    msg = d->errmsg;
+  }
+  pthread_mutex_unlock(&d->lock);
+
+  return msg;
+}
+
+
+void dcmp_close(struct dcmp *d)
+{
+  if(d == NULL)  return;
+
+  if(d->started)
+  {
+    pthread_mutex_lock(&d->lock);
+    d->stop = 1;
+    pthread_cond_broadcast(&d->emptied);
+    pthread_mutex_unlock(&d->lock);
+
+    pthread_join(d->thread, NULL);
+  }
+
+  if(d->file != NULL)
+  {
+    fclose(d->file);
+  }
+
+  if(d->fd >= 0)
+  {
+    close(d->fd);
+  }
+
+  pthread_mutex_destroy(&d->lock);
+  pthread_cond_destroy(&d->filled);
+  pthread_cond_destroy(&d->emptied);
+
+  free(d->ring);
+  free(d->inbuf);
+  free(d->outbuf);
+  free(d);
+}
@@ -0,0 +1,90 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+/*
+ * Reads gzip and xz compressed EDF/BDF files, also from inside a tar archive,
+ * without writing the decompressed file to disk.
+ *
+ * A thread decompresses the file into a ring of buffers while the converter
+ * reads the datarecords from the other end through dcmp_read(), which has the
+ * form of an edfrd_read_fn. The ring is bounded, so the decompressor waits when
+ * it runs ahead and memory use does not depend on the size of the file.
+ *
+ * dcmp_open_fd() runs the same ring for data that is not compressed, such as
+ * a pipe, so that reading it overlaps the conversion.
+ *
+ * Support for each compression format is compiled in with DCMP_HAVE_ZLIB and
+ * DCMP_HAVE_LZMA (see the makefile).
+ */
+
+
+#ifndef DECOMPRESS_INCLUDED
+#define DECOMPRESS_INCLUDED
+
+
+#define DCMP_NONE       (0)
+#define DCMP_GZIP       (1)
+#define DCMP_XZ         (2)
+#define DCMP_TAR        (4)  /* added to DCMP_GZIP or DCMP_XZ */
+
+#define DCMP_SLOT_SIZE  (256 * 1024)
+#define DCMP_SLOTS      (8)
+
+
+struct dcmp;
+
+
+/* returns the compression of path judged by its name, for example DCMP_GZIP for "x.edf.gz" */
+/* or DCMP_XZ + DCMP_TAR for "x.tar.xz", and the length of that suffix in *suffix_len,      */
+/* returns DCMP_NONE for other names                                                        */
+int dcmp_type(const char *path, int *suffix_len);
+
+/* opens path and starts the decompression thread, in a tar archive the first .edf or .bdf  */
+/* member is read, returns NULL with a message in errmsg when the file can not be opened,   */
+/* when this build does not support the format, or when the archive has no such member     */
+struct dcmp * dcmp_open(const char *path, int type, char *errmsg, int errmsg_len);
+
+/* starts a thread that reads fd, as it is, into the ring, the data is read ahead while */
+/* the converter works, fd is closed by dcmp_close(), also when NULL is returned         */
+struct dcmp * dcmp_open_fd(int fd, char *errmsg, int errmsg_len);
+
+/* the name of the member that is read from a tar archive, NULL for other files */
+const char * dcmp_member(const struct dcmp *d);
+
+/* reads up to len bytes of decompressed data, returns the number of bytes, 0 at the end */
+/* of the data, or -1 when decompression failed, ctx is the struct dcmp                   */
+long long dcmp_read(void *ctx, char *buf, long long len);
+
+/* the reason why dcmp_read() returned -1, or NULL */
+const char * dcmp_error(struct dcmp *d);
+
+/* stops the thread, also when not all the data has been read, and closes the file */
+void dcmp_close(struct dcmp *d);
+
+
+#endif
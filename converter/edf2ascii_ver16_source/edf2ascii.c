@@ -29,965 +29,326 @@
 #include <stdlib.h>
 #include <string.h>
 #include <locale.h>
+#include <math.h>
+#include <getopt.h>
+#include <unistd.h>
 
+#include "convert.h"
+#include "batch.h"
 
-#define FP_SCALING   (1000000000LL)
 
-
-struct edfparamblock{
-         int smp_per_record;
-         int smp_written;
-         int dig_min;
-         int dig_max;
-         double offset;
-         int buf_offset;
-         double phys_min;
-         double phys_max;
-         long long time_step;
-         double sense;
-       } *edfparam;
-
-
-void utf8_to_latin1(char *);
-long long atoll_x(const char *, int);
-
-
-int main(int argc, char **argv)
+static void usage(void)
 {
-  FILE *inputfile=NULL,
-       *outputfile=NULL,
-       *annotationfile=NULL;
-
-  const char *fileName="";
-
-  int i, j, k, p, r, m, n,
-      pathlen,
-      fname_len,
-      signals,
-      datarecords,
-      datarecordswritten,
-      recordsize,
-      recordfull,
-      edf=0,
-      bdf=0,
-      edfplus=0,
-      bdfplus=0,
-      annot_ch[256],
-      nr_annot_chns,
-      skip,
-      max,
-      onset,
-      duration,
-      zero,
-      max_tal_ln,
-      samplesize;
-
-  char path[1024]="",
-       ascii_path[1024]="",
-       *edf_hdr=NULL,
-       *scratchpad=NULL,
-       *cnv_buf=NULL,
-       *time_in_txt=NULL,
-       *duration_in_txt=NULL;
-
-  long long data_record_duration,
-            elapsedtime,
-            time_tmp,
-            d_tmp;
-
-  double value_tmp=0;
-
-  union {
-          unsigned int one;
-          signed int one_signed;
-          unsigned short two[2];
-          signed short two_signed[2];
-          unsigned char four[4];
-        } var;
-
-
-
-  setlocale(LC_ALL, "C");
-
-  if(argc!=2)
-  {
-    printf("\nEDF(+) or BDF(+) to ASCII converter version 1.6\n"
-           "Copyright 2007 - 2021 Teunis van Beelen\n"
-           "teuniz@protonmail.com\n"
-           "Usage: edf2ascii <filename>\n\n");
-    goto OUT_ERROR;
-  }
-
-  strcpy(path, argv[1]);
-  strcpy(ascii_path, argv[1]);
-
-  pathlen = strlen(path);
-
-  if(pathlen<5)
-  {
-    printf("Error, filename must contain at least five characters.\n");
-    goto OUT_ERROR;
-  }
-
-  scratchpad = (char *)malloc(128);
-  if(scratchpad==NULL)
-  {
-    printf("Malloc error! (scratchpad).\n");
-    goto OUT_ERROR;
-  }
-
-  fname_len = 0;
-  for(i=pathlen; i>0; i--)
-  {
-       if((path[i-1]=='/')||(path[i-1]=='\\'))  break;
-       fname_len++;
-  }
-  fileName = path + pathlen - fname_len;
-
-  for(i=0; fileName[i]!=0; i++);
-  if(i==0)
-  {
-    printf("Error, filename must contain at least five characters.\n");
-    goto OUT_ERROR;
-  }
-
-  i -= 4;
-  if((strcmp((const char *)fileName + i, ".edf")) &&
-     (strcmp((const char *)fileName + i, ".EDF")) &&
-     (strcmp((const char *)fileName + i, ".bdf")) &&
-     (strcmp((const char *)fileName + i, ".BDF")))
-  {
-    printf("Error, filename extension must have the form \".edf\" or \".EDF\" or \".bdf\" or \".BDF\"\n");
-    goto OUT_ERROR;
-  }
-
-  if((!strcmp((const char *)fileName + i, ".edf")) ||
-     (!strcmp((const char *)fileName + i, ".EDF")))
-  {
-    edf = 1;
-    samplesize = 2;
-  }
-  else
-  {
-    bdf = 1;
-    samplesize = 3;
-  }
-
-/***************** check header ******************************/
-
-  inputfile = fopen(path, "rb");
-  if(inputfile==NULL)
-  {
-    printf("Error, can not open file %s for reading\n", path);
-    goto OUT_ERROR;
-  }
-
-  if(fseek(inputfile, 0xfc, SEEK_SET))
-  {
-    printf("Error, reading file %s\n", path);
-    goto OUT_ERROR;
-  }
-
-  if(fread(scratchpad, 4, 1, inputfile)!=1)
-  {
-    printf("Error, reading file %s\n", path);
-    goto OUT_ERROR;
-  }
-
-  scratchpad[4] = 0;
-  signals = atoi(scratchpad);
-  if((signals<1)||(signals>256))
-  {
-    printf("Error, number of signals in header is %i\n", signals);
-    goto OUT_ERROR;
-  }
-
-  edf_hdr = (char *)malloc((signals + 1) * 256);
-  if(edf_hdr==NULL)
-  {
-    printf("Malloc error! (edf_hdr)\n");
-    goto OUT_ERROR;
-  }
-
-  rewind(inputfile);
-  if(fread(edf_hdr, (signals + 1) * 256, 1, inputfile)!=1)
-  {
-    printf("Error, reading file %s\n", path);
-    goto OUT_ERROR;
-  }
-
-  for(i=0; i<((signals+1)*256); i++)
-  {
-    if(edf_hdr[i]==',') edf_hdr[i] = '\'';  /* replace all comma's in header by single quotes because they */
-  }                                         /* interfere with the comma-separated txt-files                */
-
-  if(edf)
-  {
-    if(strncmp(edf_hdr, "0       ", 8))
-    {
-      printf("Error, EDF-header has unknown version\n");
-      goto OUT_ERROR;
-    }
-  }
-
-  if(bdf)
-  {
-    if(strncmp(edf_hdr + 1, "BIOSEMI", 7) || (edf_hdr[0] != -1))
-    {
-      printf("Error, BDF-header has unknown version\n");
-      goto OUT_ERROR;
-    }
-  }
-
-  strncpy(scratchpad, edf_hdr + 0xec, 8);
-  scratchpad[8] = 0;
-  datarecords = atoi(scratchpad);
-  if(datarecords<1)
-  {
-    printf("Error, number of datarecords in header is %i\n", datarecords);
-    goto OUT_ERROR;
-  }
-
-  strncpy(scratchpad, edf_hdr + 0xf4, 8);
-  scratchpad[8] = 0;
-  data_record_duration = atoll_x(scratchpad, FP_SCALING);
-
-  nr_annot_chns = 0;
-
-  if((strncmp(edf_hdr + 0xc0, "EDF+C     ", 10))&&(strncmp(edf_hdr + 0xc0, "EDF+D     ", 10)))
-  {
-    edfplus = 0;
-  }
-  else
-  {
-    edfplus = 1;
-    for(i=0; i<signals; i++)
-    {
-      if(!(strncmp(edf_hdr + 256 + i * 16, "EDF Annotations ", 16)))
-      {
-        annot_ch[nr_annot_chns] = i;
-        nr_annot_chns++;
-        if(nr_annot_chns>255)  break;
-      }
-    }
-    if(!nr_annot_chns)
-    {
-      printf("Error, file is marked as EDF+ but it has no annotationsignal.\n");
-      goto OUT_ERROR;
-    }
-  }
-
-  if((strncmp(edf_hdr + 0xc0, "BDF+C     ", 10))&&(strncmp(edf_hdr + 0xc0, "BDF+D     ", 10)))
-  {
-    bdfplus = 0;
-  }
-  else
-  {
-    bdfplus = 1;
-    for(i=0; i<signals; i++)
-    {
-      if(!(strncmp(edf_hdr + 256 + i * 16, "BDF Annotations ", 16)))
-      {
-        annot_ch[nr_annot_chns] = i;
-        nr_annot_chns++;
-        if(nr_annot_chns>255)  break;
-      }
-    }
-    if(!nr_annot_chns)
-    {
-      printf("Error, file is marked as BDF+ but it has no annotationsignal.\n");
-      goto OUT_ERROR;
-    }
-  }
-
-  edfparam = (struct edfparamblock *)malloc(signals * sizeof(struct edfparamblock));
-  if(edfparam==NULL)
-  {
-    printf("Malloc error! (edfparam)\n");
-    goto OUT_ERROR;
-  }
-
-  recordsize = 0;
-
-  for(i=0; i<signals; i++)
-  {
-    strncpy(scratchpad, edf_hdr + 256 + signals * 216 + i * 8, 8);
-    scratchpad[8] = 0;
-    edfparam[i].smp_per_record = atoi(scratchpad);
-    edfparam[i].buf_offset = recordsize;
-    recordsize += edfparam[i].smp_per_record;
-    strncpy(scratchpad, edf_hdr + 256 + signals * 104 + i * 8, 8);
-    scratchpad[8] = 0;
-    edfparam[i].phys_min = atof(scratchpad);
-    strncpy(scratchpad, edf_hdr + 256 + signals * 112 + i * 8, 8);
-    scratchpad[8] = 0;
-    edfparam[i].phys_max = atof(scratchpad);
-    strncpy(scratchpad, edf_hdr + 256 + signals * 120 + i * 8, 8);
-    scratchpad[8] = 0;
-    edfparam[i].dig_min = atoi(scratchpad);
-    strncpy(scratchpad, edf_hdr + 256 + signals * 128 + i * 8, 8);
-    scratchpad[8] = 0;
-    edfparam[i].dig_max = atoi(scratchpad);
-    edfparam[i].time_step = data_record_duration / edfparam[i].smp_per_record;
-    edfparam[i].sense = (edfparam[i].phys_max - edfparam[i].phys_min) / (edfparam[i].dig_max - edfparam[i].dig_min);
-    edfparam[i].offset = edfparam[i].phys_max / edfparam[i].sense - edfparam[i].dig_max;
-  }
-
-  cnv_buf = (char *)malloc(recordsize * samplesize);
-  if(cnv_buf==NULL)
-  {
-    printf("Malloc error! (cnv_buf)\n");
-    goto OUT_ERROR;
-  }
-
-  free(scratchpad);
-  scratchpad = NULL;
-
-  max_tal_ln = 0;
-
-  for(r=0; r<nr_annot_chns; r++)
-  {
-    if(max_tal_ln<edfparam[annot_ch[r]].smp_per_record * samplesize)  max_tal_ln = edfparam[annot_ch[r]].smp_per_record * samplesize;
-  }
-
-  if(max_tal_ln<128)  max_tal_ln = 128;
-
-  scratchpad = (char *)malloc(max_tal_ln + 3);
-  if(scratchpad==NULL)
-  {
-    printf("Malloc error! (scratchpad)\n");
-    goto OUT_ERROR;
-  }
-
-  duration_in_txt = (char *)malloc(max_tal_ln + 3);
-  if(duration_in_txt==NULL)
-  {
-    printf("Malloc error! (duration_in_txt)\n");
-    goto OUT_ERROR;
-  }
-
-  time_in_txt = (char *)malloc(max_tal_ln + 3);
-  if(time_in_txt==NULL)
-  {
-    printf("Malloc error! (time_in_txt)\n");
-    goto OUT_ERROR;
-  }
-
-/***************** write header ******************************/
-
-  ascii_path[pathlen-4] = 0;
-  strcat(ascii_path, "_header.txt");
-  outputfile = fopen(ascii_path, "wb");
-  if(outputfile==NULL)
-  {
-    printf("Error, can not open file %s for writing\n", ascii_path);
-    goto OUT_ERROR;
-  }
-
-  fprintf(outputfile, "Version,Patient,Recording,Startdate,Startime,Bytes,Reserved,NumRec,Duration,NumSig\n");
-
-  if(edf)
-  {
-    fprintf(outputfile, "%.8s,", edf_hdr);
-  }
-  else
-  {
-    fprintf(outputfile, ".%.7s,", edf_hdr + 1);
-  }
-  fprintf(outputfile, "%.80s,", edf_hdr + 8);
-  fprintf(outputfile, "%.80s,", edf_hdr + 88);
-  fprintf(outputfile, "%.8s,", edf_hdr + 168);
-  fprintf(outputfile, "%.8s,", edf_hdr + 176);
-  fprintf(outputfile, "%.8s,", edf_hdr + 184);
-  fprintf(outputfile, "%.44s,", edf_hdr + 192);
-  fprintf(outputfile, "%i,", datarecords);
-  fprintf(outputfile, "%.8s,", edf_hdr + 244);
-  sprintf(scratchpad, "%.4s", edf_hdr + 252);
-  fprintf(outputfile, "%i\n", atoi(scratchpad) - nr_annot_chns);
-
-  fclose(outputfile);
-  outputfile = NULL;
-
-/***************** write signals ******************************/
-
-  ascii_path[pathlen-4] = 0;
-  strcat(ascii_path, "_signals.txt");
-  outputfile = fopen(ascii_path, "wb");
-  if(outputfile==NULL)
-  {
-    printf("Error, can not open file %s for writing\n", ascii_path);
-    goto OUT_ERROR;
-  }
+  printf("\nEDF(+) or BDF(+) to ASCII converter version 1.6\n"
+         "Copyright 2007 - 2021 Teunis van Beelen\n"
+         "teuniz@protonmail.com\n"
+         "Usage: edf2ascii [options] <filename>\n"
+         "       edf2ascii [options] <filename | directory | @listfile> ...\n\n"
+         "       edf2ascii [options] - < file\n\n"
+         "  -p, --precision=N   number of decimals of the sample values (0 - 9, default 6)\n"
+         "  -j, --threads=N     convert the datarecords with N threads, 0 uses all CPUs (default 1)\n"
+         "  -J, --jobs=N        convert N files at the same time, 0 uses all CPUs (default 1)\n"
+         "  -s, --signals=LIST  convert only these signals, a comma-separated list of signal\n"
+         "                      numbers (as in the _signals.txt file) and/or labels\n"
+         "  -r, --rate=LIST     lower the sample rate, with an anti-alias filter, to RATE Hz for\n"
+         "                      all signals with a higher rate, or per signal with SIGNAL=RATE\n"
+         "                      (e.g. 100 or 100,EMG=500), a datarecord must hold a whole\n"
+         "                      number of samples at the new rate\n"
+         "  -f, --format=FORMAT txt (default) writes _data.txt, npy writes a NumPy .npy file\n"
+         "                      per signal and the start times of the datarecords instead, and\n"
+         "                      the onsets and durations of the annotations in nanoseconds,\n"
+         "                      groups writes a _data_<RATE>Hz.txt table per sample rate instead\n"
+         "                      of _data.txt, without the empty cells of the slower signals\n"
+         "      --float32       store single precision values in the .npy files\n"
+         "      --digital       write the digital values as they are in the file instead of the\n"
+         "                      physical values, as integers in _data.txt or as int16 (EDF) or\n"
+         "                      int32 (BDF) in the .npy files, physical = (digital - Dmin) *\n"
+         "                      (Max - Min) / (Dmax - Dmin) + Min with the columns of _signals.txt\n"
+         "      --annotations-only\n"
+         "                      write only the _header, _signals and _annotations files, only the\n"
+         "                      annotation signals are read and no samples are converted\n"
+         "      --pyramid       also write _pyramid.bin, the min, max and mean of every data signal\n"
+         "                      per 16, 32, 64, ... samples, for drawing overviews of the recording\n"
+         "  -t, --time=START[,END]\n"
+         "                      convert only the part of the recording between START and END,\n"
+         "                      in seconds from the start of the file\n"
+         "  -o, --output=BASE   output filenames start with BASE instead of the input filename\n"
+         "      --header-to=DEST, --signals-to=DEST, --annotations-to=DEST, --data-to=DEST\n"
+         "                      write that output to DEST: a filename, - for stdout or fd:N\n"
+         "                      for a file descriptor that is already open\n"
+         "      --stats[=FORMAT]\n"
+         "                      print the time spent per stage, the bytes read and written,\n"
+         "                      datarecords/s, samples/s and the peak RSS to stderr,\n"
+         "                      FORMAT is text (default) or json (one line per file)\n"
+         "      --follow[=IDLE] the file is still being recorded: convert its datarecords as\n"
+         "                      they are appended, until the recording is closed or no new\n"
+         "                      datarecord came for IDLE seconds\n"
+         "      --checkpoint=FILE\n"
+         "                      keep in FILE how far the conversion got, a next run (also after\n"
+         "                      a crash) converts only the new datarecords and appends them\n"
+         "      --index[=FILE]  find the time window with the index in FILE (default the filename\n"
+         "                      followed by .idx), which is made first when it does not exist or\n"
+         "                      the file changed, it lists the start time of every segment of\n"
+         "                      datarecords without a gap and all annotations with their datarecord\n\n"
+         "Files named *.edf.gz, *.bdf.xz, etc. are decompressed while they are converted,\n"
+         "from a .tar.gz, .tgz, .tar.xz or .txz archive the first .edf or .bdf file is converted.\n\n"
+         "The filename - reads the file from stdin (or a pipe) in one pass, without -o the\n"
+         "data is written to stdout and the other outputs only where --*-to asks for them.\n\n"
+         "More than one file, a directory (all .edf and .bdf files in it) or a listfile\n"
+         "(one filename per line) converts all files in one run and prints a summary.\n\n");
+}
 
-  fprintf(outputfile, "Signal,Label,Transducer,Units,Min,Max,Dmin,Dmax,PreFilter,Smp/Rec,Reserved\n");
 
-  for(i=0; i<signals; i++)
-  {
-    if(edfplus || bdfplus)
-    {
-      skip = 0;
-
-      for(j=0; j<nr_annot_chns; j++)
-      {
-        if(i==annot_ch[j])  skip = 1;
-      }
+/* parses "START[,END]" in seconds into nanoSeconds */
+static int parse_time_window(const char *str, long long *start, long long *end)
+{
+  double val;
 
-      if(skip) continue;
-    }
+  char *endptr;
 
-    fprintf(outputfile, "%i,", i + 1);
-    fprintf(outputfile, "%.16s,", edf_hdr + 256 + i * 16);
-    fprintf(outputfile, "%.80s,", edf_hdr + 256 + signals * 16 + i * 80);
-    fprintf(outputfile, "%.8s,", edf_hdr + 256 + signals * 96 + i * 8);
-    fprintf(outputfile, "%f,", edfparam[i].phys_min);
-    fprintf(outputfile, "%f,", edfparam[i].phys_max);
-    fprintf(outputfile, "%i,", edfparam[i].dig_min);
-    fprintf(outputfile, "%i,", edfparam[i].dig_max);
-    fprintf(outputfile, "%.80s,", edf_hdr + 256 + signals * 136 + i * 80);
-    fprintf(outputfile, "%i,", edfparam[i].smp_per_record);
-    fprintf(outputfile, "%.32s\n", edf_hdr + 256 + signals * 224 + i * 32);
-  }
 
-  fclose(outputfile);
-  outputfile = NULL;
+  val = strtod(str, &endptr);
+  if((endptr == str) || (val < 0.0) || (val > 1e9))  return -1;
+  *start = llround(val * 1e9);
 
-/***************** open annotation file ******************************/
+  *end = -1LL;
 
-  ascii_path[pathlen-4] = 0;
-  strcat(ascii_path, "_annotations.txt");
-  annotationfile = fopen(ascii_path, "wb");
-  if(annotationfile==NULL)
+  if(*endptr == ',')
   {
-    printf("Error, can not open file %s for writing\n", ascii_path);
-    goto OUT_ERROR;
+    str = endptr + 1;
+    val = strtod(str, &endptr);
+    if((endptr == str) || (val < 0.0) || (val > 1e9))  return -1;
+    *end = llround(val * 1e9);
+    if(*end <= *start)  return -1;
   }
 
-  fprintf(annotationfile, "Onset,Duration,Annotation\n");
+  if(*endptr != 0)  return -1;
 
-/***************** write data ******************************/
-
-  ascii_path[pathlen-4] = 0;
-  strcat(ascii_path, "_data.txt");
-  outputfile = fopen(ascii_path, "wb");
-  if(outputfile==NULL)
-  {
-    printf("Error, can not open file %s for writing\n", ascii_path);
-    goto OUT_ERROR;
-  }
+  return 0;
+}
 
-  fprintf(outputfile, "Time");
 
-  for(i=0; i<(signals-nr_annot_chns); i++)
-  {
-    fprintf(outputfile, ",%i", i + 1);
-  }
+int main(int argc, char **argv)
+{
+  int c,
+      i,
+      jobs=1,
+      failed;
+
+  FILE *msgfile=stdout;
+
+  struct conv_opts opts;
+
+  struct conv_session session;
+
+  static const struct option long_options[] = {
+    {"precision",      required_argument, NULL, 'p'},
+    {"threads",        required_argument, NULL, 'j'},
+    {"jobs",           required_argument, NULL, 'J'},
+    {"signals",        required_argument, NULL, 's'},
+    {"rate",           required_argument, NULL, 'r'},
+    {"time",           required_argument, NULL, 't'},
+    {"format",         required_argument, NULL, 'f'},
+    {"float32",        no_argument,       NULL, 'F'},
+    {"digital",        no_argument,       NULL, 'G'},
+    {"output",         required_argument, NULL, 'o'},
+    {"header-to",      required_argument, NULL, 'H'},
+    {"signals-to",     required_argument, NULL, 'S'},
+    {"annotations-to", required_argument, NULL, 'A'},
+    {"data-to",        required_argument, NULL, 'D'},
+    {"stats",          optional_argument, NULL, 'T'},
+    {"follow",         optional_argument, NULL, 'W'},
+    {"checkpoint",     required_argument, NULL, 'C'},
+    {"index",          optional_argument, NULL, 'I'},
+    {"pyramid",        no_argument,       NULL, 'Y'},
+    {"annotations-only", no_argument,     NULL, 'N'},
+    {"help",           no_argument,       NULL, 'h'},
+    {NULL, 0, NULL, 0}
+  };
 
-  if(fputc('\n', outputfile)==EOF)
-  {
-    printf("Error when writing to outputfile\n");
-    goto OUT_ERROR;
-  }
 
-  if(fseek(inputfile, (signals + 1) * 256, SEEK_SET))
-  {
-    printf("Error when reading inputfile\n");
-    goto OUT_ERROR;
-  }
 
-/***************** start data conversion ******************************/
+  setlocale(LC_ALL, "C");
 
-  datarecordswritten = 0;
+  conv_opts_init(&opts);
 
-  for(i=0; i<datarecords; i++)
+  while((c = getopt_long(argc, argv, "p:j:J:s:r:t:f:o:h", long_options, NULL)) != -1)
   {
-    for(j=0; j<signals; j++)  edfparam[j].smp_written = 0;
-
-    if(fread(cnv_buf, recordsize * samplesize, 1, inputfile)!=1)
+    switch(c)
     {
-      printf("Error when reading inputfile during conversion\n");
-      goto OUT_ERROR;
-    }
-
-    if(edfplus || bdfplus)
-    {
-      max = edfparam[annot_ch[0]].smp_per_record * samplesize;
-      p = edfparam[annot_ch[0]].buf_offset * samplesize;
-
-/* extract time from datarecord */
-
-      for(k=0; k<max; k++)
-      {
-        if(k>max_tal_ln)
-        {
-          printf("Error, TAL in record %i exceeds my buffer\n", datarecordswritten + 1);
-          goto OUT_ERROR;
-        }
-        scratchpad[k] = cnv_buf[p + k];
-        if(scratchpad[k]==20) break;
-      }
-      scratchpad[k] = 0;
-      elapsedtime = atoll_x(scratchpad, FP_SCALING);
-
-/* process annotations */
-
-      for(r=0; r<nr_annot_chns; r++)
-      {
-        p = edfparam[annot_ch[r]].buf_offset * samplesize;
-        max = edfparam[annot_ch[r]].smp_per_record * samplesize;
-        n = 0;
-        zero = 0;
-        onset = 0;
-        duration = 0;
-        time_in_txt[0] = 0;
-        duration_in_txt[0] = 0;
-        scratchpad[0] = 0;
-
-        for(k=0; k<max; k++)
-        {
-          if(k>max_tal_ln)
-          {
-            printf("Error, TAL in record %i exceeds my buffer\n", datarecordswritten + 1);
-            goto OUT_ERROR;
-          }
-
-          scratchpad[n] = cnv_buf[p + k];
-
-          if(scratchpad[n]==0)
-          {
-            n = 0;
-            onset = 0;
-            duration = 0;
-            time_in_txt[0] = 0;
-            duration_in_txt[0] = 0;
-            scratchpad[0] = 0;
-            zero++;
-            continue;
-          }
-          else  zero = 0;
-
-          if(zero>1)  break;
-
-          if(scratchpad[n]==20)
-          {
-            if(duration)
-            {
-              scratchpad[n] = 0;
-              strcpy(duration_in_txt, scratchpad);
-              n = 0;
-              duration = 0;
-              scratchpad[0] = 0;
-              continue;
-            }
-            else if(onset)
-                 {
-                   scratchpad[n] = 0;
-                   if(n)
-                   {
-                     utf8_to_latin1(scratchpad);
-                     for(m=0; m<n; m++)
-                     {
-                       if(scratchpad[m] == 0)
-                       {
-                         break;
-                       }
-
-                       if((((unsigned char *)scratchpad)[m] < 32) || (((unsigned char *)scratchpad)[m] == ','))
-                       {
-                         scratchpad[m] = '.';
-                       }
-                     }
-                     fprintf(annotationfile, "%s,%s,%s\n", time_in_txt, duration_in_txt, scratchpad);
-                   }
-                   n = 0;
-                   duration = 0;
-                   duration_in_txt[0] = 0;
-                   scratchpad[0] = 0;
-                   continue;
-                 }
-                 else
-                 {
-                   scratchpad[n] = 0;
-                   strcpy(time_in_txt, scratchpad);
-                   n = 0;
-                   onset = 1;
-                   duration = 0;
-                   duration_in_txt[0] = 0;
-                   scratchpad[0] = 0;
-                   continue;
-                 }
-          }
-
-          if(scratchpad[n]==21)
-          {
-            if(!onset)
-            {
-              scratchpad[n] = 0;
-              strcpy(time_in_txt, scratchpad);
-              onset = 1;
-            }
-            n = 0;
-            duration = 1;
-            duration_in_txt[0] = 0;
-            scratchpad[0] = 0;
-            continue;
-          }
-
-          if(++n>max_tal_ln)
-          {
-            printf("Error, TAL in record %i exceeds my buffer\n", datarecordswritten + 1);
-            goto OUT_ERROR;
-          }
-        }
-      }
-    }
-    else elapsedtime = datarecordswritten * data_record_duration;
-
-/* done with timekeeping and annotations, continue with the data */
-
-    do
-    {
-      time_tmp = 100000000000000LL;
-      for(j=0; j<signals; j++)
-      {
-        if(edfplus || bdfplus)
-        {
-          skip = 0;
-
-          for(p=0; p<nr_annot_chns; p++)
-          {
-            if(j==annot_ch[p])
-            {
-              skip = 1;
-              break;
-            }
-          }
-
-          if(skip) continue;
-        }
-
-        d_tmp = edfparam[j].smp_written * edfparam[j].time_step;
-        if(d_tmp<time_tmp) time_tmp = d_tmp;
-      }
-#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
-      __mingw_fprintf(outputfile, "%lli.%09lli", (elapsedtime + time_tmp) / FP_SCALING, (elapsedtime + time_tmp) % FP_SCALING);
-#else
-      fprintf(outputfile, "%lli.%09lli", (elapsedtime + time_tmp) / FP_SCALING, (elapsedtime + time_tmp) % FP_SCALING);
+      case 'p': opts.precision = atoi(optarg);
+                if((opts.precision<0)||(opts.precision>9))
+                {
+                  printf("Error, precision must be in the range 0 to 9\n");
+                  return EXIT_FAILURE;
+                }
+                break;
+      case 'j': opts.threads = atoi(optarg);
+#ifdef _SC_NPROCESSORS_ONLN
+                if(opts.threads<1)
+                {
+                  opts.threads = sysconf(_SC_NPROCESSORS_ONLN);
+                }
 #endif
-      for(j=0; j<signals; j++)
-      {
-        if(edfplus || bdfplus)
-        {
-          skip = 0;
-
-          for(p=0; p<nr_annot_chns; p++)
-          {
-            if(j==annot_ch[p])
-            {
-              skip = 1;
-              break;
-            }
-          }
-
-          if(skip) continue;
-        }
-
-        d_tmp = edfparam[j].smp_written * edfparam[j].time_step;
-
-        if((d_tmp == time_tmp) && (edfparam[j].smp_written<edfparam[j].smp_per_record))
-        {
-          if(edf)
-          {
-            value_tmp = ((*(((signed short *)cnv_buf)+edfparam[j].buf_offset+edfparam[j].smp_written)) + edfparam[j].offset) * edfparam[j].sense;
-          }
-
-          if(bdf)
-          {
-            var.two[0] = *((unsigned short *)(cnv_buf + ((edfparam[j].buf_offset + edfparam[j].smp_written) * 3)));
-            var.four[2] = *(cnv_buf + ((edfparam[j].buf_offset + edfparam[j].smp_written) * 3) + 2);
-
-            if(var.four[2]&0x80)
-            {
-              var.four[3] = 0xff;
-            }
-            else
-            {
-              var.four[3] = 0x00;
-            }
-
-            value_tmp = (var.one_signed + edfparam[j].offset) * edfparam[j].sense;
-          }
-
-          fprintf(outputfile, ",%f", value_tmp);
-          edfparam[j].smp_written++;
-        }
-        else fputc(',', outputfile);
-      }
-
-      if(fputc('\n', outputfile)==EOF)
-      {
-        printf("Error when writing to outputfile during conversion\n");
-        goto OUT_ERROR;
-      }
-
-      recordfull = 1;
-      for(j=0; j<signals; j++)
-      {
-        if(edfparam[j].smp_written<edfparam[j].smp_per_record)
-        {
-          if(edfplus || bdfplus)
-          {
-            skip = 0;
-
-            for(p=0; p<nr_annot_chns; p++)
-            {
-              if(j==annot_ch[p])
-              {
-                skip = 1;
+                if(opts.threads<1)  opts.threads = 1;
+                if(opts.threads>256)  opts.threads = 256;
                 break;
-              }
-            }
-
-            if(skip) continue;
-          }
-
-          recordfull = 0;
-          break;
-        }
-      }
+      case 'J': jobs = atoi(optarg);
+#ifdef _SC_NPROCESSORS_ONLN
+                if(jobs<1)
+                {
+                  jobs = sysconf(_SC_NPROCESSORS_ONLN);
+                }
+#endif
+                if(jobs<1)  jobs = 1;
+                if(jobs>256)  jobs = 256;
+                break;
+      case 'f': if(!strcmp(optarg, "txt"))
+                {
+                  opts.format = CONV_FORMAT_TXT;
+                }
+                else if(!strcmp(optarg, "npy"))
+                  {
+                    opts.format = CONV_FORMAT_NPY;
+                  }
+                  else if(!strcmp(optarg, "groups"))
+                    {
+                      opts.format = CONV_FORMAT_GROUPS;
+                    }
+                    else
+                    {
+                      printf("Error, the format must be txt, npy or groups\n");
+                      return EXIT_FAILURE;
+                    }
+                break;
+      case 'F': opts.float32 = 1;
+                break;
+      case 'G': opts.digital = 1;
+                break;
+      case 's': opts.signal_list = optarg;
+                break;
+      case 'r': opts.rate_list = optarg;
+                break;
+      case 'o': opts.output_base = optarg;
+                break;
+      case 'H': opts.dest[CONV_OUT_HEADER] = optarg;
+                break;
+      case 'S': opts.dest[CONV_OUT_SIGNALS] = optarg;
+                break;
+      case 'A': opts.dest[CONV_OUT_ANNOTATIONS] = optarg;
+                break;
+      case 'D': opts.dest[CONV_OUT_DATA] = optarg;
+                break;
+      case 'T': if((optarg == NULL) || (!strcmp(optarg, "text")))
+                {
+                  opts.stats = CONV_STATS_TEXT;
+                }
+                else if(!strcmp(optarg, "json"))
+                  {
+                    opts.stats = CONV_STATS_JSON;
+                  }
+                  else
+                  {
+                    printf("Error, the stats format must be text or json\n");
+                    return EXIT_FAILURE;
+                  }
+                break;
+      case 'W': opts.follow = 1;
+                if(optarg != NULL)
+                {
+                  opts.follow_idle = atof(optarg);
+                  if(opts.follow_idle <= 0.0)
+                  {
+                    printf("Error, the idle time of --follow must be a number of seconds\n");
+                    return EXIT_FAILURE;
+                  }
+                }
+                break;
+      case 'C': opts.checkpoint = optarg;
+                break;
+      case 'Y': opts.pyramid = 1;
+                break;
+      case 'N': opts.annotations_only = 1;
+                break;
+      case 'I': opts.index = 1;
+                opts.index_path = optarg;
+                break;
+      case 't': if(parse_time_window(optarg, &opts.start_time, &opts.end_time))
+                {
+                  printf("Error, the time window must have the form START[,END] in seconds\n");
+                  return EXIT_FAILURE;
+                }
+                break;
+      default : usage();
+                return EXIT_FAILURE;
     }
-    while(!recordfull);
-
-    datarecordswritten++;
-  }
-
-  if(inputfile != NULL)
-  {
-    fclose(inputfile);
-  }
-  if(annotationfile != NULL)
-  {
-    fclose(annotationfile);
-  }
-  if(outputfile != NULL)
-  {
-    fclose(outputfile);
-  }
-  free(edf_hdr);
-  free(edfparam);
-  free(cnv_buf);
-  free(time_in_txt);
-  free(duration_in_txt);
-  free(scratchpad);
-
-  return EXIT_SUCCESS;
-
-OUT_ERROR:
-
-  if(inputfile != NULL)
-  {
-    fclose(inputfile);
-  }
-  if(annotationfile != NULL)
-  {
-    fclose(annotationfile);
-  }
-  if(outputfile != NULL)
-  {
-    fclose(outputfile);
   }
-  free(edf_hdr);
-  free(edfparam);
-  free(cnv_buf);
-  free(time_in_txt);
-  free(duration_in_txt);
-  free(scratchpad);
-
-  return EXIT_FAILURE;
-}
-
 
-
-void utf8_to_latin1(char *utf8_str)
-{
-  int i, j, len;
-
-  unsigned char *str;
-
-
-  str = (unsigned char *)utf8_str;
-
-  len = strlen(utf8_str);
-
-  if(!len)
+  if(optind>=argc)
   {
-    return;
+    usage();
+    return EXIT_FAILURE;
   }
 
-  j = 0;
-
-  for(i=0; i<len; i++)
+  if((optind==(argc-1)) && (!batch_is_list(argv[optind])))
   {
-    if((str[i] < 32) || ((str[i] > 127) && (str[i] < 192)))
+    /* keep the messages out of the exported data */
+    if(!strcmp(argv[optind], "-"))  msgfile = stderr;
+    for(i=0; i<CONV_OUTPUTS; i++)
     {
-      str[j++] = '.';
-
-      continue;
+      if((opts.dest[i] != NULL) && (!strcmp(opts.dest[i], "-")))  msgfile = stderr;
     }
 
-    if(str[i] > 223)
-    {
-      str[j++] = 0;
+    conv_session_init(&session);
 
-      return;  /* can only decode Latin-1 ! */
-    }
+    failed = convert_file(&session, argv[optind], &opts);
 
-    if((str[i] & 224) == 192)  /* found a two-byte sequence containing Latin-1, Greek, Cyrillic, Coptic, Armenian, Hebrew, etc. characters */
+    if(opts.stats)
     {
-      if((i + 1) == len)
-      {
-        str[j++] = 0;
-
-        return;
-      }
-
-      if((str[i] & 252) != 192) /* it's not a Latin-1 character */
-      {
-        str[j++] = '.';
-
-        i++;
-
-        continue;
-      }
-
-      if((str[i + 1] & 192) != 128) /* UTF-8 violation error */
-      {
-        str[j++] = 0;
-
-        return;
-      }
-
-      str[j] = str[i] << 6;
-      str[j] += (str[i + 1] & 63);
-
-      i++;
-      j++;
+      conv_stats_print(stderr, argv[optind], &session.stats, opts.stats);
+    }
 
-      continue;
+    if(failed)
+    {
+      fprintf(msgfile, "%s\n", session.errmsg);
+      conv_session_free(&session);
+      return EXIT_FAILURE;
     }
 
-    str[j++] = str[i];
-  }
+    conv_session_free(&session);
 
-  if(j<len)
-  {
-    str[j] = 0;
+    return EXIT_SUCCESS;
   }
-}
-
-
-long long atoll_x(const char *str, int dimension)
-{
-  int i,
-      radix,
-      negative=0;
 
-  long long value=0LL;
-
-  while(*str==' ')
+  if(opts.output_base != NULL)
   {
-    str++;
+    printf("Error, --output can not be used with more than one file\n");
+    return EXIT_FAILURE;
   }
-
-  if(*str=='-')
+  if(opts.follow || (opts.checkpoint != NULL))
   {
-    negative = 1;
-    str++;
+    printf("Error, --follow and --checkpoint can not be used with more than one file\n");
+    return EXIT_FAILURE;
   }
-  else
+  if(opts.index_path != NULL)
   {
-    if(*str=='+')
-    {
-      str++;
-    }
+    printf("Error, --index=FILE can not be used with more than one file, --index names the index after each file\n");
+    return EXIT_FAILURE;
   }
-
-  for(i=0; ; i++)
+  for(i=0; i<CONV_OUTPUTS; i++)
   {
-    if(str[i]=='.')
-    {
-      str += (i + 1);
-
-      break;
-    }
-
-    if((str[i]<'0') || (str[i]>'9'))
+    if(opts.dest[i] != NULL)
     {
-      if(negative)
-      {
-        return value * dimension * -1LL;
-      }
-      else
-      {
-        return value * dimension;
-      }
+      printf("Error, --header-to, --signals-to, --annotations-to and --data-to can not be used with more than one file\n");
+      return EXIT_FAILURE;
     }
-
-    value *= 10LL;
-
-    value += str[i] - '0';
   }
 
-  radix = 1;
-
-  for(i=0; radix<dimension; i++)
+  failed = convert_batch(argv + optind, argc - optind, &opts, jobs);
+  if(failed)
   {
-    if((str[i]<'0') || (str[i]>'9'))
-    {
-      break;
-    }
-
-    radix *= 10;
-
-    value *= 10LL;
-
-    value += str[i] - '0';
+    return EXIT_FAILURE;
   }
 
-  if(negative)
-  {
-    return value * (dimension / radix) * -1LL;
-  }
-  else
-  {
-    return value * (dimension / radix);
-  }
+  return EXIT_SUCCESS;
 }
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
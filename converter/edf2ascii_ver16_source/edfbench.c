@@ -0,0 +1,227 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+/*
+ * Times the conversion of EDF/BDF files in every output mode and reports the
+ * throughput in MB/s (of the input file) and datarecords/s. The conversion runs
+ * in-process through convert_file(), the best of several runs is reported so
+ * the numbers are not dominated by a cold page cache.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <time.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "edfread.h"
+#include "convert.h"
+
+
+struct bench_mode{
+         const char *name;
+         int format;
+         int threads;               /* 0 uses all CPUs */
+         int float32;
+         const char *signal_list;
+       };
+
+
+static const struct bench_mode modes[]={
+  {"txt",           CONV_FORMAT_TXT, 1, 0, NULL},
+  {"txt -j 0",      CONV_FORMAT_TXT, 0, 0, NULL},
+  {"txt -s 1",      CONV_FORMAT_TXT, 1, 0, "1"},
+  {"npy",           CONV_FORMAT_NPY, 1, 0, NULL},
+  {"npy --float32", CONV_FORMAT_NPY, 1, 1, NULL}
+};
+
+
+static void usage(void)
+{
+  printf("\nedf2ascii benchmark\n"
+         "Usage: edfbench [options] <file> ...\n\n"
+         "  -r, --repeat=N      convert every file N times per mode, the fastest run counts (default 3)\n"
+         "  -o, --output=DIR    directory for the output files (default: next to the input file)\n\n");
+}
+
+
+static double now(void)
+{
+  struct timespec ts;
+
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+int main(int argc, char **argv)
+{
+  int c,
+      i,
+      m,
+      r,
+      repeat=3,
+      cpus=1,
+      datarecords;
+
+  long long filesize;
+
+  double t,
+         best;
+
+  char base[2048],
+       errmsg[256];
+
+  const char *outdir=NULL,
+             *name;
+
+  struct stat st;
+
+  struct edfrd_file *hdl;
+
+  struct conv_opts opts;
+
+  struct conv_session session;
+
+  static const struct option long_options[] = {
+    {"repeat", required_argument, NULL, 'r'},
+    {"output", required_argument, NULL, 'o'},
+    {"help",   no_argument,       NULL, 'h'},
+    {NULL, 0, NULL, 0}
+  };
+
+
+
+  setlocale(LC_ALL, "C");
+
+  while((c = getopt_long(argc, argv, "r:o:h", long_options, NULL)) != -1)
+  {
+    switch(c)
+    {
+      case 'r': repeat = atoi(optarg);
+                if(repeat<1)  repeat = 1;
+                break;
+      case 'o': outdir = optarg;
+                break;
+      default : usage();
+                return EXIT_FAILURE;
+    }
+  }
+
+  if(optind>=argc)
+  {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+#ifdef _SC_NPROCESSORS_ONLN
+  cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if(cpus<1)  cpus = 1;
+#endif
+
+  conv_session_init(&session);
+
+  printf("%-28s %-14s %10s %12s %10s\n", "file", "mode", "MB/s", "records/s", "seconds");
+
+  for(i=optind; i<argc; i++)
+  {
+    hdl = edfrd_open(argv[i], errmsg, 256);
+    if(hdl == NULL)
+    {
+      printf("%s\n", errmsg);
+      continue;
+    }
+    datarecords = edfrd_header(hdl)->datarecords;
+    edfrd_close(hdl);
+
+    if(stat(argv[i], &st))
+    {
+      printf("Error, can not stat file %s\n", argv[i]);
+      continue;
+    }
+    filesize = st.st_size;
+
+    name = strrchr(argv[i], '/');
+    name = (name == NULL) ? argv[i] : (name + 1);
+
+    /* the outputs of all modes overwrite each other */
+    if(outdir != NULL)
+    {
+      snprintf(base, 2048, "%s/%.*s_bench", outdir, (int)strlen(name) - 4, name);
+    }
+    else
+    {
+      snprintf(base, 2048, "%.*s_bench", (int)strlen(argv[i]) - 4, argv[i]);
+    }
+
+    for(m=0; m<(int)(sizeof(modes) / sizeof(modes[0])); m++)
+    {
+      conv_opts_init(&opts);
+      opts.format = modes[m].format;
+      opts.threads = modes[m].threads ? modes[m].threads : cpus;
+      opts.float32 = modes[m].float32;
+      opts.signal_list = modes[m].signal_list;
+      opts.output_base = base;
+
+      best = -1.0;
+
+      for(r=0; r<repeat; r++)
+      {
+        t = now();
+
+        if(convert_file(&session, argv[i], &opts))
+        {
+          printf("%s\n", session.errmsg);
+          break;
+        }
+
+        t = now() - t;
+
+        if((best < 0.0) || (t < best))  best = t;
+      }
+
+      if(r < repeat)  continue;
+
+      if(best < 1e-9)  best = 1e-9;
+
+      printf("%-28.28s %-14s %10.1f %12.0f %10.4f\n", name, modes[m].name,
+             filesize / best / 1e6, datarecords / best, best);
+    }
+  }
+
+  conv_session_free(&session);
+
+  return EXIT_SUCCESS;
+}
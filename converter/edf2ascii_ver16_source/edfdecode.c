@@ -0,0 +1,415 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+/*
+ * Sample decoding kernels: little-endian int16 (EDF) and int24 (BDF) to
+ * physical values, (digital + offset) * sense.
+ *
+ * On x86 an SSE2 or AVX2 version is selected at runtime. All versions do
+ * the same double precision operations in the same order, so the results
+ * are bit-identical whichever kernel is used.
+ */
+
+
+#include <string.h>
+
+#include "edfread.h"
+
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define EDFRD_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+
+#define EDFRD_SIMD_NONE   (0)
+#define EDFRD_SIMD_SSE2   (1)
+#define EDFRD_SIMD_AVX2   (2)
+
+
+static inline int edfrd_dig16(const unsigned char *p)
+{
+  return (signed short)(p[0] | (p[1] << 8));
+}
+
+
+static inline int edfrd_dig24(const unsigned char *p)
+{
+  return ((signed int)((p[0] << 8) | (p[1] << 16) | ((unsigned int)p[2] << 24))) >> 8;
+}
+
+
+static void decode_i16_f64_scalar(const unsigned char *p, int n, double offset, double sense, double *buf)
+{
+  int i;
+
+  for(i=0; i<n; i++, p+=2)
+  {
+    buf[i] = (edfrd_dig16(p) + offset) * sense;
+  }
+}
+
+
+static void decode_i24_f64_scalar(const unsigned char *p, int n, double offset, double sense, double *buf)
+{
+  int i;
+
+  for(i=0; i<n; i++, p+=3)
+  {
+    buf[i] = (edfrd_dig24(p) + offset) * sense;
+  }
+}
+
+
+static void decode_i16_f32_scalar(const unsigned char *p, int n, double offset, double sense, float *buf)
+{
+  int i;
+
+  for(i=0; i<n; i++, p+=2)
+  {
+    buf[i] = (edfrd_dig16(p) + offset) * sense;
+  }
+}
+
+
+static void decode_i24_f32_scalar(const unsigned char *p, int n, double offset, double sense, float *buf)
+{
+  int i;
+
+  for(i=0; i<n; i++, p+=3)
+  {
+    buf[i] = (edfrd_dig24(p) + offset) * sense;
+  }
+}
+
+
+#ifdef EDFRD_HAVE_X86_SIMD
+
+/* SSE2 has no byte shuffle, so 24-bit samples are gathered with 32-bit loads */
+/* and shifted, only the conversion and scaling is vectorized */
+
+__attribute__((target("sse2")))
+static void decode_i16_f64_sse2(const unsigned char *p, int n, double offset, double sense, double *buf)
+{
+  int i;
+
+  __m128i v, lo, hi;
+
+  __m128d voff, vsense;
+
+
+  voff = _mm_set1_pd(offset);
+  vsense = _mm_set1_pd(sense);
+
+  for(i=0; (i+8)<=n; i+=8, p+=16)
+  {
+    v = _mm_loadu_si128((const __m128i *)p);
+    lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    _mm_storeu_pd(buf + i,     _mm_mul_pd(_mm_add_pd(_mm_cvtepi32_pd(lo), voff), vsense));
+    _mm_storeu_pd(buf + i + 2, _mm_mul_pd(_mm_add_pd(_mm_cvtepi32_pd(_mm_srli_si128(lo, 8)), voff), vsense));
+    _mm_storeu_pd(buf + i + 4, _mm_mul_pd(_mm_add_pd(_mm_cvtepi32_pd(hi), voff), vsense));
+    _mm_storeu_pd(buf + i + 6, _mm_mul_pd(_mm_add_pd(_mm_cvtepi32_pd(_mm_srli_si128(hi, 8)), voff), vsense));
+  }
+
+  decode_i16_f64_scalar(p, n - i, offset, sense, buf + i);
+}
+
+
+__attribute__((target("sse2")))
+static void decode_i24_f64_sse2(const unsigned char *p, int n, double offset, double sense, double *buf)
+{
+  int i;
+
+  unsigned int w[4];
+
+  __m128i v;
+
+  __m128d voff, vsense;
+
+
+  voff = _mm_set1_pd(offset);
+  vsense = _mm_set1_pd(sense);
+
+  /* the 32-bit load of the last sample of a group reads one byte beyond it */
+  for(i=0; (i+5)<=n; i+=4, p+=12)
+  {
+    memcpy(w,     p,     4);
+    memcpy(w + 1, p + 3, 4);
+    memcpy(w + 2, p + 6, 4);
+    memcpy(w + 3, p + 9, 4);
+    v = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128((const __m128i *)w), 8), 8);
+    _mm_storeu_pd(buf + i,     _mm_mul_pd(_mm_add_pd(_mm_cvtepi32_pd(v), voff), vsense));
+    _mm_storeu_pd(buf + i + 2, _mm_mul_pd(_mm_add_pd(_mm_cvtepi32_pd(_mm_srli_si128(v, 8)), voff), vsense));
+  }
+
+  decode_i24_f64_scalar(p, n - i, offset, sense, buf + i);
+}
+
+
+__attribute__((target("avx2")))
+static void decode_i16_f64_avx2(const unsigned char *p, int n, double offset, double sense, double *buf)
+{
+  int i;
+
+  __m256i v;
+
+  __m256d voff, vsense;
+
+
+  voff = _mm256_set1_pd(offset);
+  vsense = _mm256_set1_pd(sense);
+
+  for(i=0; (i+8)<=n; i+=8, p+=16)
+  {
+    v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)p));
+    _mm256_storeu_pd(buf + i,     _mm256_mul_pd(_mm256_add_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), voff), vsense));
+    _mm256_storeu_pd(buf + i + 4, _mm256_mul_pd(_mm256_add_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), voff), vsense));
+  }
+
+  decode_i16_f64_scalar(p, n - i, offset, sense, buf + i);
+}
+
+
+/* moves every 3-byte sample into the upper three bytes of a 32-bit lane */
+__attribute__((target("avx2")))
+static inline __m256i edfrd_load_i24x8_avx2(const unsigned char *p)
+{
+  __m256i v, mask;
+
+  mask = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                          -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+
+  v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+                              _mm_loadu_si128((const __m128i *)(p + 12)), 1);
+
+  return _mm256_srai_epi32(_mm256_shuffle_epi8(v, mask), 8);
+}
+
+
+__attribute__((target("avx2")))
+static void decode_i24_f64_avx2(const unsigned char *p, int n, double offset, double sense, double *buf)
+{
+  int i;
+
+  __m256i v;
+
+  __m256d voff, vsense;
+
+
+  voff = _mm256_set1_pd(offset);
+  vsense = _mm256_set1_pd(sense);
+
+  /* the second 16-byte load ends 4 bytes beyond the 8th sample */
+  for(i=0; (i+10)<=n; i+=8, p+=24)
+  {
+    v = edfrd_load_i24x8_avx2(p);
+    _mm256_storeu_pd(buf + i,     _mm256_mul_pd(_mm256_add_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), voff), vsense));
+    _mm256_storeu_pd(buf + i + 4, _mm256_mul_pd(_mm256_add_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), voff), vsense));
+  }
+
+  decode_i24_f64_scalar(p, n - i, offset, sense, buf + i);
+}
+
+
+__attribute__((target("avx2")))
+static void decode_i16_f32_avx2(const unsigned char *p, int n, double offset, double sense, float *buf)
+{
+  int i;
+
+  __m256i v;
+
+  __m256d voff, vsense;
+
+
+  voff = _mm256_set1_pd(offset);
+  vsense = _mm256_set1_pd(sense);
+
+  for(i=0; (i+8)<=n; i+=8, p+=16)
+  {
+    v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)p));
+    _mm_storeu_ps(buf + i,     _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_add_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), voff), vsense)));
+    _mm_storeu_ps(buf + i + 4, _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_add_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), voff), vsense)));
+  }
+
+  decode_i16_f32_scalar(p, n - i, offset, sense, buf + i);
+}
+
+
+__attribute__((target("avx2")))
+static void decode_i24_f32_avx2(const unsigned char *p, int n, double offset, double sense, float *buf)
+{
+  int i;
+
+  __m256i v;
+
+  __m256d voff, vsense;
+
+
+  voff = _mm256_set1_pd(offset);
+  vsense = _mm256_set1_pd(sense);
+
+  for(i=0; (i+10)<=n; i+=8, p+=24)
+  {
+    v = edfrd_load_i24x8_avx2(p);
+    _mm_storeu_ps(buf + i,     _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_add_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), voff), vsense)));
+    _mm_storeu_ps(buf + i + 4, _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_add_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), voff), vsense)));
+  }
+
+  decode_i24_f32_scalar(p, n - i, offset, sense, buf + i);
+}
+
+#endif
+
+
+static int edfrd_simd_level(void)
+{
+#ifdef EDFRD_HAVE_X86_SIMD
+  if(__builtin_cpu_supports("avx2"))  return EDFRD_SIMD_AVX2;
+
+  if(__builtin_cpu_supports("sse2"))  return EDFRD_SIMD_SSE2;
+#endif
+  return EDFRD_SIMD_NONE;
+}
+
+
+void edfrd_decode_samples(const char *src, int samplesize, int n, double offset, double sense, double *buf)
+{
+  const unsigned char *p;
+
+  p = (const unsigned char *)src;
+
+  switch(edfrd_simd_level())
+  {
+#ifdef EDFRD_HAVE_X86_SIMD
+    case EDFRD_SIMD_AVX2 : if(samplesize == 2)  decode_i16_f64_avx2(p, n, offset, sense, buf);
+                           else  decode_i24_f64_avx2(p, n, offset, sense, buf);
+                           break;
+    case EDFRD_SIMD_SSE2 : if(samplesize == 2)  decode_i16_f64_sse2(p, n, offset, sense, buf);
+                           else  decode_i24_f64_sse2(p, n, offset, sense, buf);
+                           break;
+#endif
+    default              : if(samplesize == 2)  decode_i16_f64_scalar(p, n, offset, sense, buf);
+                           else  decode_i24_f64_scalar(p, n, offset, sense, buf);
+                           break;
+  }
+}
+
+
+void edfrd_decode_samples_f(const char *src, int samplesize, int n, double offset, double sense, float *buf)
+{
+  const unsigned char *p;
+
+  p = (const unsigned char *)src;
+
+  switch(edfrd_simd_level())
+  {
+#ifdef EDFRD_HAVE_X86_SIMD
+    case EDFRD_SIMD_AVX2 : if(samplesize == 2)  decode_i16_f32_avx2(p, n, offset, sense, buf);
+                           else  decode_i24_f32_avx2(p, n, offset, sense, buf);
+                           break;
+#endif
+    default              : if(samplesize == 2)  decode_i16_f32_scalar(p, n, offset, sense, buf);
+                           else  decode_i24_f32_scalar(p, n, offset, sense, buf);
+                           break;
+  }
+}
+
+
+void edfrd_decode_physical(const struct edfrd_hdr *hdr, const char *rec, int signal, double *buf)
+{
+  const struct edfrd_param *param;
+
+  param = hdr->param + signal;
+
+  edfrd_decode_samples(rec + param->buf_offset * hdr->samplesize, hdr->samplesize,
+                       param->smp_per_record, param->offset, param->sense, buf);
+}
+
+
+void edfrd_decode_physical_f(const struct edfrd_hdr *hdr, const char *rec, int signal, float *buf)
+{
+  const struct edfrd_param *param;
+
+  param = hdr->param + signal;
+
+  edfrd_decode_samples_f(rec + param->buf_offset * hdr->samplesize, hdr->samplesize,
+                         param->smp_per_record, param->offset, param->sense, buf);
+}
+
+
+void edfrd_decode_digital(const struct edfrd_hdr *hdr, const char *rec, int signal, int *buf)
+{
+  int i, n;
+
+  const unsigned char *p;
+
+
+  n = hdr->param[signal].smp_per_record;
+  p = (const unsigned char *)rec + hdr->param[signal].buf_offset * hdr->samplesize;
+
+  if(hdr->samplesize == 2)
+  {
+    for(i=0; i<n; i++, p+=2)
+    {
+      buf[i] = edfrd_dig16(p);
+    }
+  }
+  else
+  {
+    for(i=0; i<n; i++, p+=3)
+    {
+      buf[i] = edfrd_dig24(p);
+    }
+  }
+}
+
+
+void edfrd_decode_digital16(const struct edfrd_hdr *hdr, const char *rec, int signal, short *buf)
+{
+  int i, n;
+
+  const unsigned char *p;
+
+  const unsigned short one=1;
+
+
+  n = hdr->param[signal].smp_per_record;
+  p = (const unsigned char *)rec + hdr->param[signal].buf_offset * 2;
+
+  /* the samples in the file already are little-endian int16 */
+  if(*(const unsigned char *)&one)
+  {
+    memcpy(buf, p, n * 2);
+
+    return;
+  }
+
+  for(i=0; i<n; i++, p+=2)
+  {
+    buf[i] = edfrd_dig16(p);
+  }
+}
@@ -0,0 +1,433 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+/*
+ * Writes synthetic EDF, EDF+, BDF and BDF+ files (also EDF+D/BDF+D with gaps)
+ * for testing and benchmarking edf2ascii and libedfread. The signal count, the
+ * samples per datarecord of each signal, the number of datarecords and the
+ * number of annotations per datarecord can be chosen, the content only depends
+ * on the options and the seed, so the same command writes the same file.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <locale.h>
+
+
+struct gen_opts{
+         int bdf;
+         int plus;
+         int discontinuous;
+         int signals;
+         int rates[256];
+         int nr_rates;
+         long long datarecords;
+         int duration_ms;
+         int annotations;
+         int annot_spr;
+         int gap_every;
+         unsigned int seed;
+       };
+
+
+static void usage(void)
+{
+  printf("\nSynthetic EDF(+)/BDF(+) generator\n"
+         "Usage: edfgen [options] <outputfile>\n\n"
+         "  -t, --type=TYPE        edf, edf+, bdf or bdf+ (default edf)\n"
+         "  -D, --discontinuous    write an EDF+D/BDF+D file with gaps\n"
+         "  -s, --signals=N        number of data signals (default 8)\n"
+         "  -r, --rates=LIST       comma-separated samples per record, cycled\n"
+         "                         over the signals (default 256)\n"
+         "  -n, --records=N        number of datarecords (default 60)\n"
+         "  -d, --duration=MS      datarecord duration in milliseconds (default 1000)\n"
+         "  -a, --annotations=N    annotations per datarecord (+ types only, default 1)\n"
+         "  -g, --gap-every=N      with -D, insert a gap every N records (default 10)\n"
+         "  -S, --seed=N           seed for the pseudo-random signal content\n\n");
+}
+
+
+static void put_field(char *dest, int len, const char *src)
+{
+  int n;
+
+  n = strlen(src);
+  if(n > len)  n = len;
+  memset(dest, ' ', len);
+  memcpy(dest, src, n);
+}
+
+
+static void put_num(char *dest, int len, long long val)
+{
+  char str[32];
+
+  snprintf(str, 32, "%lli", val);
+  put_field(dest, len, str);
+}
+
+
+static unsigned int lcg_next(unsigned int *state)
+{
+  *state = *state * 1664525u + 1013904223u;
+
+  return *state >> 8;
+}
+
+
+static int write_tal(char *buf, int bufsize, long long rec, const struct gen_opts *opt, unsigned int *state, long long onset_ms)
+{
+  int i, n, len;
+
+  long long t;
+
+  char str[128];
+
+
+  memset(buf, 0, bufsize);
+
+  n = snprintf(buf, bufsize, "+%lli.%03lli\x14\x14", onset_ms / 1000, onset_ms % 1000);
+  n++;  /* terminating zero of the timekeeping TAL */
+
+  for(i=0; i<opt->annotations; i++)
+  {
+    t = onset_ms + (long long)(i * opt->duration_ms) / opt->annotations;
+
+    if(lcg_next(state) & 1)
+    {
+      len = snprintf(str, 128, "+%lli.%03lli\x15%i.%i\x14stim %lli-%i\x14",
+                     t / 1000, t % 1000, (int)(lcg_next(state) % 5), (int)(lcg_next(state) % 10), rec, i);
+    }
+    else
+    {
+      len = snprintf(str, 128, "+%lli.%03lli\x14trial %lli\x14marker %i\x14",
+                     t / 1000, t % 1000, rec, i);
+    }
+
+    if(n + len + 2 > bufsize)  break;
+
+    memcpy(buf + n, str, len);
+    n += len + 1;
+  }
+
+  return n;
+}
+
+
+int main(int argc, char **argv)
+{
+  FILE *outputfile=NULL;
+
+  int i, j, c,
+      spr,
+      val,
+      signals,
+      samplesize,
+      hdrsize,
+      recordsize,
+      dig_min,
+      dig_max,
+      *phase=NULL;
+
+  long long r,
+            onset_ms;
+
+  char *hdr=NULL,
+       *buf=NULL,
+       *p,
+       str[128];
+
+  unsigned int state;
+
+  struct gen_opts opt;
+
+  static const struct option long_options[] = {
+    {"type",          required_argument, NULL, 't'},
+    {"discontinuous", no_argument,       NULL, 'D'},
+    {"signals",       required_argument, NULL, 's'},
+    {"rates",         required_argument, NULL, 'r'},
+    {"records",       required_argument, NULL, 'n'},
+    {"duration",      required_argument, NULL, 'd'},
+    {"annotations",   required_argument, NULL, 'a'},
+    {"gap-every",     required_argument, NULL, 'g'},
+    {"seed",          required_argument, NULL, 'S'},
+    {"help",          no_argument,       NULL, 'h'},
+    {NULL, 0, NULL, 0}
+  };
+
+
+
+  setlocale(LC_ALL, "C");
+
+  memset(&opt, 0, sizeof(struct gen_opts));
+  opt.signals = 8;
+  opt.rates[0] = 256;
+  opt.nr_rates = 1;
+  opt.datarecords = 60;
+  opt.duration_ms = 1000;
+  opt.annotations = 1;
+  opt.gap_every = 10;
+  opt.seed = 1;
+
+  while((c = getopt_long(argc, argv, "t:Ds:r:n:d:a:g:S:h", long_options, NULL)) != -1)
+  {
+    switch(c)
+    {
+      case 't': if(!strcmp(optarg, "edf"))   { opt.bdf = 0; opt.plus = 0; }
+                else if(!strcmp(optarg, "edf+"))  { opt.bdf = 0; opt.plus = 1; }
+                else if(!strcmp(optarg, "bdf"))   { opt.bdf = 1; opt.plus = 0; }
+                else if(!strcmp(optarg, "bdf+"))  { opt.bdf = 1; opt.plus = 1; }
+                else
+                {
+                  printf("Error, unknown type \"%s\"\n", optarg);
+                  return EXIT_FAILURE;
+                }
+                break;
+      case 'D': opt.discontinuous = 1;
+                break;
+      case 's': opt.signals = atoi(optarg);
+                break;
+      case 'r': opt.nr_rates = 0;
+                for(p=strtok(optarg, ","); (p!=NULL)&&(opt.nr_rates<256); p=strtok(NULL, ","))
+                {
+                  opt.rates[opt.nr_rates++] = atoi(p);
+                }
+                break;
+      case 'n': opt.datarecords = atoll(optarg);
+                break;
+      case 'd': opt.duration_ms = atoi(optarg);
+                break;
+      case 'a': opt.annotations = atoi(optarg);
+                break;
+      case 'g': opt.gap_every = atoi(optarg);
+                break;
+      case 'S': opt.seed = strtoul(optarg, NULL, 10);
+                break;
+      default : usage();
+                return EXIT_FAILURE;
+    }
+  }
+
+  if(optind != (argc - 1))
+  {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  if(opt.discontinuous)  opt.plus = 1;
+
+  if((opt.signals<1)||(opt.signals>(opt.plus ? 255 : 256))||(opt.datarecords<1)||(opt.duration_ms<1)||(opt.annotations<0)||(opt.gap_every<1))
+  {
+    printf("Error, invalid parameters\n");
+    return EXIT_FAILURE;
+  }
+
+  for(i=0; i<opt.nr_rates; i++)
+  {
+    if((opt.rates[i]<1)||(opt.rates[i]>1000000))
+    {
+      printf("Error, invalid samples per record %i\n", opt.rates[i]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  samplesize = opt.bdf ? 3 : 2;
+
+  signals = opt.signals + opt.plus;
+
+  opt.annot_spr = 0;
+  if(opt.plus)
+  {
+    opt.annot_spr = (32 + opt.annotations * 40 + samplesize - 1) / samplesize;
+  }
+
+  hdrsize = (signals + 1) * 256;
+
+  hdr = (char *)malloc(hdrsize);
+  phase = (int *)calloc(signals, sizeof(int));
+  if((hdr==NULL)||(phase==NULL))
+  {
+    printf("Malloc error! (hdr)\n");
+    goto OUT_ERROR;
+  }
+
+  memset(hdr, ' ', hdrsize);
+
+  if(opt.bdf)
+  {
+    hdr[0] = (char)0xff;
+    memcpy(hdr + 1, "BIOSEMI", 7);
+  }
+  else
+  {
+    put_field(hdr, 8, "0");
+  }
+
+  put_field(hdr + 8, 80, opt.plus ? "X X X X" : "synthetic patient");
+  put_field(hdr + 88, 80, opt.plus ? "Startdate 01-JAN-2021 X X edfgen" : "synthetic recording");
+  put_field(hdr + 168, 8, "01.01.21");
+  put_field(hdr + 176, 8, "12.00.00");
+  put_num(hdr + 184, 8, hdrsize);
+  if(opt.plus)
+  {
+    snprintf(str, 128, "%s+%c", opt.bdf ? "BDF" : "EDF", opt.discontinuous ? 'D' : 'C');
+    put_field(hdr + 192, 44, str);
+  }
+  else if(opt.bdf)
+  {
+    put_field(hdr + 192, 44, "24BIT");
+  }
+  put_num(hdr + 236, 8, opt.datarecords);
+  snprintf(str, 128, "%i.%03i", opt.duration_ms / 1000, opt.duration_ms % 1000);
+  put_field(hdr + 244, 8, str);
+  put_num(hdr + 252, 4, signals);
+
+  dig_min = opt.bdf ? -8388608 : -32768;
+  dig_max = opt.bdf ?  8388607 :  32767;
+
+  recordsize = 0;
+
+  for(i=0; i<signals; i++)
+  {
+    if(i == opt.signals)
+    {
+      put_field(hdr + 256 + i * 16, 16, opt.bdf ? "BDF Annotations" : "EDF Annotations");
+      spr = opt.annot_spr;
+      put_num(hdr + 256 + signals * 104 + i * 8, 8, -1);
+      put_num(hdr + 256 + signals * 112 + i * 8, 8, 1);
+    }
+    else
+    {
+      snprintf(str, 128, "sig%i", i + 1);
+      put_field(hdr + 256 + i * 16, 16, str);
+      put_field(hdr + 256 + signals * 16 + i * 80, 80, "synthetic electrode");
+      put_field(hdr + 256 + signals * 96 + i * 8, 8, "uV");
+      spr = opt.rates[i % opt.nr_rates];
+      put_num(hdr + 256 + signals * 104 + i * 8, 8, -3200 - 100 * i);
+      put_num(hdr + 256 + signals * 112 + i * 8, 8, 3200 + 37 * i);
+      put_field(hdr + 256 + signals * 136 + i * 80, 80, "HP:0.1Hz LP:75Hz");
+    }
+    put_num(hdr + 256 + signals * 120 + i * 8, 8, dig_min);
+    put_num(hdr + 256 + signals * 128 + i * 8, 8, dig_max);
+    put_num(hdr + 256 + signals * 216 + i * 8, 8, spr);
+
+    recordsize += spr;
+  }
+
+  buf = (char *)malloc((long long)recordsize * samplesize);
+  if(buf==NULL)
+  {
+    printf("Malloc error! (buf)\n");
+    goto OUT_ERROR;
+  }
+
+  outputfile = fopen(argv[optind], "wb");
+  if(outputfile==NULL)
+  {
+    printf("Error, can not open file %s for writing\n", argv[optind]);
+    goto OUT_ERROR;
+  }
+
+  if(fwrite(hdr, hdrsize, 1, outputfile)!=1)
+  {
+    printf("Error when writing to outputfile\n");
+    goto OUT_ERROR;
+  }
+
+  state = opt.seed;
+
+  onset_ms = 0;
+
+  for(r=0; r<opt.datarecords; r++)
+  {
+    p = buf;
+
+    for(i=0; i<opt.signals; i++)
+    {
+      spr = opt.rates[i % opt.nr_rates];
+
+      for(j=0; j<spr; j++)
+      {
+        phase[i] += 1 + i;
+        val = (int)(sin(phase[i] * 0.01) * (dig_max / 2)) + (int)(lcg_next(&state) % 2001) - 1000;
+        if(val > dig_max)  val = dig_max;
+        if(val < dig_min)  val = dig_min;
+
+        *p++ = val & 0xff;
+        *p++ = (val >> 8) & 0xff;
+        if(opt.bdf)  *p++ = (val >> 16) & 0xff;
+      }
+    }
+
+    if(opt.plus)
+    {
+      write_tal(p, opt.annot_spr * samplesize, r, &opt, &state, onset_ms);
+    }
+
+    if(fwrite(buf, (long long)recordsize * samplesize, 1, outputfile)!=1)
+    {
+      printf("Error when writing to outputfile\n");
+      goto OUT_ERROR;
+    }
+
+    onset_ms += opt.duration_ms;
+    if(opt.discontinuous && (((r + 1) % opt.gap_every) == 0))
+    {
+      onset_ms += opt.duration_ms * 3 + 250;
+    }
+  }
+
+  if(fclose(outputfile))
+  {
+    outputfile = NULL;
+    printf("Error when writing to outputfile\n");
+    goto OUT_ERROR;
+  }
+
+  free(hdr);
+  free(buf);
+  free(phase);
+
+  return EXIT_SUCCESS;
+
+OUT_ERROR:
+
+  if(outputfile != NULL)
+  {
+    fclose(outputfile);
+  }
+  free(hdr);
+  free(buf);
+  free(phase);
+
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,613 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "edfindex.h"
+
+
+/* modification time of the file in nanoSeconds, a file can be rewritten within a second */
+static long long file_mtime(const struct stat *st)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+  return (long long)st->st_mtime * EDFRD_FP_SCALING;
+#elif defined(__APPLE__)
+  return (long long)st->st_mtimespec.tv_sec * EDFRD_FP_SCALING + st->st_mtimespec.tv_nsec;
+#else
+  return (long long)st->st_mtim.tv_sec * EDFRD_FP_SCALING + st->st_mtim.tv_nsec;
+#endif
+}
+
+
+static int add_segment(struct edfidx *idx, int recnr, long long starttime)
+{
+  struct edfidx_segment *tmp;
+
+
+  if(idx->nr_segments == idx->segment_size)
+  {
+    idx->segment_size = (idx->segment_size < 16) ? 16 : (idx->segment_size * 2);
+
+    tmp = (struct edfidx_segment *)realloc(idx->segment, idx->segment_size * sizeof(struct edfidx_segment));
+    if(tmp == NULL)  return -1;
+
+    idx->segment = tmp;
+  }
+
+  idx->segment[idx->nr_segments].first_record = recnr;
+  idx->segment[idx->nr_segments].records = 1;
+  idx->segment[idx->nr_segments].starttime = starttime;
+
+  idx->nr_segments++;
+
+  return 0;
+}
+
+
+/* line is "onset,duration,text" */
+static int add_annot(struct edfidx *idx, int recnr, long long onset, const char *line, int len)
+{
+  char *tmp_text;
+
+  struct edfidx_annot *tmp;
+
+
+  if(idx->nr_annots == idx->annot_size)
+  {
+    idx->annot_size = (idx->annot_size < 256) ? 256 : (idx->annot_size * 2);
+
+    tmp = (struct edfidx_annot *)realloc(idx->annot, idx->annot_size * sizeof(struct edfidx_annot));
+    if(tmp == NULL)  return -1;
+
+    idx->annot = tmp;
+  }
+
+  if((idx->text_len + len + 1) > idx->text_size)
+  {
+    idx->text_size = (idx->text_size < 4096) ? 4096 : (idx->text_size * 2);
+    if(idx->text_size < (idx->text_len + len + 1))  idx->text_size = idx->text_len + len + 1;
+
+    tmp_text = (char *)realloc(idx->text, idx->text_size);
+    if(tmp_text == NULL)  return -1;
+
+    idx->text = tmp_text;
+  }
+
+  memcpy(idx->text + idx->text_len, line, len);
+  idx->text[idx->text_len + len] = 0;
+
+  idx->annot[idx->nr_annots].record = recnr;
+  idx->annot[idx->nr_annots].onset = onset;
+  idx->annot[idx->nr_annots].line = idx->text_len;
+
+  idx->text_len += len + 1;
+
+  idx->nr_annots++;
+
+  return 0;
+}
+
+
+struct build_ctx{
+         struct edfidx *idx;
+         int recnr;
+         int malloc_error;
+         char *line;                /* room for the onset, duration and text of the longest TAL */
+       };
+
+
+static int index_annotation(void *ctx, const struct edfrd_annot *annot)
+{
+  int i, len;
+
+  char *line;
+
+  struct build_ctx *b;
+
+
+  b = (struct build_ctx *)ctx;
+
+  /* the fields come from one TAL, so they fit */
+  line = b->line;
+  memcpy(line, annot->onset_txt, annot->onset_len);
+  len = annot->onset_len;
+  line[len++] = ',';
+  memcpy(line + len, annot->duration_txt, annot->duration_len);
+  len += annot->duration_len;
+  line[len++] = ',';
+  memcpy(line + len, annot->text, annot->text_len);
+  len += annot->text_len;
+
+  for(i=0; i<len; i++)
+  {
+    if(((unsigned char *)line)[i] < 32)  line[i] = '.';
+  }
+
+  if(add_annot(b->idx, b->recnr, annot->onset, line, len))
+  {
+    b->malloc_error = 1;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* reads a line of any length into *buf, returns its length without the newline, or -1 at the end of the file */
+static int read_line(FILE *f, char **buf, int *size)
+{
+  int len=0;
+
+  char *tmp;
+
+
+  if(*buf == NULL)
+  {
+    *size = 4096;
+    *buf = (char *)malloc(*size);
+    if(*buf == NULL)  return -1;
+  }
+
+  while(fgets(*buf + len, *size - len, f) != NULL)
+  {
+    len += strlen(*buf + len);
+
+    if((*buf)[len-1] == '\n')
+    {
+      (*buf)[--len] = 0;
+      if(len && ((*buf)[len-1] == '\r'))  (*buf)[--len] = 0;
+      return len;
+    }
+
+    if(len == (*size - 1))
+    {
+      tmp = (char *)realloc(*buf, *size * 2);
+      if(tmp == NULL)  return -1;
+      *buf = tmp;
+      *size *= 2;
+    }
+  }
+
+  return len ? len : -1;
+}
+
+
+static void print_time(FILE *f, long long t)
+{
+  if(t < 0LL)
+  {
+    fputc('-', f);
+    t = -t;
+  }
+
+  fprintf(f, "%lli.%09lli", t / EDFRD_FP_SCALING, t % EDFRD_FP_SCALING);
+}
+
+
+int edfidx_read(struct edfidx *idx, const char *idx_path, const char *edf_path, char *errmsg, int errmsg_len)
+{
+  int i, n, len,
+      size=0,
+      count,
+      recnr,
+      err=-1;
+
+  char *line=NULL,
+       *ptr;
+
+  long long records;
+
+  FILE *f;
+
+  struct stat st;
+
+
+  memset(idx, 0, sizeof(struct edfidx));
+
+  if(stat(edf_path, &st))
+  {
+    snprintf(errmsg, errmsg_len, "Error, can not get the size of %s", edf_path);
+    return -1;
+  }
+
+  f = fopen(idx_path, "rb");
+  if(f == NULL)  return 1;
+
+  if((read_line(f, &line, &size) < 0) || strcmp(line, "edf2ascii index"))
+  {
+    snprintf(errmsg, errmsg_len, "Error, %s is not an index file", idx_path);
+    goto OUT;
+  }
+
+  n = 0;
+  for(i=0; i<7; i++)
+  {
+    if(read_line(f, &line, &size) < 0)  break;
+
+    n += sscanf(line, "file_size %lli", &idx->file_size);
+    if(!strncmp(line, "mtime ", 6))
+    {
+      idx->mtime = edfrd_atoll_x(line + 6, EDFRD_FP_SCALING);
+      n++;
+    }
+    n += sscanf(line, "signals %i", &idx->signals);
+    n += sscanf(line, "recordbytes %i", &idx->recordbytes);
+    n += sscanf(line, "datarecords %i", &idx->datarecords);
+    if(!strncmp(line, "record_duration ", 16))
+    {
+      idx->record_duration = edfrd_atoll_x(line + 16, EDFRD_FP_SCALING);
+      n++;
+    }
+    n += sscanf(line, "segments %i", &count);
+  }
+  if((n != 7) || (count < 0) || (idx->datarecords < 0))  goto OUT_DAMAGED;
+
+  /* written for another file, or for this file before it changed */
+  if((idx->file_size != (long long)st.st_size) || (idx->mtime != file_mtime(&st)))
+  {
+    err = 1;
+    goto OUT;
+  }
+
+  records = 0LL;
+  for(i=0; i<count; i++)
+  {
+    if(read_line(f, &line, &size) < 0)  goto OUT_DAMAGED;
+
+    if(sscanf(line, "%i,%i,", &recnr, &n) != 2)  goto OUT_DAMAGED;
+
+    ptr = strchr(strchr(line, ',') + 1, ',') + 1;
+
+    if((recnr != records) || (n < 1))  goto OUT_DAMAGED;
+
+    if(add_segment(idx, recnr, edfrd_atoll_x(ptr, EDFRD_FP_SCALING)))  goto OUT_MALLOC;
+
+    idx->segment[i].records = n;
+
+    records += n;
+  }
+  if(records != idx->datarecords)  goto OUT_DAMAGED;
+
+  if((read_line(f, &line, &size) < 0) || (sscanf(line, "annotations %i", &count) != 1) || (count < 0))
+  {
+    goto OUT_DAMAGED;
+  }
+
+  for(i=0; i<count; i++)
+  {
+    len = read_line(f, &line, &size);
+    if(len < 0)  goto OUT_DAMAGED;
+
+    ptr = strchr(line, ',');
+    if((ptr == NULL) || (sscanf(line, "%i", &recnr) != 1) || (recnr < 0) || (recnr >= idx->datarecords))
+    {
+      goto OUT_DAMAGED;
+    }
+
+    ptr++;
+    if(add_annot(idx, recnr, edfrd_parse_time(ptr, len - (ptr - line)), ptr, len - (ptr - line)))  goto OUT_MALLOC;
+  }
+
+  err = 0;
+
+OUT:
+
+  fclose(f);
+  free(line);
+  if(err)  edfidx_free(idx);
+
+  return err;
+
+OUT_DAMAGED:
+
+  snprintf(errmsg, errmsg_len, "Error, index file %s is damaged", idx_path);
+  goto OUT;
+
+OUT_MALLOC:
+
+  snprintf(errmsg, errmsg_len, "Malloc error! (index)");
+  goto OUT;
+}
+
+
+int edfidx_build(struct edfidx *idx, const char *path, char *errmsg, int errmsg_len)
+{
+  int r, err,
+      *selected=NULL;
+
+  long long t,
+            next_t=0LL;
+
+  const char *rec;
+
+  struct stat st;
+
+  struct edfrd_file *hdl;
+
+  const struct edfrd_hdr *hdr;
+
+  struct build_ctx *b=NULL;
+
+
+  memset(idx, 0, sizeof(struct edfidx));
+
+  hdl = edfrd_open(path, errmsg, errmsg_len);
+  if(hdl == NULL)  return -1;
+
+  hdr = edfrd_header(hdl);
+
+  if(stat(path, &st))
+  {
+    snprintf(errmsg, errmsg_len, "Error, can not get the size of %s", path);
+    goto OUT_ERROR;
+  }
+
+  idx->file_size = st.st_size;
+  idx->mtime = file_mtime(&st);
+  idx->signals = hdr->signals;
+  idx->recordbytes = hdr->recordbytes;
+  idx->datarecords = hdr->datarecords;
+  idx->record_duration = hdr->data_record_duration;
+
+  if(!hdr->datarecords)
+  {
+    edfrd_close(hdl);
+    return 0;
+  }
+
+  if(!hdr->plus)
+  {
+    if(add_segment(idx, 0, 0LL))  goto OUT_MALLOC;
+
+    idx->segment[0].records = hdr->datarecords;
+
+    edfrd_close(hdl);
+    return 0;
+  }
+
+  /* only the annotation signals are needed */
+  selected = (int *)calloc(hdr->signals, sizeof(int));
+  b = (struct build_ctx *)calloc(1, sizeof(struct build_ctx));
+  if((selected == NULL) || (b == NULL))  goto OUT_MALLOC;
+
+  b->line = (char *)malloc((hdr->max_tal_ln + 3) * 3);
+  if(b->line == NULL)  goto OUT_MALLOC;
+
+  if(edfrd_select_signals(hdl, selected))  goto OUT_READ;
+
+  b->idx = idx;
+
+  for(r=0; r<hdr->datarecords; r++)
+  {
+    err = edfrd_read_record(hdl, &rec);
+    if(err)
+    {
+      if(err == EDFRD_EOF)  snprintf(errmsg, errmsg_len, "Error, %s is shorter than its header says", path);
+      else  snprintf(errmsg, errmsg_len, "%s", edfrd_errmsg(hdl));
+      goto OUT_ERROR;
+    }
+
+    if(edfrd_record_starttime(hdl, rec, r, &t))  goto OUT_READ;
+
+    /* a datarecord that does not start where the last one ended starts a new segment */
+    if((!idx->nr_segments) || (t != next_t))
+    {
+      if(add_segment(idx, r, t))  goto OUT_MALLOC;
+    }
+    else
+    {
+      idx->segment[idx->nr_segments - 1].records++;
+    }
+    next_t = t + hdr->data_record_duration;
+
+    b->recnr = r;
+
+    if(edfrd_record_annotation_views(hdl, rec, index_annotation, b))
+    {
+      if(b->malloc_error)  goto OUT_MALLOC;
+      goto OUT_READ;
+    }
+  }
+
+  free(b->line);
+  free(b);
+  free(selected);
+  edfrd_close(hdl);
+
+  return 0;
+
+OUT_READ:
+
+  snprintf(errmsg, errmsg_len, "%s", edfrd_errmsg(hdl));
+  goto OUT_ERROR;
+
+OUT_MALLOC:
+
+  snprintf(errmsg, errmsg_len, "Malloc error! (index)");
+
+OUT_ERROR:
+
+  if(b != NULL)  free(b->line);
+  free(b);
+  free(selected);
+  edfrd_close(hdl);
+  edfidx_free(idx);
+
+  return -1;
+}
+
+
+int edfidx_write(const struct edfidx *idx, const char *path, char *errmsg, int errmsg_len)
+{
+  int i, err;
+
+  char tmp_path[1100];
+
+  FILE *f;
+
+
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+  f = fopen(tmp_path, "wb");
+  if(f == NULL)
+  {
+    snprintf(errmsg, errmsg_len, "Error, can not open file %s for writing", tmp_path);
+    return -1;
+  }
+
+  fprintf(f, "edf2ascii index\n");
+  fprintf(f, "file_size %lli\n", idx->file_size);
+  fprintf(f, "mtime ");
+  print_time(f, idx->mtime);
+  fprintf(f, "\n");
+  fprintf(f, "signals %i\n", idx->signals);
+  fprintf(f, "recordbytes %i\n", idx->recordbytes);
+  fprintf(f, "datarecords %i\n", idx->datarecords);
+  fprintf(f, "record_duration ");
+  print_time(f, idx->record_duration);
+  fprintf(f, "\nsegments %i\n", idx->nr_segments);
+
+  for(i=0; i<idx->nr_segments; i++)
+  {
+    fprintf(f, "%i,%i,", idx->segment[i].first_record, idx->segment[i].records);
+    print_time(f, idx->segment[i].starttime);
+    fputc('\n', f);
+  }
+
+  fprintf(f, "annotations %i\n", idx->nr_annots);
+
+  for(i=0; i<idx->nr_annots; i++)
+  {
+    fprintf(f, "%i,%s\n", idx->annot[i].record, idx->text + idx->annot[i].line);
+  }
+
+  err = ferror(f);
+  if(fclose(f))  err = 1;
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+  /* rename() does not replace a file here */
+  if(!err)  remove(path);
+#endif
+
+  if(err || rename(tmp_path, path))
+  {
+    remove(tmp_path);
+    snprintf(errmsg, errmsg_len, "Error, can not write index file %s", path);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+void edfidx_free(struct edfidx *idx)
+{
+  free(idx->segment);
+  free(idx->annot);
+  free(idx->text);
+  memset(idx, 0, sizeof(struct edfidx));
+}
+
+
+static int find_segment(const struct edfidx *idx, int recnr)
+{
+  int lo, hi, mid;
+
+
+  lo = 0;
+  hi = idx->nr_segments - 1;
+  while(lo < hi)
+  {
+    mid = lo + ((hi - lo + 1) / 2);
+    if(idx->segment[mid].first_record <= recnr)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid - 1;
+    }
+  }
+
+  return lo;
+}
+
+
+long long edfidx_record_start(const struct edfidx *idx, int recnr)
+{
+  const struct edfidx_segment *seg;
+
+
+  if(!idx->nr_segments)  return 0LL;
+
+  seg = idx->segment + find_segment(idx, recnr);
+
+  return seg->starttime + (recnr - seg->first_record) * idx->record_duration;
+}
+
+
+int edfidx_find_record(const struct edfidx *idx, long long t)
+{
+  int lo, hi, mid;
+
+  const struct edfidx_segment *seg;
+
+
+  if(!idx->nr_segments)  return 0;
+
+  /* the last segment that starts at or before t */
+  lo = 0;
+  hi = idx->nr_segments - 1;
+  while(lo < hi)
+  {
+    mid = lo + ((hi - lo + 1) / 2);
+    if(idx->segment[mid].starttime <= t)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid - 1;
+    }
+  }
+  seg = idx->segment + lo;
+
+  if((t <= seg->starttime) || (idx->record_duration < 1))  return seg->first_record;
+
+  if(((t - seg->starttime) / idx->record_duration) >= seg->records)
+  {
+    return seg->first_record + seg->records - 1;
+  }
+
+  return seg->first_record + (int)((t - seg->starttime) / idx->record_duration);
+}
@@ -0,0 +1,121 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+/*
+ * A sidecar index of an EDF(+)/BDF(+) file, so that the datarecord that holds a
+ * time, and the annotations, can be found without reading the whole file.
+ *
+ * The index lists the segments of the recording, runs of datarecords that follow
+ * each other without a gap, which gives the start time of every datarecord also
+ * in an EDF+D/BDF+D file. A plain EDF/BDF file has one segment. It also lists all
+ * annotations with the datarecord they were found in.
+ *
+ * It is a text file:
+ *
+ *   edf2ascii index
+ *   file_size <bytes>
+ *   mtime <seconds, to the nanosecond where the file system keeps that>
+ *   signals <including annotation signals>
+ *   recordbytes <bytes>
+ *   datarecords <n>
+ *   record_duration <seconds>
+ *   segments <n>
+ *   <first datarecord>,<datarecords>,<start time in seconds>
+ *   ...
+ *   annotations <n>
+ *   <datarecord>,<onset>,<duration>,<text>
+ *   ...
+ *
+ * Datarecords count from 0, onset and duration are as in the TAL, the text is UTF-8
+ * with control characters replaced by a dot. The size and modification time of the
+ * file, and the header fields, tell whether the index still belongs to it.
+ */
+
+
+#ifndef EDFINDEX_INCLUDED
+#define EDFINDEX_INCLUDED
+
+
+#include "edfread.h"
+
+
+struct edfidx_segment{
+         int first_record;
+         int records;
+         long long starttime;       /* in units of EDFRD_FP_SCALING */
+       };
+
+
+struct edfidx_annot{
+         int record;
+         long long onset;           /* in units of EDFRD_FP_SCALING */
+         int line;                  /* offset in text of "onset,duration,text" */
+       };
+
+
+struct edfidx{
+         long long file_size;
+         long long mtime;           /* in nanoSeconds */
+         int signals;
+         int recordbytes;
+         int datarecords;
+         long long record_duration; /* in units of EDFRD_FP_SCALING */
+         int nr_segments;
+         struct edfidx_segment *segment;
+         int nr_annots;
+         struct edfidx_annot *annot;
+         char *text;
+         int text_len;
+         int segment_size;          /* allocated */
+         int annot_size;
+         int text_size;
+       };
+
+
+/* reads the index file idx_path, returns 0, 1 when it does not exist or does not */
+/* belong to the file edf_path (anymore), or -1 on an error with a message in errmsg */
+int edfidx_read(struct edfidx *idx, const char *idx_path, const char *edf_path, char *errmsg, int errmsg_len);
+
+/* makes the index of the file at path by reading the annotation signals of all */
+/* its datarecords, returns 0 or -1 on an error with a message in errmsg         */
+int edfidx_build(struct edfidx *idx, const char *path, char *errmsg, int errmsg_len);
+
+/* writes the index to a temporary file that is then renamed to path */
+int edfidx_write(const struct edfidx *idx, const char *path, char *errmsg, int errmsg_len);
+
+void edfidx_free(struct edfidx *idx);
+
+/* start time of a datarecord */
+long long edfidx_record_start(const struct edfidx *idx, int recnr);
+
+/* the last datarecord that starts at or before t, 0 when t is before the first one */
+int edfidx_find_record(const struct edfidx *idx, long long t);
+
+
+#endif
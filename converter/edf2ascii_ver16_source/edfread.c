@@ -0,0 +1,1307 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(WIN64) && !defined(_WIN64)
+#define _GNU_SOURCE
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS  64  /* 64-bit off_t and st_size on 32-bit systems too */
+#endif
+#define EDFRD_HAVE_NEWLOCALE
+#define EDFRD_HAVE_MMAP
+#define EDFRD_HAVE_PREAD
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <locale.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef EDFRD_HAVE_MMAP
+#include <unistd.h>
+#include <sys/mman.h>
+#define EDFRD_O_BINARY  (0)
+#else
+#include <io.h>
+#define EDFRD_O_BINARY  (O_BINARY)
+#endif
+
+#include "edfread.h"
+
+
+/* size of the read-ahead window requested with MADV_WILLNEED when the file is memory-mapped */
+#define EDFRD_READAHEAD     (16 * 1024 * 1024)
+
+/* size of the multi-record buffer used when the file can not be memory-mapped */
+#define EDFRD_BATCH_BYTES   (1024 * 1024)
+
+/* unselected bytes between two selected signals are read anyway when the gap is smaller than this */
+#define EDFRD_SEL_MIN_GAP   (16 * 1024)
+
+
+/* a byte range inside a datarecord */
+struct edfrd_range{
+         int offset;
+         int len;
+       };
+
+
+struct edfrd_file{
+         int fd;
+         edfrd_read_fn read_fn;     /* reads the data instead of fd when not NULL */
+         void *read_ctx;
+         struct edfrd_hdr hdr;
+         struct edfrd_param *param;
+         char *hdrbuf;
+         const char *map;           /* the whole file when it is memory-mapped, otherwise NULL */
+         size_t map_len;
+         size_t advised;            /* end of the region for which read-ahead has been requested */
+         char *recbuf;              /* multi-record buffer for the non-mapped fallback */
+         int recbuf_records;        /* capacity of recbuf in datarecords */
+         int recbuf_first;          /* datarecord number of the first record in recbuf */
+         int recbuf_count;          /* number of valid datarecords in recbuf */
+         int fd_record;             /* datarecord number at the current position of fd, -1 if unknown */
+         struct edfrd_range *sel;   /* byte ranges of the selected signals, NULL when whole datarecords are read */
+         int sel_count;
+         char *scratchpad;
+         char *time_in_txt;
+         char *duration_in_txt;
+         int record;
+         int flags;                 /* EDFRD_OPEN_* */
+         int hdr_datarecords;       /* the number of datarecords in the header, -1 when not known yet */
+#ifdef EDFRD_HAVE_NEWLOCALE
+         locale_t c_locale;
+#endif
+         char errmsg[256];
+       };
+
+
+static void edfrd_set_error(char *dest, int len, const char *fmt, ...)
+{
+  va_list ap;
+
+  if((dest==NULL)||(len<1))  return;
+
+  va_start(ap, fmt);
+  vsnprintf(dest, len, fmt, ap);
+  va_end(ap);
+}
+
+
+/* header fields must be parsed with a '.' decimal separator, whatever the locale of the caller is */
+static double edfrd_atof(const struct edfrd_file *hdl, const char *str)
+{
+#ifdef EDFRD_HAVE_NEWLOCALE
+  if(hdl->c_locale != (locale_t)0)
+  {
+    return strtod_l(str, NULL, hdl->c_locale);
+  }
+#else
+  (void)hdl;
+#endif
+  return atof(str);
+}
+
+
+/* like read() but keeps going on short reads from pipes, returns the number of bytes read */
+static long long edfrd_read_full(struct edfrd_file *hdl, char *buf, long long len)
+{
+  long long n=0,
+            r;
+
+
+  while(n < len)
+  {
+    if(hdl->read_fn != NULL)
+    {
+      r = hdl->read_fn(hdl->read_ctx, buf + n, len - n);
+    }
+    else
+    {
+      r = read(hdl->fd, buf + n, ((len - n) > (1 << 30)) ? (1 << 30) : (len - n));
+    }
+    if(r < 0)
+    {
+      return -1;
+    }
+    if(r == 0)
+    {
+      break;
+    }
+    n += r;
+  }
+
+  return n;
+}
+
+
+static int edfrd_parse_header(struct edfrd_file *hdl, char *errbuf, int errbuf_len)
+{
+  int i,
+      signals;
+
+  char scratchpad[16],
+       *edf_hdr;
+
+  struct edfrd_hdr *hdr;
+
+  struct edfrd_param *edfparam;
+
+
+  hdr = &hdl->hdr;
+
+  edf_hdr = (char *)malloc(256);
+  if(edf_hdr==NULL)
+  {
+    edfrd_set_error(errbuf, errbuf_len, "Malloc error! (edf_hdr)");
+    return EDFRD_ERR_MALLOC;
+  }
+  hdl->hdrbuf = edf_hdr;
+
+  if(edfrd_read_full(hdl, edf_hdr, 256)!=256)
+  {
+    edfrd_set_error(errbuf, errbuf_len, "Error, reading file");
+    return EDFRD_ERR_READ;
+  }
+
+  if(!strncmp(edf_hdr, "0       ", 8))
+  {
+    hdr->filetype = EDFRD_FILETYPE_EDF;
+    hdr->samplesize = 2;
+  }
+  else if((((unsigned char *)edf_hdr)[0] == 0xff) && !strncmp(edf_hdr + 1, "BIOSEMI", 7))
+    {
+      hdr->filetype = EDFRD_FILETYPE_BDF;
+      hdr->samplesize = 3;
+    }
+    else
+    {
+      edfrd_set_error(errbuf, errbuf_len, "Error, EDF/BDF-header has unknown version");
+      return EDFRD_ERR_FORMAT;
+    }
+
+  memcpy(scratchpad, edf_hdr + 0xfc, 4);
+  scratchpad[4] = 0;
+  signals = atoi(scratchpad);
+  if((signals<1)||(signals>EDFRD_MAX_SIGNALS))
+  {
+    edfrd_set_error(errbuf, errbuf_len, "Error, number of signals in header is %i", signals);
+    return EDFRD_ERR_FORMAT;
+  }
+  hdr->signals = signals;
+
+  edf_hdr = (char *)realloc(hdl->hdrbuf, (signals + 1) * 256);
+  if(edf_hdr==NULL)
+  {
+    edfrd_set_error(errbuf, errbuf_len, "Malloc error! (edf_hdr)");
+    return EDFRD_ERR_MALLOC;
+  }
+  hdl->hdrbuf = edf_hdr;
+  hdr->raw = edf_hdr;
+
+  if(edfrd_read_full(hdl, edf_hdr + 256, signals * 256)!=(signals * 256))
+  {
+    edfrd_set_error(errbuf, errbuf_len, "Error, reading file");
+    return EDFRD_ERR_READ;
+  }
+
+  memcpy(scratchpad, edf_hdr + 0xec, 8);
+  scratchpad[8] = 0;
+  hdr->datarecords = atoi(scratchpad);
+  hdl->hdr_datarecords = hdr->datarecords;
+  /* a file that is being recorded may have -1 here until it is closed, */
+  /* the datarecords that are there are counted by edfrd_refresh()      */
+  if(hdl->flags & EDFRD_OPEN_GROWING)
+  {
+    if(hdl->hdr_datarecords<1)  hdl->hdr_datarecords = -1;
+    hdr->datarecords = 0;
+  }
+  else if(hdr->datarecords<1)
+  {
+    edfrd_set_error(errbuf, errbuf_len, "Error, number of datarecords in header is %i", hdr->datarecords);
+    return EDFRD_ERR_FORMAT;
+  }
+
+  memcpy(scratchpad, edf_hdr + 0xf4, 8);
+  scratchpad[8] = 0;
+  hdr->data_record_duration = edfrd_atoll_x(scratchpad, EDFRD_FP_SCALING);
+
+  edfparam = (struct edfrd_param *)calloc(signals, sizeof(struct edfrd_param));
+  if(edfparam==NULL)
+  {
+    edfrd_set_error(errbuf, errbuf_len, "Malloc error! (edfparam)");
+    return EDFRD_ERR_MALLOC;
+  }
+  hdl->param = edfparam;
+  hdr->param = edfparam;
+
+  hdr->nr_annot_chns = 0;
+
+  if(hdr->filetype == EDFRD_FILETYPE_EDF)
+  {
+    if((!strncmp(edf_hdr + 0xc0, "EDF+C     ", 10))||(!strncmp(edf_hdr + 0xc0, "EDF+D     ", 10)))
+    {
+      hdr->plus = 1;
+    }
+  }
+  else
+  {
+    if((!strncmp(edf_hdr + 0xc0, "BDF+C     ", 10))||(!strncmp(edf_hdr + 0xc0, "BDF+D     ", 10)))
+    {
+      hdr->plus = 1;
+    }
+  }
+
+  if(hdr->plus)
+  {
+    hdr->discontinuous = (edf_hdr[0xc3] == 'D');
+
+    for(i=0; i<signals; i++)
+    {
+      if(!(strncmp(edf_hdr + 256 + i * 16, (hdr->filetype == EDFRD_FILETYPE_EDF) ? "EDF Annotations " : "BDF Annotations ", 16)))
+      {
+        hdr->annot_ch[hdr->nr_annot_chns] = i;
+        hdr->nr_annot_chns++;
+        edfparam[i].annotation = 1;
+        if(hdr->nr_annot_chns>255)  break;
+      }
+    }
+    if(!hdr->nr_annot_chns)
+    {
+      edfrd_set_error(errbuf, errbuf_len, "Error, file is marked as %s but it has no annotationsignal.",
+                      (hdr->filetype == EDFRD_FILETYPE_EDF) ? "EDF+" : "BDF+");
+      return EDFRD_ERR_FORMAT;
+    }
+  }
+
+  hdr->recordsize = 0;
+
+  for(i=0; i<signals; i++)
+  {
+    memcpy(scratchpad, edf_hdr + 256 + signals * 216 + i * 8, 8);
+    scratchpad[8] = 0;
+    edfparam[i].smp_per_record = atoi(scratchpad);
+    if(edfparam[i].smp_per_record<1)
+    {
+      edfrd_set_error(errbuf, errbuf_len, "Error, number of samples per datarecord of signal %i is %i",
+                      i + 1, edfparam[i].smp_per_record);
+      return EDFRD_ERR_FORMAT;
+    }
+    /* the offsets in a datarecord are ints */
+    if(edfparam[i].smp_per_record > ((0x7fffffff / hdr->samplesize) - hdr->recordsize))
+    {
+      edfrd_set_error(errbuf, errbuf_len, "Error, the datarecords are larger than 2 GB");
+      return EDFRD_ERR_FORMAT;
+    }
+    edfparam[i].buf_offset = hdr->recordsize;
+    hdr->recordsize += edfparam[i].smp_per_record;
+    memcpy(scratchpad, edf_hdr + 256 + signals * 104 + i * 8, 8);
+    scratchpad[8] = 0;
+    edfparam[i].phys_min = edfrd_atof(hdl, scratchpad);
+    memcpy(scratchpad, edf_hdr + 256 + signals * 112 + i * 8, 8);
+    scratchpad[8] = 0;
+    edfparam[i].phys_max = edfrd_atof(hdl, scratchpad);
+    memcpy(scratchpad, edf_hdr + 256 + signals * 120 + i * 8, 8);
+    scratchpad[8] = 0;
+    edfparam[i].dig_min = atoi(scratchpad);
+    memcpy(scratchpad, edf_hdr + 256 + signals * 128 + i * 8, 8);
+    scratchpad[8] = 0;
+    edfparam[i].dig_max = atoi(scratchpad);
+    edfparam[i].time_step = hdr->data_record_duration / edfparam[i].smp_per_record;
+    edfparam[i].sense = (edfparam[i].phys_max - edfparam[i].phys_min) / (edfparam[i].dig_max - edfparam[i].dig_min);
+    edfparam[i].offset = edfparam[i].phys_max / edfparam[i].sense - edfparam[i].dig_max;
+  }
+
+  hdr->recordbytes = hdr->recordsize * hdr->samplesize;
+
+  hdr->max_tal_ln = 0;
+
+  for(i=0; i<hdr->nr_annot_chns; i++)
+  {
+    if(hdr->max_tal_ln<edfparam[hdr->annot_ch[i]].smp_per_record * hdr->samplesize)
+    {
+      hdr->max_tal_ln = edfparam[hdr->annot_ch[i]].smp_per_record * hdr->samplesize;
+    }
+  }
+
+  if(hdr->max_tal_ln<128)  hdr->max_tal_ln = 128;
+
+  return EDFRD_OK;
+}
+
+
+/* maps the file when it is a regular file, returns non-zero when the fallback must be used */
+static int edfrd_map_file(struct edfrd_file *hdl)
+{
+#ifdef EDFRD_HAVE_MMAP
+  struct stat st;
+
+  void *map;
+
+
+  if(fstat(hdl->fd, &st))  return -1;
+
+  if((!S_ISREG(st.st_mode))||(st.st_size < 1))  return -1;
+
+  /* a file larger than the address space (32-bit systems) is read in batches */
+  if((off_t)(size_t)st.st_size != st.st_size)  return -1;
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, hdl->fd, 0);
+  if(map == MAP_FAILED)  return -1;
+
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  hdl->map = (const char *)map;
+  hdl->map_len = st.st_size;
+  hdl->advised = 0;
+
+  return 0;
+#else
+  (void)hdl;
+
+  return -1;
+#endif
+}
+
+
+/* asks the kernel to start reading the window ahead of the datarecords at offset */
+static void edfrd_advise(struct edfrd_file *hdl, size_t offset, size_t len)
+{
+#ifdef EDFRD_HAVE_MMAP
+  int i;
+
+  size_t start, page, hdrsize, rec, rec_end, a, b;
+
+
+  if((offset + len) <= hdl->advised)  return;
+
+  page = sysconf(_SC_PAGESIZE);
+
+  start = offset;
+  if(start < hdl->advised)  start = hdl->advised;
+  start &= ~(page - 1);
+
+  if(start >= hdl->map_len)  return;
+
+  len = offset + len - start;
+  if(len < EDFRD_READAHEAD)  len = EDFRD_READAHEAD;
+  if((start + len) > hdl->map_len)  len = hdl->map_len - start;
+
+  if(hdl->sel == NULL)
+  {
+    madvise((void *)(hdl->map + start), len, MADV_WILLNEED);
+  }
+  else
+  {
+    /* only the selected signals of the datarecords in the window */
+    hdrsize = (hdl->hdr.signals + 1) * 256;
+
+    rec = (start > hdrsize) ? (start - hdrsize) / hdl->hdr.recordbytes : 0;
+    rec_end = (start + len - hdrsize + hdl->hdr.recordbytes - 1) / hdl->hdr.recordbytes;
+    if(rec_end > (size_t)hdl->hdr.datarecords)  rec_end = hdl->hdr.datarecords;
+
+    for(; rec<rec_end; rec++)
+    {
+      for(i=0; i<hdl->sel_count; i++)
+      {
+        a = hdrsize + rec * hdl->hdr.recordbytes + hdl->sel[i].offset;
+        b = a + hdl->sel[i].len;
+        a &= ~(page - 1);
+        if(b > hdl->map_len)  b = hdl->map_len;
+        if(a >= b)  continue;
+
+        madvise((void *)(hdl->map + a), b - a, MADV_WILLNEED);
+      }
+    }
+  }
+
+  hdl->advised = start + len;
+#else
+  (void)hdl;
+  (void)offset;
+  (void)len;
+#endif
+}
+
+
+#ifdef EDFRD_HAVE_PREAD
+/* reads only the selected signals of n datarecords into recbuf, returns the number of complete datarecords */
+static int edfrd_pread_selection(struct edfrd_file *hdl, int n)
+{
+  int i, k, r;
+
+  long long offset, done;
+
+  char *dest;
+
+
+  for(k=0; k<n; k++)
+  {
+    offset = ((hdl->hdr.signals + 1) * 256) + (long long)(hdl->record + k) * hdl->hdr.recordbytes;
+
+    dest = hdl->recbuf + (long long)k * hdl->hdr.recordbytes;
+
+    for(i=0; i<hdl->sel_count; i++)
+    {
+      for(done=0; done<hdl->sel[i].len; done+=r)
+      {
+        r = pread(hdl->fd, dest + hdl->sel[i].offset + done, hdl->sel[i].len - done, offset + hdl->sel[i].offset + done);
+        if(r <= 0)  return (r < 0) ? -1 : k;
+      }
+    }
+  }
+
+  return n;
+}
+#endif
+
+
+/* reads as many datarecords as fit in recbuf, starting at hdl->record */
+static int edfrd_fill_recbuf(struct edfrd_file *hdl)
+{
+  int n;
+
+  long long len, skip;
+
+
+  n = hdl->hdr.datarecords - hdl->record;
+  if(n > hdl->recbuf_records)  n = hdl->recbuf_records;
+
+#ifdef EDFRD_HAVE_PREAD
+  /* pread() only works on seekable files, streams always read whole datarecords */
+  if((hdl->sel != NULL) && (lseek(hdl->fd, 0, SEEK_CUR) >= 0))
+  {
+    hdl->recbuf_first = hdl->record;
+    hdl->recbuf_count = edfrd_pread_selection(hdl, n);
+    hdl->fd_record = -1;
+
+    if(hdl->recbuf_count < 1)
+    {
+      hdl->recbuf_count = 0;
+      edfrd_set_error(hdl->errmsg, 256, "Error when reading datarecord %i", hdl->record + 1);
+      return EDFRD_ERR_READ;
+    }
+
+    return EDFRD_OK;
+  }
+#endif
+
+  if(hdl->fd_record != hdl->record)
+  {
+    if(lseek(hdl->fd, ((hdl->hdr.signals + 1) * 256) + (off_t)hdl->record * hdl->hdr.recordbytes, SEEK_SET) < 0)
+    {
+      if((hdl->fd_record < 0) || (hdl->fd_record > hdl->record))
+      {
+        edfrd_set_error(hdl->errmsg, 256, "Error, can not seek back to datarecord %i in a stream", hdl->record + 1);
+        return EDFRD_ERR_READ;
+      }
+
+      /* not seekable, skip forward by reading */
+      while(hdl->fd_record < hdl->record)
+      {
+        skip = hdl->record - hdl->fd_record;
+        if(skip > hdl->recbuf_records)  skip = hdl->recbuf_records;
+        len = skip * hdl->hdr.recordbytes;
+        if(edfrd_read_full(hdl, hdl->recbuf, len) != len)
+        {
+          hdl->fd_record = -1;
+          edfrd_set_error(hdl->errmsg, 256, "Error when reading datarecord %i", hdl->record + 1);
+          return EDFRD_ERR_READ;
+        }
+        hdl->fd_record += skip;
+      }
+    }
+    hdl->fd_record = hdl->record;
+  }
+
+  hdl->recbuf_first = hdl->record;
+  hdl->recbuf_count = 0;
+
+  len = edfrd_read_full(hdl, hdl->recbuf, (long long)n * hdl->hdr.recordbytes);
+  if(len < 0)
+  {
+    hdl->fd_record = -1;
+    edfrd_set_error(hdl->errmsg, 256, "Error when reading datarecord %i", hdl->record + 1);
+    return EDFRD_ERR_READ;
+  }
+
+  hdl->recbuf_count = len / hdl->hdr.recordbytes;
+  hdl->fd_record += hdl->recbuf_count;
+
+  if(len % hdl->hdr.recordbytes)
+  {
+    /* a trailing partial datarecord has been consumed from the stream */
+    hdl->fd_record = -1;
+  }
+
+  if(!hdl->recbuf_count)
+  {
+    edfrd_set_error(hdl->errmsg, 256, "Error when reading datarecord %i", hdl->record + 1);
+    return EDFRD_ERR_READ;
+  }
+
+  return EDFRD_OK;
+}
+
+
+/* the handle reads from read_fn when it is not NULL, otherwise from fd, which it owns */
+static struct edfrd_file * edfrd_open_source(int fd, edfrd_read_fn read_fn, void *ctx, int flags, char *errbuf, int errbuf_len)
+{
+  struct edfrd_file *hdl;
+
+
+  edfrd_set_error(errbuf, errbuf_len, "");
+
+  hdl = (struct edfrd_file *)calloc(1, sizeof(struct edfrd_file));
+  if(hdl==NULL)
+  {
+    if(fd >= 0)  close(fd);
+    edfrd_set_error(errbuf, errbuf_len, "Malloc error! (hdl)");
+    return NULL;
+  }
+
+  /* a growing file can not be mapped, the mapping would not grow with it */
+  if(flags & EDFRD_OPEN_GROWING)
+  {
+    if(fd < 0)
+    {
+      edfrd_set_error(errbuf, errbuf_len, "Error, only a file can be read while it grows");
+      free(hdl);
+      return NULL;
+    }
+
+    flags |= EDFRD_OPEN_NO_MMAP;
+  }
+
+  hdl->fd = fd;
+  hdl->read_fn = read_fn;
+  hdl->read_ctx = ctx;
+  hdl->flags = flags;
+
+#ifdef EDFRD_HAVE_NEWLOCALE
+  hdl->c_locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+#endif
+
+  if(edfrd_parse_header(hdl, errbuf, errbuf_len))
+  {
+    goto OUT_ERROR;
+  }
+
+  if((flags & EDFRD_OPEN_NO_MMAP) || edfrd_map_file(hdl))
+  {
+    hdl->recbuf_records = EDFRD_BATCH_BYTES / hdl->hdr.recordbytes;
+    if(hdl->recbuf_records < 1)  hdl->recbuf_records = 1;
+    if((hdl->recbuf_records > hdl->hdr.datarecords) && (!(flags & EDFRD_OPEN_GROWING)))
+    {
+      hdl->recbuf_records = hdl->hdr.datarecords;
+    }
+
+    hdl->recbuf = (char *)malloc((long long)hdl->recbuf_records * hdl->hdr.recordbytes);
+    if(hdl->recbuf==NULL)
+    {
+      edfrd_set_error(errbuf, errbuf_len, "Malloc error! (cnv_buf)");
+      goto OUT_ERROR;
+    }
+
+    hdl->fd_record = 0;
+  }
+
+  hdl->scratchpad = (char *)malloc(hdl->hdr.max_tal_ln + 3);
+  hdl->time_in_txt = (char *)malloc(hdl->hdr.max_tal_ln + 3);
+  hdl->duration_in_txt = (char *)malloc(hdl->hdr.max_tal_ln + 3);
+  if((hdl->scratchpad==NULL)||(hdl->time_in_txt==NULL)||(hdl->duration_in_txt==NULL))
+  {
+    edfrd_set_error(errbuf, errbuf_len, "Malloc error! (scratchpad)");
+    goto OUT_ERROR;
+  }
+
+  hdl->record = 0;
+
+  if(flags & EDFRD_OPEN_GROWING)
+  {
+    if(edfrd_refresh(hdl) < 0)
+    {
+      edfrd_set_error(errbuf, errbuf_len, "%s", hdl->errmsg);
+      goto OUT_ERROR;
+    }
+  }
+
+  return hdl;
+
+OUT_ERROR:
+
+  edfrd_close(hdl);
+
+  return NULL;
+}
+
+
+struct edfrd_file * edfrd_open(const char *path, char *errbuf, int errbuf_len)
+{
+  return edfrd_open_ex(path, 0, errbuf, errbuf_len);
+}
+
+
+struct edfrd_file * edfrd_open_ex(const char *path, int flags, char *errbuf, int errbuf_len)
+{
+  int fd;
+
+
+  fd = open(path, O_RDONLY | EDFRD_O_BINARY);
+  if(fd<0)
+  {
+    edfrd_set_error(errbuf, errbuf_len, "Error, can not open file %s for reading", path);
+    return NULL;
+  }
+
+  return edfrd_open_fd(fd, flags, errbuf, errbuf_len);
+}
+
+
+struct edfrd_file * edfrd_open_fd(int fd, int flags, char *errbuf, int errbuf_len)
+{
+  if(fd<0)
+  {
+    edfrd_set_error(errbuf, errbuf_len, "Error, invalid file descriptor");
+    return NULL;
+  }
+
+  return edfrd_open_source(fd, NULL, NULL, flags, errbuf, errbuf_len);
+}
+
+
+struct edfrd_file * edfrd_open_reader(edfrd_read_fn read_fn, void *ctx, int flags, char *errbuf, int errbuf_len)
+{
+  return edfrd_open_source(-1, read_fn, ctx, flags, errbuf, errbuf_len);
+}
+
+
+const struct edfrd_hdr * edfrd_header(const struct edfrd_file *hdl)
+{
+  return &hdl->hdr;
+}
+
+
+const char * edfrd_errmsg(const struct edfrd_file *hdl)
+{
+  return hdl->errmsg;
+}
+
+
+int edfrd_read_record(struct edfrd_file *hdl, const char **rec)
+{
+  int count;
+
+  return edfrd_read_records(hdl, 1, rec, &count);
+}
+
+
+int edfrd_read_records(struct edfrd_file *hdl, int max_records, const char **recs, int *count)
+{
+  int err, n;
+
+  size_t offset;
+
+
+  *count = 0;
+
+  if(hdl->record >= hdl->hdr.datarecords)
+  {
+    return EDFRD_EOF;
+  }
+
+  n = hdl->hdr.datarecords - hdl->record;
+  if(n > max_records)  n = max_records;
+
+  if(hdl->map != NULL)
+  {
+    offset = ((hdl->hdr.signals + 1) * 256) + (size_t)hdl->record * hdl->hdr.recordbytes;
+
+    if((offset + hdl->hdr.recordbytes) > hdl->map_len)
+    {
+      edfrd_set_error(hdl->errmsg, 256, "Error when reading datarecord %i", hdl->record + 1);
+      return EDFRD_ERR_READ;
+    }
+
+    if((offset + (size_t)n * hdl->hdr.recordbytes) > hdl->map_len)
+    {
+      n = (hdl->map_len - offset) / hdl->hdr.recordbytes;
+    }
+
+    edfrd_advise(hdl, offset, (size_t)n * hdl->hdr.recordbytes);
+
+    *recs = hdl->map + offset;
+  }
+  else
+  {
+    if((hdl->record < hdl->recbuf_first) || (hdl->record >= (hdl->recbuf_first + hdl->recbuf_count)))
+    {
+      err = edfrd_fill_recbuf(hdl);
+      if(err)  return err;
+    }
+
+    if(n > (hdl->recbuf_first + hdl->recbuf_count - hdl->record))
+    {
+      n = hdl->recbuf_first + hdl->recbuf_count - hdl->record;
+    }
+
+    *recs = hdl->recbuf + (long long)(hdl->record - hdl->recbuf_first) * hdl->hdr.recordbytes;
+  }
+
+  hdl->record += n;
+
+  *count = n;
+
+  return EDFRD_OK;
+}
+
+
+int edfrd_refresh(struct edfrd_file *hdl)
+{
+  int n;
+
+  long long hdrsize;
+
+  char field[9];
+
+  struct stat st;
+
+
+  if(!(hdl->flags & EDFRD_OPEN_GROWING))  return EDFRD_EOF;
+
+  /* the recorder writes the number of datarecords in the header when it closes the file */
+  if(hdl->hdr_datarecords < 1)
+  {
+#ifdef EDFRD_HAVE_PREAD
+    if(pread(hdl->fd, field, 8, 0xec) == 8)
+#else
+    hdl->fd_record = -1;
+    if((lseek(hdl->fd, 0xec, SEEK_SET) == 0xec) && (read(hdl->fd, field, 8) == 8))
+#endif
+    {
+      field[8] = 0;
+      n = atoi(field);
+      if(n > 0)  hdl->hdr_datarecords = n;
+    }
+  }
+
+  if(fstat(hdl->fd, &st))
+  {
+    edfrd_set_error(hdl->errmsg, 256, "Error, can not get the size of the file");
+    return EDFRD_ERR_READ;
+  }
+
+  hdrsize = (hdl->hdr.signals + 1) * 256;
+
+  n = 0;
+  if(st.st_size > hdrsize)
+  {
+    if(((st.st_size - hdrsize) / hdl->hdr.recordbytes) > 0x7fffffffLL)
+    {
+      n = 0x7fffffff;
+    }
+    else
+    {
+      n = (st.st_size - hdrsize) / hdl->hdr.recordbytes;
+    }
+  }
+
+  if((hdl->hdr_datarecords > 0) && (n > hdl->hdr_datarecords))  n = hdl->hdr_datarecords;
+
+  /* a file does not shrink while it is being recorded */
+  if(n < hdl->hdr.datarecords)
+  {
+    edfrd_set_error(hdl->errmsg, 256, "Error, the file became shorter while it was read");
+    return EDFRD_ERR_READ;
+  }
+
+  hdl->hdr.datarecords = n;
+
+  if((hdl->hdr_datarecords > 0) && (n >= hdl->hdr_datarecords))  return EDFRD_EOF;
+
+  return EDFRD_OK;
+}
+
+
+int edfrd_seek_record(struct edfrd_file *hdl, int recnr)
+{
+  if((recnr<0)||(recnr>hdl->hdr.datarecords))
+  {
+    edfrd_set_error(hdl->errmsg, 256, "Error, datarecord %i is out of range", recnr + 1);
+    return EDFRD_ERR_RANGE;
+  }
+
+  /* the file position is updated lazily by the next read */
+  hdl->record = recnr;
+
+  return EDFRD_OK;
+}
+
+
+int edfrd_select_signals(struct edfrd_file *hdl, const int *selected)
+{
+  int i, n=0,
+      offset,
+      len;
+
+  struct edfrd_range *range=NULL;
+
+  const struct edfrd_hdr *hdr;
+
+
+  hdr = &hdl->hdr;
+
+  free(hdl->sel);
+  hdl->sel = NULL;
+  hdl->sel_count = 0;
+
+  /* the buffered datarecords may lack the newly selected signals */
+  hdl->recbuf_count = 0;
+
+  if(selected != NULL)
+  {
+    range = (struct edfrd_range *)malloc(hdr->signals * sizeof(struct edfrd_range));
+    if(range==NULL)
+    {
+      edfrd_set_error(hdl->errmsg, 256, "Malloc error! (selection)");
+      return EDFRD_ERR_MALLOC;
+    }
+
+    /* the signals are stored one after another, so the ranges come out in order */
+    for(i=0; i<hdr->signals; i++)
+    {
+      if((!selected[i]) && (!hdr->param[i].annotation))  continue;
+
+      offset = hdr->param[i].buf_offset * hdr->samplesize;
+      len = hdr->param[i].smp_per_record * hdr->samplesize;
+
+      if(n && ((offset - (range[n-1].offset + range[n-1].len)) < EDFRD_SEL_MIN_GAP))
+      {
+        range[n-1].len = offset + len - range[n-1].offset;
+      }
+      else
+      {
+        range[n].offset = offset;
+        range[n].len = len;
+        n++;
+      }
+    }
+
+    /* not worth the trouble when (almost) everything is read anyway */
+    if((n == 0) || ((n == 1) && ((hdr->recordbytes - range[0].len) < EDFRD_SEL_MIN_GAP)))
+    {
+      free(range);
+      range = NULL;
+      n = 0;
+    }
+  }
+
+  hdl->sel = range;
+  hdl->sel_count = n;
+
+#ifdef EDFRD_HAVE_MMAP
+  if(hdl->map != NULL)
+  {
+    /* sequential read-ahead would fault in the unselected signals as well */
+    madvise((void *)hdl->map, hdl->map_len, (range != NULL) ? MADV_RANDOM : MADV_SEQUENTIAL);
+    hdl->advised = 0;
+  }
+#endif
+
+  return EDFRD_OK;
+}
+
+
+int edfrd_record_starttime(struct edfrd_file *hdl, const char *rec, int recnr, long long *starttime)
+{
+  int p, max;
+
+  const struct edfrd_hdr *hdr;
+
+
+  hdr = &hdl->hdr;
+
+  if(!hdr->plus)
+  {
+    *starttime = recnr * hdr->data_record_duration;
+
+    return EDFRD_OK;
+  }
+
+  max = hdr->param[hdr->annot_ch[0]].smp_per_record * hdr->samplesize;
+  p = hdr->param[hdr->annot_ch[0]].buf_offset * hdr->samplesize;
+
+  /* the timekeeping TAL comes first, the parser stops at the 20 that ends its onset */
+  *starttime = edfrd_parse_time(rec + p, max);
+
+  return EDFRD_OK;
+}
+
+
+/* returns the index of the first 0, 20 or 21 in the len bytes at str, or len when there is none */
+static int edfrd_tal_delimiter(const char *str, int len)
+{
+  int i=0, end;
+
+  unsigned char c;
+
+  unsigned long long v;
+
+
+  /* eight bytes at a time, a byte below 22 sets the high bit of its lane */
+  while((i + 8) <= len)
+  {
+    memcpy(&v, str + i, 8);
+
+    if(!((v - 0x1616161616161616ULL) & ~v & 0x8080808080808080ULL))
+    {
+      i += 8;
+      continue;
+    }
+
+    for(end=i+8; i<end; i++)
+    {
+      c = str[i];
+      if((c <= 21) && ((c == 0) || (c >= 20)))  return i;
+    }
+  }
+
+  for(; i<len; i++)
+  {
+    c = str[i];
+    if((c <= 21) && ((c == 0) || (c >= 20)))  return i;
+  }
+
+  return len;
+}
+
+
+int edfrd_record_annotation_views(struct edfrd_file *hdl, const char *rec, edfrd_annot_view_cb callback, void *ctx)
+{
+  int k, e, r,
+      max,
+      onset,
+      duration;
+
+  const char *tal;
+
+  struct edfrd_annot annot;
+
+  const struct edfrd_hdr *hdr;
+
+
+  hdr = &hdl->hdr;
+
+  for(r=0; r<hdr->nr_annot_chns; r++)
+  {
+    tal = rec + hdr->param[hdr->annot_ch[r]].buf_offset * hdr->samplesize;
+    max = hdr->param[hdr->annot_ch[r]].smp_per_record * hdr->samplesize;
+    onset = 0;
+    duration = 0;
+    annot.onset = 0LL;
+    annot.onset_txt = "";
+    annot.onset_len = 0;
+    annot.duration = -1LL;
+    annot.duration_txt = "";
+    annot.duration_len = 0;
+
+    /* every TAL ends with a 0, a field that is not closed by its delimiter is ignored */
+    for(k=0; k<max; k=e+1)
+    {
+      e = k + edfrd_tal_delimiter(tal + k, max - k);
+      if(e >= max)  break;
+
+      if(tal[e]==0)
+      {
+        onset = 0;
+        duration = 0;
+        annot.duration_txt = "";
+        annot.duration_len = 0;
+        annot.duration = -1LL;
+
+        /* the rest of the signal is usually padding, a TAL after the padding
+           is still read, as the parser of edf2ascii 1.6 did (its test for a
+           run of zeros came after the reset of the counter and never stopped it) */
+        while(((e + 1) < max) && (tal[e + 1]==0))  e++;
+
+        continue;
+      }
+
+      if(tal[e]==20)
+      {
+        if(duration)
+        {
+          annot.duration_txt = tal + k;
+          annot.duration_len = e - k;
+          annot.duration = (e > k) ? edfrd_parse_time(tal + k, e - k) : -1LL;
+          duration = 0;
+        }
+        else if(onset)
+             {
+               if(e > k)
+               {
+                 annot.text = tal + k;
+                 annot.text_len = e - k;
+
+                 if(callback(ctx, &annot))
+                 {
+                   edfrd_set_error(hdl->errmsg, 256, "Annotation processing aborted in record %i", hdl->record);
+                   return EDFRD_ERR_ABORT;
+                 }
+               }
+               annot.duration_txt = "";
+               annot.duration_len = 0;
+               annot.duration = -1LL;
+             }
+             else
+             {
+               annot.onset_txt = tal + k;
+               annot.onset_len = e - k;
+               annot.onset = edfrd_parse_time(tal + k, e - k);
+               onset = 1;
+               annot.duration_txt = "";
+               annot.duration_len = 0;
+               annot.duration = -1LL;
+             }
+
+        continue;
+      }
+
+      /* 21 */
+      if(!onset)
+      {
+        annot.onset_txt = tal + k;
+        annot.onset_len = e - k;
+        annot.onset = edfrd_parse_time(tal + k, e - k);
+        onset = 1;
+      }
+      duration = 1;
+      annot.duration_txt = "";
+      annot.duration_len = 0;
+      annot.duration = -1LL;
+    }
+  }
+
+  return EDFRD_OK;
+}
+
+
+/* hands the views of edfrd_record_annotation_views() as 0-terminated copies to an edfrd_annot_cb */
+struct edfrd_copy_ctx{
+         struct edfrd_file *hdl;
+         edfrd_annot_cb callback;
+         void *ctx;
+       };
+
+
+static int edfrd_copy_annotation(void *ctx, const struct edfrd_annot *annot)
+{
+  struct edfrd_copy_ctx *cc;
+
+  struct edfrd_file *hdl;
+
+
+  cc = (struct edfrd_copy_ctx *)ctx;
+  hdl = cc->hdl;
+
+  memcpy(hdl->time_in_txt, annot->onset_txt, annot->onset_len);
+  hdl->time_in_txt[annot->onset_len] = 0;
+  memcpy(hdl->duration_in_txt, annot->duration_txt, annot->duration_len);
+  hdl->duration_in_txt[annot->duration_len] = 0;
+  memcpy(hdl->scratchpad, annot->text, annot->text_len);
+  hdl->scratchpad[annot->text_len] = 0;
+
+  return cc->callback(cc->ctx, hdl->time_in_txt, hdl->duration_in_txt, hdl->scratchpad);
+}
+
+
+int edfrd_record_annotations(struct edfrd_file *hdl, const char *rec, edfrd_annot_cb callback, void *ctx)
+{
+  struct edfrd_copy_ctx cc;
+
+
+  cc.hdl = hdl;
+  cc.callback = callback;
+  cc.ctx = ctx;
+
+  return edfrd_record_annotation_views(hdl, rec, edfrd_copy_annotation, &cc);
+}
+
+
+void edfrd_close(struct edfrd_file *hdl)
+{
+  if(hdl==NULL)  return;
+
+#ifdef EDFRD_HAVE_MMAP
+  if(hdl->map != NULL)
+  {
+    munmap((void *)hdl->map, hdl->map_len);
+  }
+#endif
+  if(hdl->fd >= 0)
+  {
+    close(hdl->fd);
+  }
+#ifdef EDFRD_HAVE_NEWLOCALE
+  if(hdl->c_locale != (locale_t)0)
+  {
+    freelocale(hdl->c_locale);
+  }
+#endif
+  free(hdl->hdrbuf);
+  free(hdl->param);
+  free(hdl->recbuf);
+  free(hdl->sel);
+  free(hdl->scratchpad);
+  free(hdl->time_in_txt);
+  free(hdl->duration_in_txt);
+  free(hdl);
+}
+
+
+long long edfrd_atoll_x(const char *str, int dimension)
+{
+  int i,
+      radix,
+      negative=0;
+
+  long long value=0LL;
+
+  while(*str==' ')
+  {
+    str++;
+  }
+
+  if(*str=='-')
+  {
+    negative = 1;
+    str++;
+  }
+  else
+  {
+    if(*str=='+')
+    {
+      str++;
+    }
+  }
+
+  for(i=0; ; i++)
+  {
+    if(str[i]=='.')
+    {
+      str += (i + 1);
+
+      break;
+    }
+
+    if((str[i]<'0') || (str[i]>'9'))
+    {
+      if(negative)
+      {
+        return value * dimension * -1LL;
+      }
+      else
+      {
+        return value * dimension;
+      }
+    }
+
+    value *= 10LL;
+
+    value += str[i] - '0';
+  }
+
+  radix = 1;
+
+  for(i=0; radix<dimension; i++)
+  {
+    if((str[i]<'0') || (str[i]>'9'))
+    {
+      break;
+    }
+
+    radix *= 10;
+
+    value *= 10LL;
+
+    value += str[i] - '0';
+  }
+
+  if(negative)
+  {
+    return value * (dimension / radix) * -1LL;
+  }
+  else
+  {
+    return value * (dimension / radix);
+  }
+}
+
+
+long long edfrd_parse_time(const char *str, int len)
+{
+  int i=0,
+      negative=0;
+
+  long long value=0LL,
+            scale=EDFRD_FP_SCALING;
+
+
+  while((i<len) && (str[i]==' '))  i++;
+
+  if((i<len) && (str[i]=='-'))
+  {
+    negative = 1;
+    i++;
+  }
+  else if((i<len) && (str[i]=='+'))
+       {
+         i++;
+       }
+
+  for(; (i<len) && (str[i]>='0') && (str[i]<='9'); i++)
+  {
+    value = (value * 10LL) + (str[i] - '0');
+  }
+
+  /* nanoSeconds are the last digits that count */
+  if((i<len) && (str[i]=='.'))
+  {
+    for(i++; (i<len) && (scale>1LL) && (str[i]>='0') && (str[i]<='9'); i++)
+    {
+      value = (value * 10LL) + (str[i] - '0');
+      scale /= 10LL;
+    }
+  }
+
+  value *= scale;
+
+  return negative ? -value : value;
+}
@@ -0,0 +1,225 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+/*
+ * libedfread: a small reader library for EDF(+) and BDF(+) files.
+ *
+ * The library keeps no global state. All state lives in the handle returned
+ * by edfrd_open(), so different files can be read from different threads
+ * at the same time. A single handle must not be used by more than one
+ * thread at a time.
+ *
+ * Typical use:
+ *
+ *   hdl = edfrd_open(path, errbuf, sizeof(errbuf));
+ *   hdr = edfrd_header(hdl);
+ *   while(!edfrd_read_record(hdl, &rec))
+ *   {
+ *     edfrd_record_starttime(hdl, rec, recnr, &t);
+ *     edfrd_record_annotation_views(hdl, rec, callback, ctx);
+ *     edfrd_decode_physical(hdr, rec, signal, buf);
+ *   }
+ *   edfrd_close(hdl);
+ */
+
+
+#ifndef EDFREAD_INCLUDED
+#define EDFREAD_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define EDFRD_FP_SCALING     (1000000000LL)
+
+#define EDFRD_MAX_SIGNALS    (256)
+
+#define EDFRD_FILETYPE_EDF   (0)
+#define EDFRD_FILETYPE_BDF   (1)
+
+#define EDFRD_OK             (0)
+#define EDFRD_EOF            (1)
+#define EDFRD_ERR_OPEN      (-1)
+#define EDFRD_ERR_READ      (-2)
+#define EDFRD_ERR_FORMAT    (-3)
+#define EDFRD_ERR_MALLOC    (-4)
+#define EDFRD_ERR_TAL       (-5)
+#define EDFRD_ERR_RANGE     (-6)
+#define EDFRD_ERR_ABORT     (-7)
+
+#define EDFRD_OPEN_NO_MMAP   (1)  /* always use buffered reads, even for regular files */
+#define EDFRD_OPEN_GROWING   (2)  /* the file may still be recorded, see edfrd_refresh() */
+
+
+struct edfrd_param{
+         int smp_per_record;
+         int dig_min;
+         int dig_max;
+         double offset;
+         int buf_offset;            /* in samples from the start of the datarecord */
+         double phys_min;
+         double phys_max;
+         long long time_step;       /* in units of EDFRD_FP_SCALING */
+         double sense;
+         int annotation;            /* non-zero for EDF+/BDF+ annotation signals */
+       };
+
+
+struct edfrd_hdr{
+         int filetype;              /* EDFRD_FILETYPE_EDF or EDFRD_FILETYPE_BDF */
+         int plus;                  /* EDF+ or BDF+ */
+         int discontinuous;         /* EDF+D or BDF+D */
+         int samplesize;            /* 2 for EDF, 3 for BDF */
+         int signals;               /* including annotation signals */
+         int datarecords;
+         long long data_record_duration;  /* in units of EDFRD_FP_SCALING */
+         int recordsize;            /* samples per datarecord, all signals */
+         int recordbytes;           /* recordsize * samplesize */
+         int nr_annot_chns;
+         int annot_ch[EDFRD_MAX_SIGNALS];
+         int max_tal_ln;
+         const char *raw;           /* the (signals + 1) * 256 header bytes as found in the file */
+         const struct edfrd_param *param;
+       };
+
+
+struct edfrd_file;
+
+
+/* called for every annotation found in a datarecord, a non-zero return value stops the scan */
+typedef int (*edfrd_annot_cb)(void *ctx, const char *onset, const char *duration, char *text);
+
+
+/* one annotation of a datarecord, the fields point into the datarecord and are not 0-terminated */
+struct edfrd_annot{
+         long long onset;           /* in units of EDFRD_FP_SCALING from the start of the file */
+         long long duration;        /* in units of EDFRD_FP_SCALING, -1 when the annotation has none */
+         const char *onset_txt;     /* as written in the file, for example "+12.5" */
+         int onset_len;
+         const char *duration_txt;
+         int duration_len;          /* 0 when the annotation has no duration */
+         const char *text;          /* UTF-8 */
+         int text_len;
+       };
+
+
+/* called for every annotation found in a datarecord, annot is only valid during the call, */
+/* a non-zero return value stops the scan                                                  */
+typedef int (*edfrd_annot_view_cb)(void *ctx, const struct edfrd_annot *annot);
+
+
+/* opens and validates a file, returns NULL on failure with a message in errbuf */
+/* regular files are memory-mapped and datarecords are handed out without copying, */
+/* other files (pipes, devices) are read in batches of several datarecords */
+struct edfrd_file * edfrd_open(const char *path, char *errbuf, int errbuf_len);
+
+/* as edfrd_open(), flags is a combination of EDFRD_OPEN_* */
+struct edfrd_file * edfrd_open_ex(const char *path, int flags, char *errbuf, int errbuf_len);
+
+/* as edfrd_open_ex() but reads from a file descriptor that is already open, for example */
+/* a pipe, the header is read in one forward pass, the handle closes fd in edfrd_close() */
+struct edfrd_file * edfrd_open_fd(int fd, int flags, char *errbuf, int errbuf_len);
+
+/* reads up to len bytes into buf, returns the number of bytes read, 0 at the end of the data, */
+/* or -1 on error, it may return less than len before the end of the data                       */
+typedef long long (*edfrd_read_fn)(void *ctx, char *buf, long long len);
+
+/* as edfrd_open_fd() but the data comes from read_fn, for example a decompressor, */
+/* the file is read in one forward pass                                             */
+struct edfrd_file * edfrd_open_reader(edfrd_read_fn read_fn, void *ctx, int flags, char *errbuf, int errbuf_len);
+
+const struct edfrd_hdr * edfrd_header(const struct edfrd_file *hdl);
+
+/* points *rec at the next datarecord, the data stays valid until the next read or seek */
+/* returns EDFRD_OK, EDFRD_EOF after the last datarecord, or a negative error code */
+int edfrd_read_record(struct edfrd_file *hdl, const char **rec);
+
+/* points *recs at up to max_records consecutive datarecords, *count is set to the number available */
+int edfrd_read_records(struct edfrd_file *hdl, int max_records, const char **recs, int *count);
+
+/* positions the handle so that the next edfrd_read_record() returns datarecord recnr */
+int edfrd_seek_record(struct edfrd_file *hdl, int recnr);
+
+/* for a handle opened with EDFRD_OPEN_GROWING: sets the datarecords in the header to the */
+/* number of complete datarecords in the file now, the number in the file's header may   */
+/* be -1 until the recording is closed, returns EDFRD_OK, EDFRD_EOF when the recording   */
+/* is closed and all its datarecords are there, or a negative error code                  */
+/* without EDFRD_OPEN_GROWING it just returns EDFRD_EOF                                    */
+int edfrd_refresh(struct edfrd_file *hdl);
+
+/* restricts reading to the signals for which selected[signal] is non-zero, annotation signals */
+/* are always read, the bytes of the other signals in the datarecords handed out are undefined */
+/* selected is NULL to read whole datarecords again */
+int edfrd_select_signals(struct edfrd_file *hdl, const int *selected);
+
+/* start time of a datarecord relative to the start of the file, in units of EDFRD_FP_SCALING */
+int edfrd_record_starttime(struct edfrd_file *hdl, const char *rec, int recnr, long long *starttime);
+
+/* runs the TAL parser over all annotation signals of a datarecord, the callback gets */
+/* 0-terminated copies of the fields                                                  */
+int edfrd_record_annotations(struct edfrd_file *hdl, const char *rec, edfrd_annot_cb callback, void *ctx);
+
+/* as edfrd_record_annotations() but the fields are not copied, the TALs are split in place */
+/* and the onset and duration come parsed, this is the faster one                          */
+int edfrd_record_annotation_views(struct edfrd_file *hdl, const char *rec, edfrd_annot_view_cb callback, void *ctx);
+
+/* converts all samples of one signal in a datarecord to physical values */
+/* uses SSE2 or AVX2 when the CPU supports it, the results do not depend on the kernel used */
+void edfrd_decode_physical(const struct edfrd_hdr *hdr, const char *rec, int signal, double *buf);
+
+/* as edfrd_decode_physical() but rounds the physical values to single precision */
+void edfrd_decode_physical_f(const struct edfrd_hdr *hdr, const char *rec, int signal, float *buf);
+
+/* copies the digital values of one signal in a datarecord to buf, without scaling */
+void edfrd_decode_digital(const struct edfrd_hdr *hdr, const char *rec, int signal, int *buf);
+
+/* as edfrd_decode_digital() for EDF files, of which the digital values fit in 16 bits */
+void edfrd_decode_digital16(const struct edfrd_hdr *hdr, const char *rec, int signal, short *buf);
+
+/* converts n consecutive samples of samplesize (2 or 3) bytes starting at src to physical values */
+void edfrd_decode_samples(const char *src, int samplesize, int n, double offset, double sense, double *buf);
+
+void edfrd_decode_samples_f(const char *src, int samplesize, int n, double offset, double sense, float *buf);
+
+/* message describing the last error that occurred on this handle */
+const char * edfrd_errmsg(const struct edfrd_file *hdl);
+
+void edfrd_close(struct edfrd_file *hdl);
+
+long long edfrd_atoll_x(const char *str, int dimension);
+
+/* same as edfrd_atoll_x(str, EDFRD_FP_SCALING) for the len bytes at str, which need not be 0-terminated */
+long long edfrd_parse_time(const char *str, int len);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
@@ -0,0 +1,144 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "npywriter.h"
+
+
+
+/* the header dictionary is followed by 'shape' so the count can be overwritten in place */
+#define NPYW_COUNT_WIDTH  (20)
+
+
+static int npyw_header(struct npyw *w, const char *type)
+{
+  char hdr[NPYW_HDR_LEN];
+
+  int len;
+
+  const unsigned short one=1;
+
+
+  memset(hdr, ' ', NPYW_HDR_LEN);
+
+  memcpy(hdr, "\x93NUMPY\x01\x00", 8);
+  hdr[8] = (NPYW_HDR_LEN - 10) & 0xff;
+  hdr[9] = ((NPYW_HDR_LEN - 10) >> 8) & 0xff;
+
+  len = snprintf(hdr + 10, NPYW_HDR_LEN - 10, "{'descr': '%c%s', 'fortran_order': False, 'shape': (%*lli,), }",
+                 (*(const unsigned char *)&one) ? '<' : '>', type, NPYW_COUNT_WIDTH, w->count);
+  if((len < 1) || (len >= (NPYW_HDR_LEN - 11)))  return -1;
+
+  hdr[10 + len] = ' ';
+  hdr[NPYW_HDR_LEN - 1] = '\n';
+
+  if(fwrite(hdr, NPYW_HDR_LEN, 1, w->file) != 1)  return -1;
+
+  return 0;
+}
+
+
+int npyw_open(struct npyw *w, const char *path, const char *type, int itemsize)
+{
+  memset(w, 0, sizeof(struct npyw));
+
+  w->itemsize = itemsize;
+
+  w->file = fopen(path, "w+b");
+  if(w->file == NULL)  return -1;
+
+  setvbuf(w->file, NULL, _IOFBF, NPYW_BUFSIZE);
+
+  if(npyw_header(w, type))
+  {
+    w->error = 1;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+void npyw_write(struct npyw *w, const void *data, long long n)
+{
+  if((w->file == NULL) || (n < 1))  return;
+
+  if(fwrite(data, w->itemsize, n, w->file) != (size_t)n)
+  {
+    w->error = 1;
+  }
+
+  w->count += n;
+}
+
+
+int npyw_close(struct npyw *w)
+{
+  char count[NPYW_COUNT_WIDTH + 1];
+
+  const char *key="'shape': (";
+
+  char hdr[NPYW_HDR_LEN];
+
+  char *p;
+
+
+  if(w->file == NULL)  return w->error;
+
+  /* overwrite the placeholder with the real number of elements */
+  if((!w->error) && (!fseek(w->file, 0, SEEK_SET)) && (fread(hdr, NPYW_HDR_LEN, 1, w->file) == 1))
+  {
+    hdr[NPYW_HDR_LEN - 1] = 0;
+
+    p = strstr(hdr + 10, key);
+    if(p != NULL)
+    {
+      snprintf(count, sizeof(count), "%*lli", NPYW_COUNT_WIDTH, w->count);
+
+      if(fseek(w->file, (p - hdr) + strlen(key), SEEK_SET) || (fwrite(count, NPYW_COUNT_WIDTH, 1, w->file) != 1))
+      {
+        w->error = 1;
+      }
+    }
+    else
+    {
+      w->error = 1;
+    }
+  }
+  else
+  {
+    w->error = 1;
+  }
+
+  if(fclose(w->file))  w->error = 1;
+
+  w->file = NULL;
+
+  return w->error;
+}
@@ -0,0 +1,69 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+/*
+ * Writes one-dimensional arrays in the NumPy .npy format (version 1.0),
+ * which numpy.load(path, mmap_mode='r') maps without parsing.
+ *
+ * The number of elements is not known when the file is opened, the header
+ * reserves room for it and npyw_close() fills it in, so the output must be
+ * a regular file.
+ */
+
+
+#ifndef NPYWRITER_INCLUDED
+#define NPYWRITER_INCLUDED
+
+
+#include <stdio.h>
+
+
+#define NPYW_BUFSIZE    (256 * 1024)
+
+/* the magic string, the version, the header length and a header padded to 128 bytes */
+#define NPYW_HDR_LEN    (128)
+
+
+struct npyw{
+         FILE *file;
+         long long count;           /* number of elements written */
+         int itemsize;
+         int error;
+       };
+
+
+/* creates the file, type is the NumPy type code without the byte order, for example */
+/* "f8", "f4" or "i8", the elements are stored in the byte order of this machine      */
+int npyw_open(struct npyw *w, const char *path, const char *type, int itemsize);
+
+/* appends n elements */
+void npyw_write(struct npyw *w, const void *data, long long n);
+
+/* writes the final shape to the header and closes the file, returns non-zero on a write error */
+int npyw_close(struct npyw *w);
+
+
+#endif
@@ -0,0 +1,442 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "pyramid.h"
+
+
+#define PYR_HDR_LEN      (40)
+#define PYR_SIGNAL_LEN   (32)
+#define PYR_LEVEL_LEN    (16)
+#define PYR_BIN_LEN      (3 * sizeof(float))
+
+
+static void put_int(struct pyr *p, int val)
+{
+  if(fwrite(&val, sizeof(int), 1, p->file) != 1)  p->error = 1;
+}
+
+
+static void put_llong(struct pyr *p, long long val)
+{
+  if(fwrite(&val, sizeof(long long), 1, p->file) != 1)  p->error = 1;
+}
+
+
+static void flush_level(struct pyr *p, struct pyr_level *lv)
+{
+  if(!lv->buf_len)  return;
+
+  if(fseeko(p->file, (off_t)(lv->offset + lv->written * PYR_BIN_LEN), SEEK_SET) ||
+     (fwrite(lv->buf, PYR_BIN_LEN, lv->buf_len, p->file) != (size_t)lv->buf_len))
+  {
+    p->error = 1;
+  }
+
+  lv->written += lv->buf_len;
+  lv->buf_len = 0;
+}
+
+
+static void merge_bin(struct pyr_bin *acc, const struct pyr_bin *bin)
+{
+  if(!acc->count)
+  {
+    *acc = *bin;
+    return;
+  }
+
+  if(bin->min < acc->min)  acc->min = bin->min;
+  if(bin->max > acc->max)  acc->max = bin->max;
+  acc->sum += bin->sum;
+  acc->count += bin->count;
+}
+
+
+static void level_add(struct pyr *p, struct pyr_signal *s, int k, const struct pyr_bin *bin);
+
+
+/* the bin of level k is complete, or it is the last one */
+static void level_emit(struct pyr *p, struct pyr_signal *s, int k)
+{
+  float *dest;
+
+  struct pyr_level *lv;
+
+
+  lv = s->level + k;
+
+  /* there is no room for more samples than the header of the file announced */
+  if((lv->written + lv->buf_len) < lv->bins)
+  {
+    dest = lv->buf + (lv->buf_len * 3);
+    dest[0] = lv->acc.min;
+    dest[1] = lv->acc.max;
+    dest[2] = lv->acc.sum / lv->acc.count;
+
+    if(++lv->buf_len == PYR_BUF_BINS)  flush_level(p, lv);
+  }
+
+  if((k + 1) < s->levels)  level_add(p, s, k + 1, &lv->acc);
+
+  lv->acc.count = 0;
+}
+
+
+static void level_add(struct pyr *p, struct pyr_signal *s, int k, const struct pyr_bin *bin)
+{
+  struct pyr_level *lv;
+
+
+  lv = s->level + k;
+
+  merge_bin(&lv->acc, bin);
+
+  if(lv->acc.count >= ((long long)PYR_BLOCK << k))  level_emit(p, s, k);
+}
+
+
+int pyr_open(struct pyr *p, const char *path, int signals, const int *signal, const int *smp_per_record,
+             long long records, long long record_duration, long long first_record)
+{
+  int i, k;
+
+  long long offset,
+            bins;
+
+  struct pyr_signal *s;
+
+
+  memset(p, 0, sizeof(struct pyr));
+
+  p->signals = signals;
+  p->record_duration = record_duration;
+  p->first_record = first_record;
+
+  p->sig = (struct pyr_signal *)calloc(signals, sizeof(struct pyr_signal));
+  if(p->sig == NULL)  return -1;
+
+  /* the level tables follow the list of signals, then come the bins */
+  offset = PYR_HDR_LEN + (long long)signals * PYR_SIGNAL_LEN;
+  for(i=0; i<signals; i++)
+  {
+    s = p->sig + i;
+    s->signal = signal[i];
+    s->smp_per_record = smp_per_record[i];
+
+    s->levels = 0;
+    if((records * smp_per_record[i]) > 0LL)
+    {
+      do
+      {
+        bins = ((records * smp_per_record[i]) + ((long long)PYR_BLOCK << s->levels) - 1) / ((long long)PYR_BLOCK << s->levels);
+        s->levels++;
+      }
+      while(bins > 1LL);
+    }
+
+    s->table = offset;
+    offset += (long long)s->levels * PYR_LEVEL_LEN;
+
+    if(s->levels)
+    {
+      s->level = (struct pyr_level *)calloc(s->levels, sizeof(struct pyr_level));
+      if(s->level == NULL)  goto OUT_ERROR;
+    }
+  }
+
+  for(i=0; i<signals; i++)
+  {
+    s = p->sig + i;
+
+    for(k=0; k<s->levels; k++)
+    {
+      s->level[k].offset = offset;
+      s->level[k].bins = ((records * s->smp_per_record) + ((long long)PYR_BLOCK << k) - 1) / ((long long)PYR_BLOCK << k);
+      offset += s->level[k].bins * PYR_BIN_LEN;
+
+      s->level[k].buf = (float *)malloc(((s->level[k].bins < PYR_BUF_BINS) ? s->level[k].bins : PYR_BUF_BINS) * PYR_BIN_LEN);
+      if(s->level[k].buf == NULL)  goto OUT_ERROR;
+    }
+  }
+
+  p->file = fopen(path, "w+b");
+  if(p->file == NULL)  goto OUT_ERROR;
+
+  return 0;
+
+OUT_ERROR:
+
+  pyr_close(p);
+
+  return -1;
+}
+
+
+int pyr_write_bins(struct pyr *p, struct pyr_bins *b)
+{
+  int i, j;
+
+  struct pyr_signal *s;
+
+
+  for(i=0; i<b->signals; i++)
+  {
+    s = p->sig + i;
+
+    if(s->levels)
+    {
+      for(j=0; j<b->count[i]; j++)
+      {
+        s->samples += b->bin[i][j].count;
+
+        level_add(p, s, 0, b->bin[i] + j);
+      }
+    }
+
+    b->count[i] = 0;
+  }
+
+  return p->error;
+}
+
+
+int pyr_close(struct pyr *p)
+{
+  int i, k, err;
+
+  struct pyr_signal *s;
+
+
+  if(p->file != NULL)
+  {
+    for(i=0; i<p->signals; i++)
+    {
+      s = p->sig + i;
+
+      /* the partly filled bins at the end, from the bottom up so they are merged first */
+      for(k=0; k<s->levels; k++)
+      {
+        if(s->level[k].acc.count)  level_emit(p, s, k);
+
+        flush_level(p, s->level + k);
+      }
+    }
+
+    if(fseeko(p->file, 0, SEEK_SET) || (fwrite("EDFPYR01", 8, 1, p->file) != 1))  p->error = 1;
+    put_int(p, 0x01020304);
+    put_int(p, PYR_BLOCK);
+    put_int(p, p->signals);
+    put_int(p, 0);
+    put_llong(p, p->record_duration);
+    put_llong(p, p->first_record);
+
+    for(i=0; i<p->signals; i++)
+    {
+      s = p->sig + i;
+      put_int(p, s->signal + 1);
+      put_int(p, s->smp_per_record);
+      put_int(p, s->levels);
+      put_int(p, 0);
+      put_llong(p, s->samples);
+      put_llong(p, s->table);
+    }
+
+    for(i=0; i<p->signals; i++)
+    {
+      s = p->sig + i;
+
+      for(k=0; k<s->levels; k++)
+      {
+        put_llong(p, s->level[k].offset);
+        put_llong(p, s->level[k].bins);
+      }
+    }
+
+    if(fclose(p->file))  p->error = 1;
+    p->file = NULL;
+  }
+
+  for(i=0; (p->sig!=NULL)&&(i<p->signals); i++)
+  {
+    for(k=0; (p->sig[i].level!=NULL)&&(k<p->sig[i].levels); k++)
+    {
+      free(p->sig[i].level[k].buf);
+    }
+    free(p->sig[i].level);
+  }
+  free(p->sig);
+
+  err = p->error;
+
+  memset(p, 0, sizeof(struct pyr));
+
+  return err;
+}
+
+
+int pyr_bins_init(struct pyr_bins *b, int signals)
+{
+  memset(b, 0, sizeof(struct pyr_bins));
+
+  b->signals = signals;
+  b->count = (int *)calloc(signals, sizeof(int));
+  b->size = (int *)calloc(signals, sizeof(int));
+  b->bin = (struct pyr_bin **)calloc(signals, sizeof(struct pyr_bin *));
+  if((b->count==NULL)||(b->size==NULL)||(b->bin==NULL))
+  {
+    pyr_bins_free(b);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+void pyr_bins_free(struct pyr_bins *b)
+{
+  int i;
+
+  for(i=0; (b->bin!=NULL)&&(i<b->signals); i++)
+  {
+    free(b->bin[i]);
+  }
+  free(b->bin);
+  free(b->count);
+  free(b->size);
+  memset(b, 0, sizeof(struct pyr_bins));
+}
+
+
+void pyr_bins_clear(struct pyr_bins *b)
+{
+  int i;
+
+  for(i=0; i<b->signals; i++)
+  {
+    b->count[i] = 0;
+  }
+}
+
+
+/* makes room for the bins of n more samples */
+static int bins_reserve(struct pyr_bins *b, int sig, int n)
+{
+  int size;
+
+  struct pyr_bin *tmp;
+
+
+  size = b->count[sig] + (n / PYR_BLOCK) + 2;
+  if(size <= b->size[sig])  return 0;
+
+  if(size < (b->size[sig] * 2))  size = b->size[sig] * 2;
+
+  tmp = (struct pyr_bin *)realloc(b->bin[sig], size * sizeof(struct pyr_bin));
+  if(tmp == NULL)  return -1;
+
+  b->bin[sig] = tmp;
+  b->size[sig] = size;
+
+  return 0;
+}
+
+
+int pyr_bins_add(struct pyr_bins *b, int sig, const double *x, int n, long long first)
+{
+  int i, len;
+
+  struct pyr_bin *bin;
+
+
+  if(bins_reserve(b, sig, n))  return -1;
+
+  while(n > 0)
+  {
+    /* up to the next multiple of PYR_BLOCK */
+    len = PYR_BLOCK - (int)(first % PYR_BLOCK);
+    if(len > n)  len = n;
+
+    bin = b->bin[sig] + b->count[sig]++;
+    bin->min = x[0];
+    bin->max = x[0];
+    bin->sum = 0.0;
+    for(i=0; i<len; i++)
+    {
+      if(x[i] < bin->min)  bin->min = x[i];
+      if(x[i] > bin->max)  bin->max = x[i];
+      bin->sum += x[i];
+    }
+    bin->count = len;
+
+    x += len;
+    n -= len;
+    first += len;
+  }
+
+  return 0;
+}
+
+
+int pyr_bins_add_f(struct pyr_bins *b, int sig, const float *x, int n, long long first)
+{
+  int i, len;
+
+  struct pyr_bin *bin;
+
+
+  if(bins_reserve(b, sig, n))  return -1;
+
+  while(n > 0)
+  {
+    len = PYR_BLOCK - (int)(first % PYR_BLOCK);
+    if(len > n)  len = n;
+
+    bin = b->bin[sig] + b->count[sig]++;
+    bin->min = x[0];
+    bin->max = x[0];
+    bin->sum = 0.0;
+    for(i=0; i<len; i++)
+    {
+      if(x[i] < bin->min)  bin->min = x[i];
+      if(x[i] > bin->max)  bin->max = x[i];
+      bin->sum += x[i];
+    }
+    bin->count = len;
+
+    x += len;
+    n -= len;
+    first += len;
+  }
+
+  return 0;
+}
@@ -0,0 +1,152 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+/*
+ * A min/max/mean summary of every signal at power-of-two decimation levels, so a
+ * viewer can draw an overview of a long recording from a few kilobytes.
+ *
+ * A bin of level k summarizes PYR_BLOCK << k consecutive samples of a signal, bin
+ * i of level k starts at sample i * (PYR_BLOCK << k). The last level has a single
+ * bin. The samples are counted from the first datarecord that was converted, the
+ * gaps between the datarecords of an EDF+D/BDF+D file are not in the pyramid.
+ *
+ * The file holds, in the byte order of the machine that wrote it:
+ *
+ *   char[8]  "EDFPYR01"
+ *   int32    0x01020304, to recognize the byte order
+ *   int32    PYR_BLOCK
+ *   int32    number of signals
+ *   int32    0
+ *   int64    duration of a datarecord in nanoSeconds
+ *   int64    the first datarecord converted, counted from 0
+ *
+ * followed by, per signal:
+ *
+ *   int32    signal number, counted from 1
+ *   int32    samples per datarecord
+ *   int32    number of levels
+ *   int32    0
+ *   int64    number of samples in the pyramid
+ *   int64    file offset of the level table
+ *
+ * A level table has per level an int64 file offset and an int64 number of bins
+ * there is room for. A bin is three float32: min, max and mean. Level k holds
+ * ceil(samples / (PYR_BLOCK << k)) bins, fewer than there is room for when the
+ * file was shorter than its header says.
+ *
+ * Threads that convert chunks of datarecords collect the level 0 bins of their
+ * chunk with pyr_bins_add(), the bins at the edges of a chunk cover only part of
+ * PYR_BLOCK samples. pyr_write_bins() merges them, in the order of the datarecords,
+ * into the levels.
+ */
+
+
+#ifndef PYRAMID_INCLUDED
+#define PYRAMID_INCLUDED
+
+
+#include <stdio.h>
+
+
+#define PYR_BLOCK      (16)    /* samples per bin of level 0 */
+
+#define PYR_BUF_BINS   (1024)  /* bins kept per level before they are written */
+
+
+struct pyr_bin{
+         double min;
+         double max;
+         double sum;
+         long long count;           /* samples */
+       };
+
+
+/* level 0 bins per signal, of some consecutive datarecords */
+struct pyr_bins{
+         int signals;
+         int *count;
+         int *size;
+         struct pyr_bin **bin;
+       };
+
+
+struct pyr_level{
+         long long offset;          /* in the file */
+         long long bins;            /* room in the file */
+         long long written;
+         struct pyr_bin acc;        /* the bin that is being filled */
+         float *buf;                /* PYR_BUF_BINS bins that are not written yet */
+         int buf_len;
+       };
+
+
+struct pyr_signal{
+         int signal;
+         int smp_per_record;
+         int levels;
+         long long samples;
+         long long table;           /* file offset of the level table */
+         struct pyr_level *level;
+       };
+
+
+struct pyr{
+         FILE *file;
+         int signals;
+         long long record_duration;
+         long long first_record;
+         struct pyr_signal *sig;
+         int error;
+       };
+
+
+/* creates the file, with room for the pyramids of records datarecords of the signals */
+/* signal[] (counted from 0) that have smp_per_record[] samples per datarecord         */
+int pyr_open(struct pyr *p, const char *path, int signals, const int *signal, const int *smp_per_record,
+             long long records, long long record_duration, long long first_record);
+
+/* adds the bins, in the order of the samples, and empties b */
+int pyr_write_bins(struct pyr *p, struct pyr_bins *b);
+
+/* writes the last bins and the header and closes the file, returns non-zero on a write error */
+int pyr_close(struct pyr *p);
+
+int pyr_bins_init(struct pyr_bins *b, int signals);
+
+void pyr_bins_free(struct pyr_bins *b);
+
+void pyr_bins_clear(struct pyr_bins *b);
+
+/* adds n samples of a signal, the first one is sample first of the pyramid, returns -1 on a malloc error */
+int pyr_bins_add(struct pyr_bins *b, int sig, const double *x, int n, long long first);
+
+int pyr_bins_add_f(struct pyr_bins *b, int sig, const float *x, int n, long long first);
+
+
+#endif
@@ -0,0 +1,261 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "resample.h"
+
+
+#define RSMP_ZEROS    (10)   /* zero crossings of the sinc on either side of the centre */
+#define RSMP_BETA     (5.0)  /* Kaiser window */
+
+
+/* modified Bessel function of the first kind, order 0 */
+static double bessel_i0(double x)
+{
+  int k;
+
+  double sum=1.0,
+         term=1.0;
+
+
+  for(k=1; k<100; k++)
+  {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if(term < (sum * 1e-17))  break;
+  }
+
+  return sum;
+}
+
+
+static long long floor_div(long long a, long long b)
+{
+  long long q;
+
+
+  q = a / b;
+  if(((a % b) != 0) && ((a < 0) != (b < 0)))  q--;
+
+  return q;
+}
+
+
+int rsmp_reach(int up, int down)
+{
+  int half;
+
+
+  half = RSMP_ZEROS * ((up > down) ? up : down);
+
+  return (half + up - 1) / up + 1;
+}
+
+
+int rsmp_init(struct rsmp *r, int up, int down, long long first_in, long long first_out)
+{
+  int p, i, emax, half, maxf;
+
+  long long t;
+
+  double x, sum, *c;
+
+
+  memset(r, 0, sizeof(struct rsmp));
+
+  maxf = (up > down) ? up : down;
+  half = RSMP_ZEROS * maxf;
+
+  /* tap i of phase p weighs input sample floor(j * M / L) + emin + i, */
+  /* at distance p - (emin + i) * L in the upsampled domain            */
+  r->emin = -(half / up);
+  emax = (half + up - 1) / up;
+  r->taps = emax - r->emin + 1;
+  r->up = up;
+  r->down = down;
+
+  r->coef = (double *)malloc((long long)up * r->taps * sizeof(double));
+  if(r->coef == NULL)  return -1;
+
+  for(p=0; p<up; p++)
+  {
+    c = r->coef + (long long)p * r->taps;
+    sum = 0.0;
+
+    for(i=0; i<r->taps; i++)
+    {
+      t = p - (long long)(r->emin + i) * up;
+      if((t < -half) || (t > half))
+      {
+        c[i] = 0.0;
+        continue;
+      }
+
+      x = (double)t / maxf;
+      c[i] = (t == 0) ? 1.0 : (sin(M_PI * x) / (M_PI * x));
+      x = (double)t / half;
+      c[i] *= bessel_i0(RSMP_BETA * sqrt(1.0 - x * x)) / bessel_i0(RSMP_BETA);
+      sum += c[i];
+    }
+
+    for(i=0; i<r->taps; i++)
+    {
+      c[i] /= sum;
+    }
+  }
+
+  r->buf_size = 4096;
+  r->buf = (double *)malloc(r->buf_size * sizeof(double));
+  if(r->buf == NULL)
+  {
+    rsmp_free(r);
+    return -1;
+  }
+
+  r->buf_start = first_in;
+  r->next_out = first_out;
+
+  return 0;
+}
+
+
+void rsmp_free(struct rsmp *r)
+{
+  free(r->coef);
+  free(r->buf);
+  r->coef = NULL;
+  r->buf = NULL;
+}
+
+
+int rsmp_push(struct rsmp *r, const double *x, int n)
+{
+  int keep;
+
+  long long oldest;
+
+  double *tmp;
+
+
+  /* drop the samples that the next output does not need anymore */
+  oldest = floor_div(r->next_out * r->down, r->up) + r->emin;
+  if(oldest > (r->buf_start + r->buf_len))  oldest = r->buf_start + r->buf_len;
+  if(oldest > r->buf_start)
+  {
+    keep = r->buf_start + r->buf_len - oldest;
+    memmove(r->buf, r->buf + (oldest - r->buf_start), keep * sizeof(double));
+    r->buf_start = oldest;
+    r->buf_len = keep;
+  }
+
+  if((r->buf_len + n) > r->buf_size)
+  {
+    while((r->buf_len + n) > r->buf_size)  r->buf_size *= 2;
+
+    tmp = (double *)realloc(r->buf, r->buf_size * sizeof(double));
+    if(tmp == NULL)  return -1;
+    r->buf = tmp;
+  }
+
+  memcpy(r->buf + r->buf_len, x, n * sizeof(double));
+  r->buf_len += n;
+
+  return 0;
+}
+
+
+void rsmp_finish(struct rsmp *r)
+{
+  r->finished = 1;
+}
+
+
+int rsmp_pull(struct rsmp *r, double *y, int n)
+{
+  int i, k, p;
+
+  long long base, idx, end;
+
+  const double *c;
+
+  double sum;
+
+
+  if(!r->buf_len)  return 0;
+
+  end = r->buf_start + r->buf_len;
+
+  for(k=0; k<n; k++)
+  {
+    base = floor_div(r->next_out * r->down, r->up);
+
+    if((!r->finished) && ((base + r->emin + r->taps) > end))  break;
+
+    p = r->next_out * r->down - base * r->up;
+    c = r->coef + (long long)p * r->taps;
+    idx = base + r->emin - r->buf_start;
+
+    sum = 0.0;
+
+    if((idx >= 0) && ((idx + r->taps) <= r->buf_len))
+    {
+      for(i=0; i<r->taps; i++)
+      {
+        sum += c[i] * r->buf[idx + i];
+      }
+    }
+    else
+    {
+      /* near the start or the end, extend the signal with its first or last sample */
+      for(i=0; i<r->taps; i++)
+      {
+        if((idx + i) < 0)
+        {
+          sum += c[i] * r->buf[0];
+        }
+        else if((idx + i) >= r->buf_len)
+          {
+            sum += c[i] * r->buf[r->buf_len - 1];
+          }
+          else
+          {
+            sum += c[i] * r->buf[idx + i];
+          }
+      }
+    }
+
+    y[k] = sum;
+
+    r->next_out++;
+  }
+
+  return k;
+}
@@ -0,0 +1,87 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+/*
+ * Streaming rational sample rate conversion by L/M with a polyphase FIR filter,
+ * for lowering the sample rate of a signal without aliasing.
+ *
+ * The prototype lowpass is a Kaiser-windowed sinc (beta 5, 10 zero crossings on
+ * either side of the centre, cut off at the lower of the two Nyquist rates), the
+ * same design as scipy.signal.resample_poly(). Every phase is normalized to a
+ * DC gain of exactly 1. The filter is centred on the output sample, so there is
+ * no delay: output sample j lies at the time of input sample j * M / L. That
+ * needs input up to rsmp_reach() samples beyond that point, so the caller must
+ * push that far ahead before it pulls. Before the first and after the last input
+ * sample the signal is extended with the first and last value.
+ */
+
+
+#ifndef RESAMPLE_INCLUDED
+#define RESAMPLE_INCLUDED
+
+
+/* the largest L or M that is accepted */
+#define RSMP_MAX_FACTOR   (65536)
+
+
+struct rsmp{
+         int up;                    /* L */
+         int down;                  /* M */
+         int taps;                  /* per phase */
+         int emin;                  /* offset of the first tap from floor(j * M / L) */
+         double *coef;              /* up phases of taps coefficients */
+         double *buf;               /* input samples, buf[0] is sample buf_start */
+         long long buf_start;
+         int buf_len;
+         int buf_size;
+         long long next_out;        /* index of the next output sample */
+         int finished;              /* no more input will follow */
+       };
+
+
+/* prepares a converter from up/down, which have no common factor, the first sample */
+/* pushed has index first_in, the first sample pulled has index first_out            */
+int rsmp_init(struct rsmp *r, int up, int down, long long first_in, long long first_out);
+
+void rsmp_free(struct rsmp *r);
+
+/* how many input samples after the position of an output sample the filter uses */
+int rsmp_reach(int up, int down);
+
+/* appends n input samples, returns -1 on a malloc error */
+int rsmp_push(struct rsmp *r, const double *x, int n);
+
+/* the input has ended, the remaining output can be pulled */
+void rsmp_finish(struct rsmp *r);
+
+/* writes up to n output samples to y, returns the number written, which is less than n */
+/* when more input is needed                                                             */
+int rsmp_pull(struct rsmp *r, double *y, int n);
+
+
+#endif
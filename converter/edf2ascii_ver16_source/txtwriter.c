@@ -0,0 +1,616 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+#include <stdlib.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "txtwriter.h"
+
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#define txw_snprintf  __mingw_snprintf
+#define txw_vsnprintf  __mingw_vsnprintf
+#else
+#define txw_snprintf  snprintf
+#define txw_vsnprintf  vsnprintf
+#endif
+
+
+/* the write thread of txw_async_start(), it writes one buffer while the other one is filled */
+struct txw_async{
+         pthread_t thread;
+         pthread_mutex_t lock;
+         pthread_cond_t cond;       /* a job was handed over or finished, or the thread must stop */
+         char *spare;               /* the buffer that is not being filled */
+         long long spare_size;
+         const char *job;           /* the buffer being written, NULL when the thread is idle */
+         long long job_len;
+         FILE *job_file;
+         int error;                 /* a write failed, reported at the next wait */
+         long long written;         /* bytes written since the last wait */
+         int stop;
+       };
+
+
+static const char digit_pairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+static const double pow10_tbl[10]={1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+static const unsigned long long pow10_int[10]={1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL,
+                                               100000ULL, 1000000ULL, 10000000ULL,
+                                               100000000ULL, 1000000000ULL};
+
+
+static double txw_now(void)
+{
+  struct timespec ts;
+
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/* fwrite() that keeps count of the bytes and, when asked, the time */
+static int txw_fwrite(struct txw *w, const char *buf, long long len)
+{
+  int r;
+
+  double t=0.0;
+
+
+  if(w->timed)  t = txw_now();
+
+  r = (fwrite(buf, len, 1, w->file) != 1);
+
+  if(w->timed)  w->write_sec += txw_now() - t;
+
+  if(!r)  w->written += len;
+
+  return r;
+}
+
+
+static void * txw_async_thread(void *arg)
+{
+  int err;
+
+  struct txw_async *a;
+
+
+  a = (struct txw_async *)arg;
+
+  pthread_mutex_lock(&a->lock);
+
+  while(1)
+  {
+    while((a->job == NULL) && (!a->stop))
+    {
+      pthread_cond_wait(&a->cond, &a->lock);
+    }
+
+    if(a->job == NULL)  break;
+
+    pthread_mutex_unlock(&a->lock);
+
+    err = (fwrite(a->job, a->job_len, 1, a->job_file) != 1);
+
+    pthread_mutex_lock(&a->lock);
+
+    if(err)
+    {
+      a->error = 1;
+    }
+    else
+    {
+      a->written += a->job_len;
+    }
+    a->job = NULL;
+    pthread_cond_broadcast(&a->cond);
+  }
+
+  pthread_mutex_unlock(&a->lock);
+
+  return NULL;
+}
+
+
+/* waits until the write thread is idle and takes over its error and byte count */
+static void txw_async_wait(struct txw *w)
+{
+  double t=0.0;
+
+  struct txw_async *a;
+
+
+  a = w->async;
+
+  if(w->timed)  t = txw_now();
+
+  pthread_mutex_lock(&a->lock);
+  while(a->job != NULL)
+  {
+    pthread_cond_wait(&a->cond, &a->lock);
+  }
+  if(a->error)  w->error = 1;
+  a->error = 0;
+  w->written += a->written;
+  a->written = 0;
+  pthread_mutex_unlock(&a->lock);
+
+  if(w->timed)  w->write_sec += txw_now() - t;
+}
+
+
+/* hands the filled buffer to the write thread and continues with the spare one */
+static void txw_async_submit(struct txw *w)
+{
+  char *buf;
+
+  long long size;
+
+  struct txw_async *a;
+
+
+  a = w->async;
+
+  txw_async_wait(w);
+
+  if(w->error)
+  {
+    w->len = 0;
+    return;
+  }
+
+  buf = w->buf;
+  size = w->size;
+  w->buf = a->spare;
+  w->size = a->spare_size;
+  a->spare = buf;
+  a->spare_size = size;
+
+  pthread_mutex_lock(&a->lock);
+  a->job = buf;
+  a->job_len = w->len;
+  a->job_file = w->file;
+  pthread_cond_broadcast(&a->cond);
+  pthread_mutex_unlock(&a->lock);
+
+  w->len = 0;
+}
+
+
+int txw_init(struct txw *w, FILE *file, long long size)
+{
+  memset(w, 0, sizeof(struct txw));
+
+  if(size < (TXW_MAX_ITEM * 2))  size = TXW_MAX_ITEM * 2;
+
+  w->buf = (char *)malloc(size);
+  if(w->buf == NULL)
+  {
+    w->error = 1;
+    return -1;
+  }
+
+  w->file = file;
+  w->size = size;
+  w->time_sec = -1LL;
+
+  return 0;
+}
+
+
+void txw_free(struct txw *w)
+{
+  txw_async_stop(w);
+  free(w->buf);
+  w->buf = NULL;
+  w->len = 0;
+  w->size = 0;
+}
+
+
+void txw_reset(struct txw *w, FILE *file)
+{
+  /* the file of a pending write may be closed after this */
+  if(w->async != NULL)  txw_async_wait(w);
+
+  w->file = file;
+  w->len = 0;
+  w->error = 0;
+  w->time_sec = -1LL;
+  w->written = 0;
+  w->write_sec = 0.0;
+}
+
+
+/* writes the buffer, or hands it to the write thread without waiting for it */
+static void txw_drain(struct txw *w)
+{
+  if((w->file == NULL) || (!w->len))  return;
+
+  if(w->async != NULL)
+  {
+    txw_async_submit(w);
+
+    return;
+  }
+
+  if(txw_fwrite(w, w->buf, w->len))
+  {
+    w->error = 1;
+  }
+  w->len = 0;
+}
+
+
+int txw_flush(struct txw *w)
+{
+  txw_drain(w);
+
+  if(w->async != NULL)  txw_async_wait(w);
+
+  return w->error;
+}
+
+
+int txw_async_start(struct txw *w)
+{
+  struct txw_async *a;
+
+
+  if(w->async != NULL)  return 0;
+
+  a = (struct txw_async *)calloc(1, sizeof(struct txw_async));
+  if(a == NULL)  return -1;
+
+  a->spare_size = w->size;
+  a->spare = (char *)malloc(a->spare_size);
+  if(a->spare == NULL)
+  {
+    free(a);
+    return -1;
+  }
+
+  pthread_mutex_init(&a->lock, NULL);
+  pthread_cond_init(&a->cond, NULL);
+
+  if(pthread_create(&a->thread, NULL, txw_async_thread, a))
+  {
+    pthread_mutex_destroy(&a->lock);
+    pthread_cond_destroy(&a->cond);
+    free(a->spare);
+    free(a);
+    return -1;
+  }
+
+  w->async = a;
+
+  return 0;
+}
+
+
+int txw_async_stop(struct txw *w)
+{
+  int err;
+
+  struct txw_async *a;
+
+
+  a = w->async;
+  if(a == NULL)  return w->error;
+
+  err = txw_flush(w);
+
+  pthread_mutex_lock(&a->lock);
+  a->stop = 1;
+  pthread_cond_broadcast(&a->cond);
+  pthread_mutex_unlock(&a->lock);
+
+  pthread_join(a->thread, NULL);
+
+  pthread_mutex_destroy(&a->lock);
+  pthread_cond_destroy(&a->cond);
+  free(a->spare);
+  free(a);
+
+  w->async = NULL;
+
+  return err;
+}
+
+
+int txw_reserve(struct txw *w, long long n)
+{
+  long long size;
+
+  char *tmp;
+
+
+  if((w->len + n) <= w->size)  return 0;
+
+  if(w->error)  return -1;
+
+  if(w->file != NULL)
+  {
+    txw_drain(w);
+
+    if(n <= w->size)  return w->error;
+  }
+
+  size = w->size * 2;
+  while(size < (w->len + n))  size *= 2;
+
+  tmp = (char *)realloc(w->buf, size);
+  if(tmp == NULL)
+  {
+    w->error = 1;
+    return -1;
+  }
+
+  w->buf = tmp;
+  w->size = size;
+
+  return 0;
+}
+
+
+/* writes the decimal digits of val to dest, returns the number of digits */
+static int txw_utoa(char *dest, unsigned long long val)
+{
+  char tmp[24];
+
+  int i=24, n;
+
+
+  while(val >= 100ULL)
+  {
+    i -= 2;
+    memcpy(tmp + i, digit_pairs + (val % 100ULL) * 2, 2);
+    val /= 100ULL;
+  }
+
+  if(val >= 10ULL)
+  {
+    i -= 2;
+    memcpy(tmp + i, digit_pairs + val * 2, 2);
+  }
+  else
+  {
+    tmp[--i] = '0' + val;
+  }
+
+  n = 24 - i;
+
+  memcpy(dest, tmp + i, n);
+
+  return n;
+}
+
+
+/* writes exactly n decimal digits of val, with leading zeros */
+static void txw_utoa_fixed(char *dest, unsigned long long val, int n)
+{
+  while(n >= 2)
+  {
+    n -= 2;
+    memcpy(dest + n, digit_pairs + (val % 100ULL) * 2, 2);
+    val /= 100ULL;
+  }
+
+  if(n)
+  {
+    dest[0] = '0' + (val % 10ULL);
+  }
+}
+
+
+void txw_int(struct txw *w, long long val)
+{
+  char *p;
+
+
+  if(txw_reserve(w, 24))  return;
+
+  p = w->buf + w->len;
+
+  if(val < 0)
+  {
+    *p++ = '-';
+    w->len++;
+
+    w->len += txw_utoa(p, -(unsigned long long)val);
+  }
+  else
+  {
+    w->len += txw_utoa(p, val);
+  }
+}
+
+
+void txw_double(struct txw *w, double val, int prec)
+{
+  double a, ip, fp, scaled, rnd, diff;
+
+  unsigned long long ipart, fpart;
+
+  char *p;
+
+
+  if(txw_reserve(w, TXW_MAX_ITEM))  return;
+
+  a = fabs(val);
+
+  /* the integer and fractional part are split exactly, the only inexact step is */
+  /* the scaling of the fraction, which is off by far less than 1e-6 of a unit,  */
+  /* so rounding can only be wrong when the scaled fraction is that close to .5  */
+  if((a < 1e15) && (prec >= 0) && (prec <= 9))
+  {
+    ip = floor(a);
+    fp = a - ip;
+    scaled = fp * pow10_tbl[prec];
+    rnd = floor(scaled);
+    diff = scaled - rnd;
+
+    if(fabs(diff - 0.5) > 1e-6)
+    {
+      ipart = (unsigned long long)ip;
+      fpart = (unsigned long long)rnd;
+      if(diff > 0.5)  fpart++;
+      if(fpart >= pow10_int[prec])
+      {
+        fpart -= pow10_int[prec];
+        ipart++;
+      }
+
+      p = w->buf + w->len;
+
+      if(signbit(val))  *p++ = '-';
+
+      p += txw_utoa(p, ipart);
+
+      if(prec)
+      {
+        *p++ = '.';
+        txw_utoa_fixed(p, fpart, prec);
+        p += prec;
+      }
+
+      w->len = p - w->buf;
+
+      return;
+    }
+  }
+
+  w->len += txw_snprintf(w->buf + w->len, TXW_MAX_ITEM, "%.*f", prec, val);
+}
+
+
+void txw_time(struct txw *w, long long t)
+{
+  long long sec;
+
+  char *p;
+
+
+  if(txw_reserve(w, 48))  return;
+
+  if(t < 0)
+  {
+    w->len += txw_snprintf(w->buf + w->len, 48, "%lli.%09lli", t / 1000000000LL, t % 1000000000LL);
+
+    return;
+  }
+
+  sec = t / 1000000000LL;
+
+  /* consecutive timestamps mostly share the same integer part */
+  if(sec != w->time_sec)
+  {
+    w->time_txt_len = txw_utoa(w->time_txt, sec);
+    w->time_txt[w->time_txt_len++] = '.';
+    w->time_sec = sec;
+  }
+
+  p = w->buf + w->len;
+
+  memcpy(p, w->time_txt, w->time_txt_len);
+  p += w->time_txt_len;
+
+  txw_utoa_fixed(p, t - (sec * 1000000000LL), 9);
+
+  w->len += w->time_txt_len + 9;
+}
+
+
+void txw_append(struct txw *w, const struct txw *src)
+{
+  if(!src->len)  return;
+
+  if((w->file != NULL) && (src->len >= (w->size / 2)))
+  {
+    if(txw_flush(w))  return;
+
+    if(txw_fwrite(w, src->buf, src->len))
+    {
+      w->error = 1;
+    }
+
+    return;
+  }
+
+  txw_write(w, src->buf, src->len);
+}
+
+
+int txw_printf(struct txw *w, const char *fmt, ...)
+{
+  int n;
+
+  va_list ap;
+
+
+  if(txw_reserve(w, TXW_MAX_ITEM))  return -1;
+
+  va_start(ap, fmt);
+  n = txw_vsnprintf(w->buf + w->len, w->size - w->len, fmt, ap);
+  va_end(ap);
+
+  if(n < 0)
+  {
+    w->error = 1;
+    return -1;
+  }
+
+  if(n >= (w->size - w->len))
+  {
+    if(txw_reserve(w, n + 1))  return -1;
+
+    va_start(ap, fmt);
+    n = txw_vsnprintf(w->buf + w->len, w->size - w->len, fmt, ap);
+    va_end(ap);
+  }
+
+  w->len += n;
+
+  return n;
+}
@@ -0,0 +1,135 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2007 - 2021 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3 of the License.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+/*
+ * Buffered text output for the ASCII export.
+ *
+ * The number formatters produce exactly the same bytes as printf("%.*f")
+ * and printf("%lli.%09lli") in the "C" locale, but without going through
+ * the printf machinery for every sample. Values for which the fast path
+ * can not guarantee correct rounding are passed on to snprintf().
+ *
+ * When file is NULL the buffer grows instead of being flushed, so the
+ * text can be produced in memory and written out later.
+ */
+
+
+#ifndef TXTWRITER_INCLUDED
+#define TXTWRITER_INCLUDED
+
+
+#include <stdio.h>
+#include <string.h>
+
+
+#define TXW_BUFSIZE     (1024 * 1024)
+
+/* the longest item the formatters write in one go */
+#define TXW_MAX_ITEM    (384)
+
+
+struct txw_async;
+
+
+struct txw{
+         FILE *file;
+         char *buf;
+         long long len;
+         long long size;
+         int error;
+         long long time_sec;        /* cache for the integer part of the last timestamp */
+         char time_txt[24];
+         int time_txt_len;
+         long long written;         /* bytes written to the file since the last reset */
+         int timed;                 /* measure the time spent in fwrite() */
+         double write_sec;          /* with a write thread, the time spent waiting for it */
+         struct txw_async *async;   /* the thread that writes full buffers, NULL when they are written in place */
+       };
+
+
+int txw_init(struct txw *w, FILE *file, long long size);
+
+void txw_free(struct txw *w);
+
+/* empties the buffer and clears the error and the counters, the text goes to file from now on */
+void txw_reset(struct txw *w, FILE *file);
+
+/* writes the buffer to the file, returns non-zero when a write error occurred now or before */
+/* with a write thread it returns when the thread has written everything                      */
+int txw_flush(struct txw *w);
+
+/* from now on a full buffer is handed to a thread that writes it while the next one is */
+/* filled, so formatting and writing overlap, does nothing when the thread is running  */
+int txw_async_start(struct txw *w);
+
+/* writes what is pending and stops the write thread, returns non-zero on a write error */
+int txw_async_stop(struct txw *w);
+
+/* makes room for at least n bytes, flushing or growing the buffer */
+int txw_reserve(struct txw *w, long long n);
+
+/* same as printf("%.*f", prec, val), prec must be in the range 0 to 9 */
+void txw_double(struct txw *w, double val, int prec);
+
+/* same as printf("%lli.%09lli", t / 1000000000LL, t % 1000000000LL) */
+void txw_time(struct txw *w, long long t);
+
+void txw_int(struct txw *w, long long val);
+
+/* appends the text collected in src, large blocks are written to the file directly */
+void txw_append(struct txw *w, const struct txw *src);
+
+int txw_printf(struct txw *w, const char *fmt, ...)
+#if defined(__GNUC__)
+  __attribute__((format(printf, 2, 3)))
+#endif
+  ;
+
+
+static inline void txw_putc(struct txw *w, char c)
+{
+  if((w->len >= w->size) && txw_reserve(w, 1))  return;
+
+  w->buf[w->len++] = c;
+}
+
+
+static inline void txw_write(struct txw *w, const char *str, long long n)
+{
+  if(((w->len + n) > w->size) && txw_reserve(w, n))  return;
+
+  memcpy(w->buf + w->len, str, n);
+  w->len += n;
+}
+
+
+static inline void txw_puts(struct txw *w, const char *str)
+{
+  txw_write(w, str, strlen(str));
+}
+
+
+#endif
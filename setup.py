@@ -0,0 +1,27 @@
+"""Build configuration for the optional native EDF/BDF reader.
+
+All package metadata lives in pyproject.toml. This file only adds the
+`python_eyelinkparser._edfread` extension, which is compiled from the
+libedfread sources in converter/edf2ascii_ver16_source. The extension is
+optional: when it can not be built the package installs without it and
+`python_eyelinkparser.edfreader` raises an ImportError when used.
+"""
+
+from setuptools import setup, Extension
+
+EDFREAD_DIR = 'converter/edf2ascii_ver16_source'
+
+setup(
+    ext_modules=[
+        Extension(
+            'python_eyelinkparser._edfread',
+            sources=[
+                'src/python_eyelinkparser/_edfread.c',
+                EDFREAD_DIR + '/edfread.c',
+                EDFREAD_DIR + '/edfdecode.c',
+            ],
+            include_dirs=[EDFREAD_DIR],
+            optional=True,
+        )
+    ]
+)
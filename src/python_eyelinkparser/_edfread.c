@@ -0,0 +1,486 @@
+/*
+ * This file is part of eyelinkparser.
+ *
+ * eyelinkparser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eyelinkparser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with datamatrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Native reader for EDF(+)/BDF(+) files (European Data Format), built on
+ * libedfread from converter/edf2ascii_ver16_source. The samples are decoded
+ * straight into one contiguous array per signal and handed to Python through
+ * the buffer protocol, so numpy.frombuffer() wraps them without a copy.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "edfread.h"
+
+
+/* a contiguous one-dimensional array of float64, float32 or int64 values */
+typedef struct {
+  PyObject_HEAD
+  char *data;
+  Py_ssize_t length;
+  Py_ssize_t itemsize;
+  char format[2];
+  int exports;
+} SampleBuffer;
+
+
+static void
+SampleBuffer_dealloc(SampleBuffer *self)
+{
+  free(self->data);
+  Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+static int
+SampleBuffer_getbuffer(SampleBuffer *self, Py_buffer *view, int flags)
+{
+  view->obj = (PyObject *)self;
+  Py_INCREF(self);
+  view->buf = self->data;
+  view->len = self->length * self->itemsize;
+  view->readonly = 0;
+  view->itemsize = self->itemsize;
+  view->format = (flags & PyBUF_FORMAT) ? self->format : NULL;
+  view->ndim = 1;
+  view->shape = (flags & PyBUF_ND) ? &self->length : NULL;
+  view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? &self->itemsize : NULL;
+  view->suboffsets = NULL;
+  view->internal = NULL;
+  self->exports++;
+  return 0;
+}
+
+
+static void
+SampleBuffer_releasebuffer(SampleBuffer *self, Py_buffer *view)
+{
+  (void)view;
+  self->exports--;
+}
+
+
+static Py_ssize_t
+SampleBuffer_length(SampleBuffer *self)
+{
+  return self->length;
+}
+
+
+static PyBufferProcs SampleBuffer_as_buffer = {
+  (getbufferproc)SampleBuffer_getbuffer,
+  (releasebufferproc)SampleBuffer_releasebuffer,
+};
+
+
+static PySequenceMethods SampleBuffer_as_sequence = {
+  .sq_length = (lenfunc)SampleBuffer_length,
+};
+
+
+static PyTypeObject SampleBufferType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  .tp_name = "python_eyelinkparser._edfread.SampleBuffer",
+  .tp_basicsize = sizeof(SampleBuffer),
+  .tp_dealloc = (destructor)SampleBuffer_dealloc,
+  .tp_as_sequence = &SampleBuffer_as_sequence,
+  .tp_as_buffer = &SampleBuffer_as_buffer,
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_doc = "A contiguous array of decoded values, exposed through the buffer protocol.",
+};
+
+
+/* allocates the array without Python objects, so it can be done without the GIL */
+static int
+buffer_alloc(SampleBuffer *self, Py_ssize_t length, Py_ssize_t itemsize, char format)
+{
+  self->length = length;
+  self->itemsize = itemsize;
+  self->format[0] = format;
+  self->format[1] = 0;
+  if (length > (PY_SSIZE_T_MAX / itemsize))
+    return -1;
+  self->data = (char *)malloc((length > 0) ? (length * itemsize) : 1);
+  return (self->data == NULL) ? -1 : 0;
+}
+
+
+/* a header field without the padding, header fields are plain ASCII */
+static PyObject *
+header_str(const char *field, int len)
+{
+  while ((len > 0) && (field[len - 1] == ' '))
+    len--;
+  return PyUnicode_DecodeLatin1(field, len, "replace");
+}
+
+
+static int
+add_str(PyObject *dict, const char *key, const char *field, int len)
+{
+  int err;
+  PyObject *val = header_str(field, len);
+
+  if (val == NULL)
+    return -1;
+  err = PyDict_SetItemString(dict, key, val);
+  Py_DECREF(val);
+  return err;
+}
+
+
+static int
+add_obj(PyObject *dict, const char *key, PyObject *val)
+{
+  int err;
+
+  if (val == NULL)
+    return -1;
+  err = PyDict_SetItemString(dict, key, val);
+  Py_DECREF(val);
+  return err;
+}
+
+
+/* labels match as in the -s option of edf2ascii, whatever the case of the letters */
+static int
+label_equal(const char *label, const char *name, Py_ssize_t len)
+{
+  Py_ssize_t i;
+
+  for (i = 0; i < len; i++) {
+    if (Py_TOLOWER(label[i]) != Py_TOLOWER(name[i]))
+      return 0;
+  }
+  return 1;
+}
+
+
+/* sets the flags of the signals asked for, by 1-based signal number or by label */
+static int
+select_signals(const struct edfrd_hdr *hdr, PyObject *signals, int *selected)
+{
+  int i, j, found, len;
+  long nr;
+  const char *label, *name;
+  Py_ssize_t name_len;
+  PyObject *seq, *item;
+
+  for (i = 0; i < hdr->signals; i++)
+    selected[i] = (signals == Py_None) && !hdr->param[i].annotation;
+  if (signals == Py_None)
+    return 0;
+
+  seq = PySequence_Fast(signals, "signals must be a sequence of signal numbers or labels");
+  if (seq == NULL)
+    return -1;
+  for (i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+    item = PySequence_Fast_GET_ITEM(seq, i);
+    if (PyLong_Check(item)) {
+      nr = PyLong_AsLong(item);
+      if ((nr < 1) || (nr > hdr->signals) || hdr->param[nr - 1].annotation) {
+        PyErr_Format(PyExc_ValueError, "there is no data signal %ld in this file", nr);
+        goto error;
+      }
+      selected[nr - 1] = 1;
+      continue;
+    }
+    if (!PyUnicode_Check(item)) {
+      PyErr_SetString(PyExc_TypeError, "signals must be a sequence of signal numbers or labels");
+      goto error;
+    }
+    name = PyUnicode_AsUTF8AndSize(item, &name_len);
+    if (name == NULL)
+      goto error;
+    found = 0;
+    for (j = 0; j < hdr->signals; j++) {
+      if (hdr->param[j].annotation)
+        continue;
+      label = hdr->raw + 256 + (j * 16);
+      for (len = 16; (len > 0) && (label[len - 1] == ' '); len--)
+        ;
+      if ((len == name_len) && label_equal(label, name, len)) {
+        selected[j] = 1;
+        found = 1;
+      }
+    }
+    if (!found) {
+      PyErr_Format(PyExc_ValueError, "there is no signal with label '%U' in this file", item);
+      goto error;
+    }
+  }
+  Py_DECREF(seq);
+  return 0;
+
+error:
+  Py_DECREF(seq);
+  return -1;
+}
+
+
+static int
+add_annotation(void *ctx, const struct edfrd_annot *annot)
+{
+  PyObject *list = (PyObject *)ctx;
+  PyObject *tuple;
+  int err;
+
+  tuple = Py_BuildValue(
+    "(dNN)",
+    (double)annot->onset / EDFRD_FP_SCALING,
+    annot->duration_len ? PyFloat_FromDouble((double)annot->duration / EDFRD_FP_SCALING)
+                        : (Py_INCREF(Py_None), Py_None),
+    PyUnicode_DecodeUTF8(annot->text, annot->text_len, "replace"));
+  if (tuple == NULL)
+    return -1;
+  err = PyList_Append(list, tuple);
+  Py_DECREF(tuple);
+  return err;
+}
+
+
+PyDoc_STRVAR(read_doc,
+"read(path, signals=None, float32=False)\n"
+"\n"
+"Reads an EDF(+) or BDF(+) file and returns a dict with the header fields,\n"
+"a list of signals and, for EDF+/BDF+ files, the annotations as a list of\n"
+"(onset, duration, text) tuples in seconds. Every signal is a dict with its\n"
+"header fields and a 'data' buffer holding the physical values of all\n"
+"datarecords. 'record_starts' holds the start time of every datarecord in\n"
+"nanoseconds. signals selects data signals by 1-based number or by label,\n"
+"ignoring case.");
+
+
+static PyObject *
+edfread_read(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+  static char *kwlist[] = {"path", "signals", "float32", NULL};
+  PyObject *path_obj = NULL, *signals = Py_None, *result = NULL;
+  PyObject *siglist = NULL, *annots = NULL, *sig, *val;
+  SampleBuffer **bufs = NULL, *starts = NULL;
+  struct edfrd_file *hdl = NULL;
+  const struct edfrd_hdr *hdr;
+  const struct edfrd_param *param;
+  const char *raw, *rec;
+  char errbuf[256];
+  int float32 = 0, *selected = NULL, i, n, ns, err = 0, recnr;
+  long long t;
+  double duration;
+
+  (void)self;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&|Op", kwlist,
+                                   PyUnicode_FSConverter, &path_obj, &signals, &float32))
+    return NULL;
+
+  Py_BEGIN_ALLOW_THREADS
+  hdl = edfrd_open(PyBytes_AS_STRING(path_obj), errbuf, sizeof(errbuf));
+  Py_END_ALLOW_THREADS
+  if (hdl == NULL) {
+    PyErr_SetString(PyExc_OSError, errbuf);
+    goto out;
+  }
+  hdr = edfrd_header(hdl);
+  param = hdr->param;
+  raw = hdr->raw;
+  ns = hdr->signals;
+
+  selected = (int *)calloc(ns, sizeof(int));
+  bufs = (SampleBuffer **)calloc(ns, sizeof(SampleBuffer *));
+  if ((selected == NULL) || (bufs == NULL)) {
+    PyErr_NoMemory();
+    goto out;
+  }
+  if (select_signals(hdr, signals, selected))
+    goto out;
+  if ((signals != Py_None) && edfrd_select_signals(hdl, selected)) {
+    PyErr_SetString(PyExc_MemoryError, edfrd_errmsg(hdl));
+    goto out;
+  }
+
+  starts = PyObject_New(SampleBuffer, &SampleBufferType);
+  if (starts == NULL)
+    goto out;
+  starts->data = NULL;
+  starts->exports = 0;
+  if (buffer_alloc(starts, hdr->datarecords, sizeof(long long), 'q')) {
+    PyErr_NoMemory();
+    goto out;
+  }
+  for (i = 0; i < ns; i++) {
+    if (!selected[i])
+      continue;
+    bufs[i] = PyObject_New(SampleBuffer, &SampleBufferType);
+    if (bufs[i] == NULL)
+      goto out;
+    bufs[i]->data = NULL;
+    bufs[i]->exports = 0;
+    if (buffer_alloc(bufs[i], (Py_ssize_t)hdr->datarecords * param[i].smp_per_record,
+                     float32 ? sizeof(float) : sizeof(double), float32 ? 'f' : 'd')) {
+      PyErr_NoMemory();
+      goto out;
+    }
+  }
+
+  /* the decoding does not touch Python objects */
+  Py_BEGIN_ALLOW_THREADS
+  for (recnr = 0; recnr < hdr->datarecords; recnr++) {
+    err = edfrd_read_record(hdl, &rec);
+    if (!err)
+      err = edfrd_record_starttime(hdl, rec, recnr, &t);
+    if (err)
+      break;
+    ((long long *)starts->data)[recnr] = t;
+    for (i = 0; i < ns; i++) {
+      if (bufs[i] == NULL)
+        continue;
+      if (float32)
+        edfrd_decode_physical_f(hdr, rec, i, (float *)bufs[i]->data + (long long)recnr * param[i].smp_per_record);
+      else
+        edfrd_decode_physical(hdr, rec, i, (double *)bufs[i]->data + (long long)recnr * param[i].smp_per_record);
+    }
+  }
+  Py_END_ALLOW_THREADS
+  if (err) {
+    PyErr_SetString(PyExc_OSError, edfrd_errmsg(hdl));
+    goto out;
+  }
+
+  annots = PyList_New(0);
+  if (annots == NULL)
+    goto out;
+  if (hdr->plus) {
+    edfrd_seek_record(hdl, 0);
+    for (recnr = 0; recnr < hdr->datarecords; recnr++) {
+      if (edfrd_read_record(hdl, &rec)) {
+        PyErr_SetString(PyExc_OSError, edfrd_errmsg(hdl));
+        goto out;
+      }
+      err = edfrd_record_annotation_views(hdl, rec, add_annotation, annots);
+      if (err) {
+        if (!PyErr_Occurred())
+          PyErr_SetString(PyExc_ValueError, edfrd_errmsg(hdl));
+        goto out;
+      }
+    }
+  }
+
+  duration = (double)hdr->data_record_duration / EDFRD_FP_SCALING;
+  siglist = PyList_New(0);
+  result = PyDict_New();
+  if ((siglist == NULL) || (result == NULL))
+    goto fail;
+  if (add_obj(result, "filetype", PyUnicode_FromString(
+                (hdr->filetype == EDFRD_FILETYPE_BDF) ? (hdr->plus ? "BDF+" : "BDF") : (hdr->plus ? "EDF+" : "EDF")))
+      || add_obj(result, "discontinuous", PyBool_FromLong(hdr->discontinuous))
+      || add_str(result, "patient", raw + 8, 80)
+      || add_str(result, "recording", raw + 88, 80)
+      || add_str(result, "startdate", raw + 168, 8)
+      || add_str(result, "starttime", raw + 176, 8)
+      || add_obj(result, "datarecords", PyLong_FromLong(hdr->datarecords))
+      || add_obj(result, "record_duration", PyFloat_FromDouble(duration))
+      || PyDict_SetItemString(result, "record_starts", (PyObject *)starts))
+    goto fail;
+  for (i = 0; i < ns; i++) {
+    if (bufs[i] == NULL)
+      continue;
+    sig = PyDict_New();
+    if (sig == NULL)
+      goto fail;
+    n = PyList_Append(siglist, sig);
+    Py_DECREF(sig);
+    if (n
+        || add_obj(sig, "signal", PyLong_FromLong(i + 1))
+        || add_str(sig, "label", raw + 256 + (i * 16), 16)
+        || add_str(sig, "transducer", raw + 256 + (ns * 16) + (i * 80), 80)
+        || add_str(sig, "units", raw + 256 + (ns * 96) + (i * 8), 8)
+        || add_obj(sig, "phys_min", PyFloat_FromDouble(param[i].phys_min))
+        || add_obj(sig, "phys_max", PyFloat_FromDouble(param[i].phys_max))
+        || add_obj(sig, "dig_min", PyLong_FromLong(param[i].dig_min))
+        || add_obj(sig, "dig_max", PyLong_FromLong(param[i].dig_max))
+        || add_str(sig, "prefilter", raw + 256 + (ns * 136) + (i * 80), 80)
+        || add_obj(sig, "smp_per_record", PyLong_FromLong(param[i].smp_per_record))
+        || add_obj(sig, "sample_rate", PyFloat_FromDouble(
+             (duration > 0.0) ? (param[i].smp_per_record / duration) : 0.0))
+        || PyDict_SetItemString(sig, "data", (PyObject *)bufs[i]))
+      goto fail;
+  }
+  val = siglist;
+  siglist = NULL;
+  if (add_obj(result, "signals", val))
+    goto fail;
+  val = annots;
+  annots = NULL;
+  if (add_obj(result, "annotations", val))
+    goto fail;
+  goto out;
+
+fail:
+  Py_CLEAR(result);
+
+out:
+  if (bufs != NULL) {
+    for (i = 0; i < ns; i++)
+      Py_XDECREF(bufs[i]);
+  }
+  Py_XDECREF(starts);
+  Py_XDECREF(siglist);
+  Py_XDECREF(annots);
+  free(bufs);
+  free(selected);
+  edfrd_close(hdl);
+  Py_XDECREF(path_obj);
+  return result;
+}
+
+
+static PyMethodDef edfread_methods[] = {
+  {"read", (PyCFunction)(void (*)(void))edfread_read, METH_VARARGS | METH_KEYWORDS, read_doc},
+  {NULL, NULL, 0, NULL}
+};
+
+
+static struct PyModuleDef edfread_module = {
+  PyModuleDef_HEAD_INIT,
+  .m_name = "_edfread",
+  .m_doc = "Native EDF(+)/BDF(+) reader.",
+  .m_size = -1,
+  .m_methods = edfread_methods,
+};
+
+
+PyMODINIT_FUNC
+PyInit__edfread(void)
+{
+  PyObject *m;
+
+  if (PyType_Ready(&SampleBufferType) < 0)
+    return NULL;
+  m = PyModule_Create(&edfread_module);
+  if (m == NULL)
+    return NULL;
+  Py_INCREF(&SampleBufferType);
+  if (PyModule_AddObject(m, "SampleBuffer", (PyObject *)&SampleBufferType) < 0) {
+    Py_DECREF(&SampleBufferType);
+    Py_DECREF(m);
+    return NULL;
+  }
+  return m;
+}
@@ -0,0 +1,164 @@
+# -*- coding: utf-8 -*-
+
+"""
+This file is part of eyelinkparser.
+
+eyelinkparser is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+eyelinkparser is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with datamatrix.  If not, see <http://www.gnu.org/licenses/>.
+"""
+
+import numpy as np
+try:
+    from python_eyelinkparser import _edfread
+except ImportError:
+    _edfread = None
+
+
+def available():
+    """Returns True when the native EDF/BDF reader has been built."""
+    return _edfread is not None
+
+
+def read_edf(path, signals=None, dtype=np.float64):
+    """Reads an EDF(+) or BDF(+) file (European Data Format) into memory.
+    
+    The samples are decoded by the native `_edfread` extension straight into
+    one array per signal. No ASCII conversion or temporary files are
+    involved, and the arrays wrap the decoded buffers without copying.
+    
+    Note that this reads EDF(+)/BDF(+) files as read by `edf2ascii`, not
+    EyeLink .edf files.
+    
+    Parameters
+    ----------
+    path: str
+        The path to an .edf or .bdf file.
+    signals: list, optional
+        Data signals to read, by 1-based signal number or by label. Labels
+        are matched ignoring case, as by `edf2ascii -s`. By default all data
+        signals are read.
+    dtype: numpy dtype, optional
+        np.float64 (default) or np.float32.
+    
+    Returns
+    -------
+    dict
+        The header fields, `signals` (a list of dicts with the signal header
+        fields and the samples as a `data` array), `annotations` (a list of
+        `(onset, duration, text)` tuples in seconds) and `record_starts` (the
+        start time of every datarecord in nanoseconds).
+    """
+    if _edfread is None:
+        raise ImportError(
+            'the native EDF reader (python_eyelinkparser._edfread) is not '
+            'available, it requires a C compiler when installing')
+    dtype = np.dtype(dtype)
+    if dtype not in (np.float64, np.float32):
+        raise ValueError('dtype must be float64 or float32')
+    recording = _edfread.read(path, signals=signals,
+                              float32=dtype == np.float32)
+    recording['record_starts'] = np.frombuffer(recording['record_starts'],
+                                               dtype=np.int64)
+    for signal in recording['signals']:
+        signal['data'] = np.frombuffer(signal['data'], dtype=dtype)
+    return recording
+
+
+def sample_times(recording, signal):
+    """Returns the time of every sample of a signal returned by `read_edf()`,
+    in seconds from the start of the file. Gaps in EDF+D/BDF+D files are
+    taken into account.
+    """
+    n = signal['smp_per_record']
+    duration = recording['record_duration']
+    offsets = np.arange(n) * (duration / n)
+    starts = recording['record_starts'] / 1e9
+    return (starts[:, None] + offsets[None, :]).ravel()
+
+
+def read_pyramid(path):
+    """Opens a `_pyramid.bin` file, as written by `edf2ascii --pyramid`, without
+    reading the bins themselves.
+    
+    The pyramid holds the min, max and mean of every signal per 16, 32, 64,
+    ... samples, counted from the first datarecord that was converted. Use
+    `pyramid_level()` to get the bins for drawing at a certain resolution.
+    
+    Parameters
+    ----------
+    path: str
+        The path to a `_pyramid.bin` file.
+    
+    Returns
+    -------
+    dict
+        `block` (the samples per bin of level 0), `record_duration` (in
+        nanoseconds), `first_record` and `signals`, a list of dicts with the
+        `signal` number, `smp_per_record`, `samples` and `levels`, a list with
+        a memory-mapped array of shape (bins, 3) per level: min, max and mean.
+    """
+    with open(path, 'rb') as fd:
+        head = fd.read(40)
+    if head[:8] != b'EDFPYR01':
+        raise ValueError('{} is not a pyramid file'.format(path))
+    order = '<' if np.frombuffer(head, '<i4', 1, 8)[0] == 0x01020304 \
+        else '>'
+    block, nsignals = np.frombuffer(head, order + 'i4', 2, 12)
+    record_duration, first_record = np.frombuffer(head, order + 'i8', 2, 24)
+    entries = np.memmap(path, dtype=np.dtype([
+        ('signal', order + 'i4'), ('smp_per_record', order + 'i4'),
+        ('levels', order + 'i4'), ('reserved', order + 'i4'),
+        ('samples', order + 'i8'), ('table', order + 'i8')]),
+        mode='r', offset=40, shape=(int(nsignals),))
+    signals = []
+    for entry in entries:
+        samples = int(entry['samples'])
+        table = np.memmap(path, dtype=order + 'i8', mode='r',
+                          offset=int(entry['table']),
+                          shape=(int(entry['levels']), 2)) \
+            if entry['levels'] else np.zeros((0, 2), dtype=np.int64)
+        levels = []
+        for k, (offset, _) in enumerate(table):
+            span = int(block) << k
+            bins = (samples + span - 1) // span
+            levels.append(np.memmap(path, dtype=order + 'f4', mode='r',
+                                    offset=int(offset), shape=(bins, 3))
+                          if bins else np.zeros((0, 3), dtype=np.float32))
+        signals.append({'signal': int(entry['signal']),
+                        'smp_per_record': int(entry['smp_per_record']),
+                        'samples': samples,
+                        'levels': levels})
+    return {'block': int(block),
+            'record_duration': int(record_duration),
+            'first_record': int(first_record),
+            'signals': signals}
+
+
+def pyramid_level(pyramid, signal, max_bins):
+    """Returns the finest level of a signal of `read_pyramid()` that has at
+    most `max_bins` bins, for example the width of a plot in pixels. A
+    ValueError is raised when even the coarsest level has more bins.
+    
+    Returns
+    -------
+    tuple
+        The samples per bin and an array of shape (bins, 3): min, max and mean.
+    """
+    levels = signal['levels']
+    if not levels:
+        raise ValueError('the signal has no samples')
+    for k, level in enumerate(levels):
+        if len(level) <= max_bins:
+            return pyramid['block'] << k, level
+    raise ValueError('no level has at most {} bins, the coarsest has {}'
+                     .format(max_bins, len(levels[-1])))
@@ -0,0 +1,227 @@
+# -*- coding: utf-8 -*-
+
+"""
+This file is part of eyelinkparser.
+
+eyelinkparser is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+eyelinkparser is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with datamatrix.  If not, see <http://www.gnu.org/licenses/>.
+"""
+
+import os
+import json
+import shutil
+import hashlib
+import logging
+import tempfile
+
+# Bump this when the layout of the cache changes, so that old entries are
+# simply not found anymore
+CACHE_VERSION = 2
+CHUNK_SIZE = 1024 * 1024
+
+
+class ConversionCache(object):
+    """A cache of converted files, such as the .asc files that `edf2asc`
+    makes of .edf files.
+
+    An entry is keyed by the SHA-256 hash of the content of the input file
+    together with the conversion command, so that a changed file or
+    different options are never served from the cache, while the same
+    recording under another name or in another folder is. An entry is a
+    folder that holds the converted file under the name it was asked for, so
+    that the file keeps the name of the recording. Hashing a file is skipped
+    when its path, size and modification time are the same as when it was
+    hashed before.
+
+    Entries and hashes are written to a temporary file first and then
+    renamed, so that several processes can use the same cache at the same
+    time. When the cache grows beyond `max_size` bytes, the entries that were
+    used least recently are removed.
+
+    Parameters
+    ----------
+    folder: str
+        The cache folder. It is created when it does not exist.
+    max_size: int, optional
+        The maximum total size of the cached files in bytes.
+    """
+    def __init__(self, folder, max_size=10 * 1024 ** 3):
+
+        self.folder = folder
+        self.max_size = max_size
+        self._entry_folder = os.path.join(folder, 'entries')
+        self._hash_folder = os.path.join(folder, 'hashes')
+        os.makedirs(self._entry_folder, exist_ok=True)
+        os.makedirs(self._hash_folder, exist_ok=True)
+
+    def key(self, path, command):
+        """Returns the cache key of converting a file with a command.
+
+        Parameters
+        ----------
+        path: str
+            The input file.
+        command: list
+            Everything that affects the result of the conversion, such as the
+            converter and its options, but not the input and output paths.
+
+        Returns
+        -------
+        str
+        """
+        h = hashlib.sha256()
+        h.update(json.dumps([CACHE_VERSION, list(command)]).encode('utf-8'))
+        h.update(self.file_hash(path).encode('ascii'))
+        return h.hexdigest()
+
+    def file_hash(self, path):
+        """Returns the SHA-256 hash of the content of a file, from the hashes
+        folder when the file did not change since it was last hashed.
+        """
+        st = os.stat(path)
+        stat_key = hashlib.sha256(json.dumps(
+            [os.path.abspath(path), st.st_size, st.st_mtime_ns]
+        ).encode('utf-8')).hexdigest()
+        stat_path = os.path.join(self._hash_folder, stat_key)
+        try:
+            with open(stat_path) as fd:
+                digest = fd.read().strip()
+            if len(digest) == 64:
+                return digest
+        except OSError:
+            pass
+        h = hashlib.sha256()
+        with open(path, 'rb') as fd:
+            for chunk in iter(lambda: fd.read(CHUNK_SIZE), b''):
+                h.update(chunk)
+        digest = h.hexdigest()
+        self._write_atomic(stat_path, digest.encode('ascii'))
+        return digest
+
+    def lookup(self, key, name):
+        """Returns the path of the cached file for a key, or None when it is
+        not in the cache. The file is called `name`, so that the same
+        recording under another name is served under that name too. A hit
+        counts as a use for the eviction order.
+        """
+        folder = os.path.join(self._entry_folder, key)
+        entry = os.path.join(folder, name)
+        try:
+            os.utime(folder)
+            if not os.path.exists(entry):
+                self._add_name(folder, entry)
+        except OSError:
+            return None
+        logging.info('using cached conversion {}'.format(entry))
+        return entry
+
+    def store(self, key, path, name):
+        """Moves a converted file into the cache as `name` and returns its
+        new path. The file must be on the same file system as the cache or it
+        is copied.
+        """
+        folder = os.path.join(self._entry_folder, key)
+        entry = os.path.join(folder, name)
+        os.makedirs(folder, exist_ok=True)
+        fd, tmp_path = tempfile.mkstemp(dir=folder, prefix='.tmp-')
+        os.close(fd)
+        try:
+            shutil.move(path, tmp_path)
+            os.replace(tmp_path, entry)
+        except BaseException:
+            if os.path.exists(tmp_path):
+                os.remove(tmp_path)
+            raise
+        logging.info('cached conversion {}'.format(entry))
+        self.evict(keep=key)
+        return entry
+
+    def evict(self, keep=None):
+        """Removes the least recently used entries until the cache fits in
+        `max_size`. The entry `keep` is never removed.
+        """
+        entries = []
+        total = 0
+        for name in os.listdir(self._entry_folder):
+            if name.startswith('.tmp-'):
+                continue
+            path = os.path.join(self._entry_folder, name)
+            try:
+                st = os.stat(path)
+                size = self._entry_size(path)
+            except OSError:
+                continue
+            entries.append((st.st_mtime, name, size))
+            total += size
+        entries.sort()
+        for mtime, name, size in entries:
+            if total <= self.max_size:
+                break
+            if name == keep:
+                continue
+            path = os.path.join(self._entry_folder, name)
+            try:
+                if os.path.isdir(path):
+                    shutil.rmtree(path)
+                else:
+                    os.remove(path)
+            except OSError:
+                continue
+            logging.info('evicted cached conversion {}'.format(name))
+            total -= size
+
+    def _names(self, folder):
+
+        return [name for name in os.listdir(folder)
+                if not name.startswith('.tmp-')]
+
+    def _entry_size(self, path):
+
+        # All names in an entry are links to (or copies of) the same file,
+        # so an entry takes the size of one of them
+        if not os.path.isdir(path):
+            return os.path.getsize(path)
+        for name in self._names(path):
+            return os.path.getsize(os.path.join(path, name))
+        return 0
+
+    def _add_name(self, folder, entry):
+
+        names = self._names(folder)
+        if not names:
+            raise OSError('empty cache entry {}'.format(folder))
+        fd, tmp_path = tempfile.mkstemp(dir=folder, prefix='.tmp-')
+        os.close(fd)
+        os.remove(tmp_path)
+        try:
+            try:
+                os.link(os.path.join(folder, names[0]), tmp_path)
+            except OSError:
+                shutil.copyfile(os.path.join(folder, names[0]), tmp_path)
+            os.replace(tmp_path, entry)
+        except BaseException:
+            if os.path.exists(tmp_path):
+                os.remove(tmp_path)
+            raise
+
+    def _write_atomic(self, path, data):
+
+        fd, tmp_path = tempfile.mkstemp(dir=os.path.dirname(path),
+                                        prefix='.tmp-')
+        try:
+            with os.fdopen(fd, 'wb') as f:
+                f.write(data)
+            os.replace(tmp_path, path)
+        except OSError:
+            if os.path.exists(tmp_path):
+                os.remove(tmp_path)
@@ -27,6 +27,7 @@ import tempfile
 import subprocess
 import itertools
 import logging
+import shutil
 try:
     import fastnumbers
 except ImportError:
@@ -35,6 +36,7 @@ except ImportError:
 import numpy as np
 from datamatrix import DataMatrix, SeriesColumn, operations
 from python_eyelinkparser.eyelinkparser import sample, fixation, blink, defaulttraceprocessor
+from python_eyelinkparser.eyelinkparser._conversioncache import ConversionCache
 
 ANY_VALUE = int, float, basestring
 ANY_VALUES = list, int, float, basestring
@@ -97,6 +99,14 @@ class EyeLinkParser(object):
         The name of the edf2asc executable, which if available can be used to
         automatically convert .edf files to .asc. If not available, the parser
         can only parse .asc files.
+    cache_folder: str or None, optional
+        A folder in which the .asc files that edf2asc makes are kept, so that
+        an .edf file is only converted again when its content, the edf2asc
+        executable or the conversion options changed. `None` converts every
+        .edf file into a temporary file that is deleted after parsing.
+    cache_size: int, optional
+        The maximum size of the cache folder in bytes. When the cache grows
+        beyond it, the files that were used least recently are removed.
     multiprocess: bool or int or None, optional
         Indicates whether each file should be processed in a different process.
         This can speed up parsing considerably. If not `False`, this should be
@@ -128,6 +138,8 @@ class EyeLinkParser(object):
         phasemap={},
         trialphase=None,
         edf2asc_binary=u'edf2asc',
+        cache_folder=None,
+        cache_size=10 * 1024 ** 3,
         multiprocess=False,
         asc_encoding=None,
         pupil_size=True,
@@ -145,6 +157,8 @@ class EyeLinkParser(object):
         self._phasefilter = phasefilter
         self._phasemap = phasemap
         self._edf2asc_binary = edf2asc_binary
+        self._cache = None if cache_folder is None \
+            else ConversionCache(cache_folder, cache_size)
         self._trialphase = trialphase
         self._asc_encoding = asc_encoding
         self._temp_files = []
@@ -548,9 +562,39 @@ class EyeLinkParser(object):
 
         if not path.lower().endswith(u'.edf'):
             return path
+        options = [u'-y']
+        if self._cache is not None:
+            # The cached file is named after the recording, because its path
+            # ends up in the path column of the trials
+            name = os.path.basename(path) + u'.asc'
+            key = self._cache.key(path, self._edf2asc_command(options))
+            cached_path = self._cache.lookup(key, name)
+            if cached_path is not None:
+                self._delete_temp_file(path)
+                print(cached_path)
+                return cached_path
         new_path = self._temp_path(path) + u'.asc'
-        subprocess.call([self._edf2asc_binary, u'-y', path, new_path])
-        self._register_temp_file(new_path)
+        subprocess.call([self._edf2asc_binary] + options + [path, new_path])
+        if self._cache is not None and os.path.exists(new_path) and \
+                os.path.getsize(new_path) > 0:
+            # Cached files are not registered as temporary files, so that they
+            # are not deleted after parsing
+            new_path = self._cache.store(key, new_path, name)
+        else:
+            self._register_temp_file(new_path)
         self._delete_temp_file(path)
         print(new_path)
         return new_path
+
+    def _edf2asc_command(self, options):
+        """Returns what identifies a conversion for the cache: the edf2asc
+        executable, with its size and modification time so that an update
+        invalidates the cache, and the options.
+        """
+        binary = shutil.which(self._edf2asc_binary) or self._edf2asc_binary
+        try:
+            st = os.stat(binary)
+            identity = [os.path.abspath(binary), st.st_size, st.st_mtime_ns]
+        except OSError:
+            identity = [binary]
+        return identity + options
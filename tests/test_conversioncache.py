@@ -0,0 +1,69 @@
+import os
+import sys
+import pytest
+
+
+def test_conversion_cache(tmp_path):
+    pytest.importorskip('datamatrix')
+    from python_eyelinkparser.eyelinkparser._conversioncache import \
+        ConversionCache
+
+    cache = ConversionCache(str(tmp_path / 'cache'), max_size=25)
+    edf = tmp_path / 'a.edf'
+    edf.write_bytes(b'recording')
+    copy = tmp_path / 'b.edf'
+    copy.write_bytes(b'recording')
+    key = cache.key(str(edf), ['edf2asc', '-y'])
+    # The same content under another name has the same key, other options not
+    assert cache.key(str(copy), ['edf2asc', '-y']) == key
+    assert cache.key(str(edf), ['edf2asc', '-s']) != key
+    assert cache.lookup(key, 'a.edf.asc') is None
+    asc = tmp_path / 'a.asc'
+    asc.write_bytes(b'x' * 10)
+    entry = cache.store(key, str(asc), 'a.edf.asc')
+    assert not asc.exists()
+    assert os.path.basename(entry) == 'a.edf.asc'
+    assert cache.lookup(key, 'a.edf.asc') == entry
+    # ... and is served under its own name
+    other = cache.lookup(key, 'b.edf.asc')
+    assert os.path.basename(other) == 'b.edf.asc'
+    assert open(other, 'rb').read() == b'x' * 10
+    # A changed file is converted again
+    edf.write_bytes(b'other recording')
+    assert cache.key(str(edf), ['edf2asc', '-y']) != key
+    # Storing two more entries evicts the least recently used one
+    for name in ('c', 'd'):
+        path = tmp_path / (name + '.asc')
+        path.write_bytes(b'x' * 10)
+        os.utime(os.path.dirname(entry), (0, 0))
+        cache.store(name * 64, str(path), name + '.edf.asc')
+    assert cache.lookup(key, 'a.edf.asc') is None
+    assert cache.lookup('c' * 64, 'c.edf.asc') is not None
+
+
+def test_edf2asc_cache(tmp_path):
+    pytest.importorskip('datamatrix')
+    from python_eyelinkparser.eyelinkparser import EyeLinkParser
+
+    # A stand-in for edf2asc that counts its calls and copies the input
+    calls = tmp_path / 'calls'
+    binary = tmp_path / 'edf2asc'
+    binary.write_text(
+        '#!{}\nimport shutil, sys\n'
+        'open({!r}, "a").write("x")\n'
+        'shutil.copyfile(sys.argv[-2], sys.argv[-1])\n'.format(
+            sys.executable, str(calls)))
+    binary.chmod(0o755)
+    data = tmp_path / 'data'
+    data.mkdir()
+    parser = EyeLinkParser(folder=str(data), edf2asc_binary=str(binary),
+                           cache_folder=str(tmp_path / 'cache'))
+    for name in ('subject1.edf', 'subject2.edf'):
+        (data / name).write_bytes(b'recording')
+    # The converted file keeps the name of the recording, whether it is
+    # converted or taken from the cache
+    for name in ('subject1.edf', 'subject1.edf', 'subject2.edf'):
+        path = parser.edf2asc(str(data / name))
+        assert os.path.basename(path) == name + '.asc'
+        assert open(path, 'rb').read() == b'recording'
+    assert calls.read_text() == 'x'
@@ -0,0 +1,123 @@
+import pytest
+
+
+def _write_edf(path, records=3, duration=1, rates=(4, 2)):
+    """Writes a small EDF file with a ramp in every signal."""
+    ns = len(rates)
+
+    def field(value, width):
+        return str(value).ljust(width)[:width].encode('ascii')
+
+    header = b''.join([
+        field(0, 8), field('X X X X', 80), field('Startdate X', 80),
+        field('01.01.21', 8), field('12.00.00', 8),
+        field(256 * (ns + 1), 8), field('', 44), field(records, 8),
+        field(duration, 8), field(ns, 4)])
+    for width, values in [
+            (16, ['sig%d' % (i + 1) for i in range(ns)]),
+            (80, [''] * ns), (8, ['uV'] * ns),
+            (8, [-100] * ns), (8, [100] * ns),
+            (8, [-32768] * ns), (8, [32767] * ns),
+            (80, [''] * ns), (8, rates), (32, [''] * ns)]:
+        header += b''.join(field(v, width) for v in values)
+    data = b''
+    for r in range(records):
+        for rate in rates:
+            for s in range(rate):
+                data += (r * rate + s).to_bytes(2, 'little', signed=True)
+    with open(path, 'wb') as fd:
+        fd.write(header + data)
+
+
+def test_read_edf(tmp_path):
+    pytest.importorskip('python_eyelinkparser._edfread')
+    from python_eyelinkparser.edfreader import read_edf, sample_times
+
+    path = str(tmp_path / 'ramp.edf')
+    _write_edf(path)
+    recording = read_edf(path)
+    assert recording['filetype'] == 'EDF'
+    assert recording['datarecords'] == 3
+    assert [s['label'] for s in recording['signals']] == ['sig1', 'sig2']
+    sig2 = recording['signals'][1]
+    assert sig2['sample_rate'] == 2
+    gain = 200 / 65535
+    expected = [(i + 0.5) * gain for i in range(6)]
+    assert sig2['data'] == pytest.approx(expected)
+    assert list(sample_times(recording, sig2)) == \
+        pytest.approx([0, .5, 1, 1.5, 2, 2.5])
+    only = read_edf(path, signals=['sig2'])
+    assert [s['signal'] for s in only['signals']] == [2]
+    only = read_edf(path, signals=['SIG2'])
+    assert [s['signal'] for s in only['signals']] == [2]
+
+
+def test_read_pyramid(tmp_path):
+    import struct
+    np = pytest.importorskip('numpy')
+    from python_eyelinkparser.edfreader import read_pyramid, pyramid_level
+
+    # One signal of 40 samples: levels of 3, 2 and 1 bins of 16, 32, 64
+    # samples, laid out as edf2ascii --pyramid does
+    x = np.arange(40, dtype=np.float64)
+    levels = [[(s.min(), s.max(), s.mean())
+               for s in np.split(x, range(span, 40, span))]
+              for span in (16, 32, 64)]
+    head = b'EDFPYR01' + struct.pack('<iiiiqq', 0x01020304, 16, 1, 0,
+                                     10 ** 9, 0)
+    table = 40 + 32
+    offset = table + 16 * len(levels)
+    entry = struct.pack('<iiiiqq', 3, 8, len(levels), 0, len(x), table)
+    level_table = b''
+    bins = b''
+    for level in levels:
+        level_table += struct.pack('<qq', offset + len(bins), len(level))
+        bins += b''.join(struct.pack('<fff', *b) for b in level)
+    path = tmp_path / 'rec_pyramid.bin'
+    path.write_bytes(head + entry + level_table + bins)
+    pyramid = read_pyramid(str(path))
+    signal = pyramid['signals'][0]
+    assert signal['signal'] == 3
+    assert [len(level) for level in signal['levels']] == [3, 2, 1]
+    span, level = pyramid_level(pyramid, signal, 2)
+    assert span == 32
+    assert level.ravel().tolist() == pytest.approx([0, 31, 15.5, 32, 39, 35.5])
+    with pytest.raises(ValueError, match='at most 0 bins, the coarsest has 1'):
+        pyramid_level(pyramid, signal, 0)
+    with pytest.raises(ValueError, match='no samples'):
+        pyramid_level(pyramid, dict(signal, levels=[]), 2)
+
+
+def test_pyramid_of_edf2ascii(tmp_path):
+    import os
+    import subprocess
+    np = pytest.importorskip('numpy')
+    pytest.importorskip('python_eyelinkparser._edfread')
+    from python_eyelinkparser.edfreader import read_edf, read_pyramid
+
+    # The pyramid that edf2ascii writes, checked against the samples that
+    # read_edf() decodes from the same file
+    bindir = os.path.join(os.path.dirname(__file__), '..', 'converter',
+                          'edf2ascii_ver16_source')
+    edfgen = os.path.join(bindir, 'edfgen')
+    edf2ascii = os.path.join(bindir, 'edf2ascii')
+    if not (os.access(edfgen, os.X_OK) and os.access(edf2ascii, os.X_OK)):
+        pytest.skip('edf2ascii and edfgen are not built (make edfgen)')
+    path = str(tmp_path / 'rec.bdf')
+    subprocess.run([edfgen, '-t', 'bdf+', '-s', '3', '-r', '200,50,7',
+                    '-n', '9', path], check=True, stdout=subprocess.DEVNULL)
+    subprocess.run([edf2ascii, '--pyramid', '-o', str(tmp_path / 'rec'),
+                    path], check=True, stdout=subprocess.DEVNULL)
+    recording = read_edf(path)
+    pyramid = read_pyramid(str(tmp_path / 'rec_pyramid.bin'))
+    assert [s['signal'] for s in pyramid['signals']] == \
+        [s['signal'] for s in recording['signals']]
+    for signal, entry in zip(recording['signals'], pyramid['signals']):
+        x = signal['data']
+        assert entry['samples'] == len(x)
+        for k, level in enumerate(entry['levels']):
+            span = pyramid['block'] << k
+            chunks = np.split(x, range(span, len(x), span))
+            expected = [(c.min(), c.max(), c.mean()) for c in chunks]
+            # the bins are stored as float32
+            np.testing.assert_allclose(level, expected, rtol=1e-6, atol=1e-6)